@@ -0,0 +1,127 @@
+//| Copyright Inria May 2015
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Jean-Baptiste Mouret (jean-baptiste.mouret@inria.fr)
+//|   - Antoine Cully (antoinecully@gmail.com)
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Federico Allocati (fede.allocati@gmail.com)
+//|   - Vaios Papaspyros (b.papaspyros@gmail.com)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is a computer library whose purpose is to optimize continuous,
+//| black-box functions. It mainly implements Gaussian processes and Bayesian
+//| optimization.
+//| Main repository: http://github.com/resibots/limbo
+//| Documentation: http://www.resibots.eu/limbo
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include <limbo/kernel/squared_exp_ard.hpp>
+#include <limbo/mean/data.hpp>
+#include <limbo/model/gp.hpp>
+#include <limbo/tools.hpp>
+
+// compare Eigen's LLT and triangular solves with the tiled, parallel versions (tools::tiled_llt),
+// usage: ./cholesky [n] [tile size]
+
+using namespace limbo;
+
+struct Params {
+    struct kernel : public defaults::kernel {
+    };
+    struct kernel_squared_exp_ard : public defaults::kernel_squared_exp_ard {
+    };
+};
+
+template <typename F>
+double time_ms(const F& f)
+{
+    auto t1 = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t1).count() / 1000.;
+}
+
+int main(int argc, char** argv)
+{
+    tools::par::init();
+
+    int n = argc > 1 ? std::atoi(argv[1]) : 4000;
+    int b = argc > 2 ? std::atoi(argv[2]) : 256;
+    int dim = 6;
+
+    Eigen::MatrixXd X = Eigen::MatrixXd::Random(dim, n);
+    kernel::SquaredExpARD<Params> k(dim);
+    Eigen::MatrixXd K = k.kernel_matrix(X, X);
+    K.diagonal().array() += 0.01;
+    Eigen::MatrixXd B = Eigen::MatrixXd::Random(n, 100);
+
+    std::cout << "n = " << n << ", tiles = " << b << std::endl;
+
+    // Cholesky decomposition
+    Eigen::MatrixXd L1 = K, L2 = K;
+    double t_eigen = time_ms([&]() { Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>> llt(L1); });
+    double t_tiled = time_ms([&]() { tools::tiled_llt(L2, b); });
+    L1.triangularView<Eigen::StrictlyUpper>().setZero();
+    L2.triangularView<Eigen::StrictlyUpper>().setZero();
+    std::cout << "LLT:   eigen " << t_eigen << " ms, tiled " << t_tiled << " ms (x" << t_eigen / t_tiled << ")"
+              << ", error " << (L1 - L2).norm() / L1.norm() << std::endl;
+
+    // triangular solves with 100 right-hand sides (e.g. sigma_batch())
+    Eigen::MatrixXd Z1 = B, Z2 = B;
+    t_eigen = time_ms([&]() {
+        L1.triangularView<Eigen::Lower>().solveInPlace(Z1);
+        L1.triangularView<Eigen::Lower>().adjoint().solveInPlace(Z1);
+    });
+    t_tiled = time_ms([&]() {
+        tools::tiled_lower_solve(L1, Z2, b);
+        tools::tiled_upper_solve(L1, Z2, b);
+    });
+    std::cout << "TRSM:  eigen " << t_eigen << " ms, tiled " << t_tiled << " ms (x" << t_eigen / t_tiled << ")"
+              << ", error " << (Z1 - Z2).norm() / Z1.norm() << std::endl;
+
+    // full GP (kernel + Cholesky + alpha)
+    std::vector<Eigen::VectorXd> samples, observations;
+    for (int i = 0; i < n; i++) {
+        samples.push_back(X.col(i));
+        observations.push_back(tools::make_vector(std::cos(X(0, i) * X(1, i))));
+    }
+    model::GP<Params, kernel::SquaredExpARD<Params>, mean::Data<Params>> gp;
+    model::GP<Params, kernel::SquaredExpARD<Params>, mean::Data<Params>, model::gp::NoLFOpt<Params>, model::gp::Tiled<>> gp_tiled;
+    t_eigen = time_ms([&]() { gp.compute(samples, observations); });
+    t_tiled = time_ms([&]() { gp_tiled.compute(samples, observations); });
+    std::cout << "GP:    eigen " << t_eigen << " ms, tiled " << t_tiled << " ms (x" << t_eigen / t_tiled << ")"
+              << ", error " << (gp.alpha() - gp_tiled.alpha()).norm() / gp.alpha().norm() << std::endl;
+
+    return 0;
+}
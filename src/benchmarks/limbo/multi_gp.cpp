@@ -0,0 +1,154 @@
+//| Copyright Inria May 2015
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Jean-Baptiste Mouret (jean-baptiste.mouret@inria.fr)
+//|   - Antoine Cully (antoinecully@gmail.com)
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Federico Allocati (fede.allocati@gmail.com)
+//|   - Vaios Papaspyros (b.papaspyros@gmail.com)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is a computer library whose purpose is to optimize continuous,
+//| black-box functions. It mainly implements Gaussian processes and Bayesian
+//| optimization.
+//| Main repository: http://github.com/resibots/limbo
+//| Documentation: http://www.resibots.eu/limbo
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include <limbo/kernel/squared_exp_ard.hpp>
+#include <limbo/mean/data.hpp>
+#include <limbo/model/gp.hpp>
+#include <limbo/model/multi_gp.hpp>
+#include <limbo/tools.hpp>
+
+// compare the predictions of a multi-output GP: a parallel loop over the outputs for each point (as before),
+// the sequential query() of MultiGP, the shared GP (multi_gp::SharedIfIdentical) and the batched queries;
+// the points are predicted in a parallel loop, like in the optimizers of the acquisition function
+// usage: ./multi_gp [n] [outputs] [points]
+
+using namespace limbo;
+
+struct Params {
+    struct kernel : public defaults::kernel {
+    };
+    struct kernel_squared_exp_ard : public defaults::kernel_squared_exp_ard {
+    };
+};
+
+template <typename F>
+double time_ms(const F& f)
+{
+    auto t1 = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t1).count() / 1000.;
+}
+
+// time of the single-point queries of all the rows of X (in a parallel loop), stored in mu and sigma
+template <typename Model>
+double query_all(const Model& model, const Eigen::MatrixXd& X, Eigen::MatrixXd& mu, Eigen::MatrixXd& sigma)
+{
+    return time_ms([&]() {
+        tools::par::loop(0, X.rows(), [&](size_t j) {
+            Eigen::VectorXd mu_j, sigma_j;
+            std::tie(mu_j, sigma_j) = model.query(X.row(j).transpose());
+            mu.row(j) = mu_j.transpose();
+            sigma.row(j) = sigma_j.transpose();
+        });
+    });
+}
+
+int main(int argc, char** argv)
+{
+    tools::par::init();
+
+    int n = argc > 1 ? std::atoi(argv[1]) : 1000;
+    int dim_out = argc > 2 ? std::atoi(argv[2]) : 12;
+    int m = argc > 3 ? std::atoi(argv[3]) : 2000;
+    int dim = 6;
+
+    using KF_t = kernel::SquaredExpARD<Params>;
+    using Mean_t = mean::Data<Params>;
+    using MultiGP_t = model::MultiGP<Params, model::GP, KF_t, Mean_t>;
+    using SharedGP_t = model::MultiGP<Params, model::GP, KF_t, Mean_t, model::gp::NoLFOpt<Params>, model::multi_gp::SharedIfIdentical>;
+
+    std::vector<Eigen::VectorXd> samples, observations;
+    for (int i = 0; i < n; i++) {
+        samples.push_back(tools::random_vector(dim));
+        observations.push_back(Eigen::VectorXd::LinSpaced(dim_out, 1, dim_out) * std::cos(samples[i](0) * samples[i](1)));
+    }
+    Eigen::MatrixXd X = Eigen::MatrixXd::Random(m, dim).cwiseAbs();
+
+    std::cout << "n = " << n << ", outputs = " << dim_out << ", points = " << m << std::endl;
+
+    MultiGP_t gp;
+    SharedGP_t shared;
+    double t_gp = time_ms([&]() { gp.compute(samples, observations); });
+    double t_shared = time_ms([&]() { shared.compute(samples, observations); });
+    std::cout << "compute:     independent " << t_gp << " ms, shared " << t_shared << " ms (x" << t_gp / t_shared << ")" << std::endl;
+
+    Eigen::MatrixXd mu_loop(m, dim_out), sigma_loop(m, dim_out);
+    double t_loop = time_ms([&]() {
+        const auto& gps = gp.gp_models();
+        tools::par::loop(0, m, [&](size_t j) {
+            Eigen::VectorXd v = X.row(j).transpose();
+            Eigen::VectorXd mean = gp.mean_function()(v, gp);
+            // (a parallel loop over the outputs for each point)
+            tools::par::loop(0, dim_out, [&](size_t i) {
+                Eigen::VectorXd tmp;
+                std::tie(tmp, sigma_loop(j, i)) = gps[i].query(v);
+                mu_loop(j, i) = tmp(0) + mean(i);
+            });
+        });
+    });
+
+    Eigen::MatrixXd mu(m, dim_out), sigma(m, dim_out);
+    auto error = [&]() { return std::max((mu - mu_loop).cwiseAbs().maxCoeff(), (sigma - sigma_loop).cwiseAbs().maxCoeff()); };
+
+    double t = query_all(gp, X, mu, sigma);
+    std::cout << "query:       per-output loop " << t_loop << " ms, independent " << t << " ms (x" << t_loop / t << ")"
+              << ", error " << error() << std::endl;
+    t = query_all(shared, X, mu, sigma);
+    std::cout << "query:       per-output loop " << t_loop << " ms, shared " << t << " ms (x" << t_loop / t << ")"
+              << ", error " << error() << std::endl;
+
+    t = time_ms([&]() { std::tie(mu, sigma) = gp.query_batch(X); });
+    std::cout << "query_batch: per-output loop " << t_loop << " ms, independent " << t << " ms (x" << t_loop / t << ")"
+              << ", error " << error() << std::endl;
+    t = time_ms([&]() { std::tie(mu, sigma) = shared.query_batch(X); });
+    std::cout << "query_batch: per-output loop " << t_loop << " ms, shared " << t << " ms (x" << t_loop / t << ")"
+              << ", error " << error() << std::endl;
+
+    return 0;
+}
@@ -92,7 +92,7 @@ namespace limbo {
                 double sigma = std::sqrt(sigma_sq);
 
                 // If \sigma(x) = 0 or we do not have any observation yet we return 0
-                if (sigma < 1e-10 || _model.samples().size() < 1)
+                if (sigma < 1e-10 || _model.nb_samples() < 1)
                     return opt::no_grad(0.0);
 
                 // Compute EI(x)
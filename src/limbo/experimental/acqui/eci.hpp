@@ -83,7 +83,7 @@ namespace limbo {
                     double sigma = std::sqrt(sigma_sq);
 
                     // If \sigma(x) = 0 or we do not have any observation yet we return 0
-                    if (sigma < 1e-10 || _model.samples().size() < 1)
+                    if (sigma < 1e-10 || _model.nb_samples() < 1)
                         return opt::no_grad(0.0);
 
                     // Compute expected constrained improvement
@@ -120,7 +120,7 @@ namespace limbo {
                     std::tie(mu, sigma_sq) = _constraint_model.query(v);
                     double sigma = std::sqrt(sigma_sq);
 
-                    if (sigma < 1e-10 || _constraint_model.samples().size() < 1)
+                    if (sigma < 1e-10 || _constraint_model.nb_samples() < 1)
                         return 1.0;
 
                     double Z = (afun(mu) - 1.0) / sigma;
@@ -91,10 +91,11 @@ namespace limbo {
                 /// add sample will NOT be incremental (we call compute each time)
                 void add_sample(const Eigen::VectorXd& sample, const Eigen::VectorXd& observation)
                 {
-                    this->_samples.push_back(sample);
+                    std::vector<Eigen::VectorXd> samples = this->samples();
+                    samples.push_back(sample);
                     _raw_observations.push_back(observation);
 
-                    this->compute(this->_samples, _raw_observations);
+                    this->compute(samples, _raw_observations);
                 }
 
             protected:
@@ -206,6 +206,29 @@ namespace limbo {
                 return _predict(xt, true, true);
             }
 
+            /**
+             \\rst
+             return :math:`\mu`, :math:`\sigma^2` for a batch of points (one point per row of ``X``); same interface as ``GP::query_batch``.
+             \\endrst
+            */
+            std::tuple<Eigen::MatrixXd, Eigen::VectorXd> query_batch(const Eigen::MatrixXd& X) const
+            {
+                std::pair<Eigen::MatrixXd, Eigen::MatrixXd>&& result = _predict(X, true, true);
+                return std::make_tuple(result.first, Eigen::VectorXd(result.second.col(0)));
+            }
+
+            /// return :math:`\mu` for a batch of points (one point per row of X)
+            Eigen::MatrixXd mu_batch(const Eigen::MatrixXd& X) const
+            {
+                return _predict(X, true, false).first;
+            }
+
+            /// return :math:`\sigma^2` for a batch of points (one point per row of X)
+            Eigen::VectorXd sigma_batch(const Eigen::MatrixXd& X) const
+            {
+                return _predict(X, false, true).second.col(0);
+            }
+
             /**
              \\rst
              return :math:`\mu` (unormalized). If there is no sample, return the value according to the mean function.
@@ -91,25 +91,82 @@ namespace limbo {
                 _sf2 = std::exp(2.0 * p(1));
             }
 
-            double kernel(const Eigen::VectorXd& v1, const Eigen::VectorXd& v2) const
+            double kernel(const Eigen::Ref<const Eigen::VectorXd>& v1, const Eigen::Ref<const Eigen::VectorXd>& v2) const
             {
                 double l_sq = _l * _l;
-                double r = (v1 - v2).squaredNorm() / l_sq;
+                double r = (this->_fixed(v1) - this->_fixed(v2)).squaredNorm() / l_sq;
                 return _sf2 * std::exp(-0.5 * r);
             }
 
-            Eigen::VectorXd gradient(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+            Eigen::VectorXd gradient(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2) const
             {
                 Eigen::VectorXd grad(this->params_size());
+                gradient_in_place(x1, x2, grad);
+                return grad;
+            }
+
+            void gradient_in_place(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2, Eigen::Ref<Eigen::VectorXd> grad) const
+            {
                 double l_sq = _l * _l;
-                double r = (x1 - x2).squaredNorm() / l_sq;
+                double r = (this->_fixed(x1) - this->_fixed(x2)).squaredNorm() / l_sq;
                 double k = _sf2 * std::exp(-0.5 * r);
 
                 grad(0) = r * k;
                 grad(1) = 2 * k;
+            }
+
+            Eigen::VectorXd gradient_input(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2) const
+            {
+                double l_sq = _l * _l;
+                double k = _sf2 * std::exp(-0.5 * (this->_fixed(x1) - this->_fixed(x2)).squaredNorm() / l_sq);
+                return -k / l_sq * (this->_fixed(x1) - this->_fixed(x2));
+            }
+
+            // Frequencies of random Fourier features (one per column) from standard normal draws Z (D x m);
+            // the spectral density is N(0, I / l^2), so E is not used
+            Eigen::MatrixXd spectral_frequencies(const Eigen::MatrixXd& Z, const Eigen::MatrixXd& E) const
+            {
+                return Z / _l;
+            }
+
+            Eigen::MatrixXd kernel_matrix(const Eigen::Ref<const Eigen::MatrixXd>& X1, const Eigen::Ref<const Eigen::MatrixXd>& X2) const
+            {
+                double l_sq = _l * _l;
+                return _sf2 * (-0.5 / l_sq * tools::sq_dist(X1, X2).array()).exp();
+            }
+
+            void kernel_cached(const DistanceCache& cache, Eigen::MatrixXd& K) const
+            {
+                double l_sq = _l * _l;
+                K = (_sf2 * (-0.5 / l_sq * cache.sq_dist().array()).exp()).matrix();
+            }
+
+            Eigen::VectorXd gradient_trace_cached(const DistanceCache& cache, const Eigen::MatrixXd& W) const
+            {
+                Eigen::ArrayXXd r = cache.sq_dist().array() / (_l * _l);
+                Eigen::ArrayXXd wk = W.array() * (_sf2 * (-0.5 * r).exp());
+
+                Eigen::VectorXd grad(this->params_size());
+                grad(0) = (wk * r).sum();
+                grad(1) = 2 * wk.sum();
                 return grad;
             }
 
+            void gradient_matrix_cached(const DistanceCache& cache, int p, Eigen::MatrixXd& dK) const
+            {
+                const Eigen::MatrixXd& d_sq = cache.sq_dist();
+                double l_sq = _l * _l;
+                if (p == 0)
+                    dK = ((_sf2 / l_sq) * d_sq.array() * (-0.5 / l_sq * d_sq.array()).exp()).matrix();
+                else
+                    dK = (2 * _sf2 * (-0.5 / l_sq * d_sq.array()).exp()).matrix();
+            }
+
+            Eigen::VectorXd kernel_diag(const Eigen::Ref<const Eigen::MatrixXd>& X) const
+            {
+                return Eigen::VectorXd::Constant(X.cols(), _sf2);
+            }
+
         protected:
             double _sf2, _l;
 
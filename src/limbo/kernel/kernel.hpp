@@ -46,9 +46,15 @@
 #ifndef LIMBO_KERNEL_KERNEL_HPP
 #define LIMBO_KERNEL_KERNEL_HPP
 
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
 #include <Eigen/Core>
 
 #include <limbo/tools/macros.hpp>
+#include <limbo/tools/math.hpp>
+#include <limbo/tools/parallel.hpp>
 
 namespace limbo {
     namespace defaults {
@@ -56,10 +62,163 @@ namespace limbo {
             /// @ingroup kernel_defaults
             BO_PARAM(double, noise, 0.01);
             BO_PARAM(bool, optimize_noise, false);
+            /// @ingroup kernel_defaults
+            /// dimension of the inputs if it is known at compile time (-1, i.e. Eigen::Dynamic, otherwise)
+            BO_PARAM(int, dim_in, -1);
         };
     } // namespace defaults
 
     namespace kernel {
+        /// Params::kernel::dim_in() if it exists, Eigen::Dynamic otherwise
+        /// (e.g. when Params::kernel does not inherit from defaults::kernel)
+        template <typename Params>
+        struct fixed_dim_in {
+        private:
+            template <typename P>
+            static constexpr int _get(decltype(P::kernel::dim_in())*) { return P::kernel::dim_in(); }
+            template <typename P>
+            static constexpr int _get(...) { return Eigen::Dynamic; }
+
+        public:
+            static constexpr int value = _get<Params>(nullptr);
+        };
+
+        /**
+          @ingroup kernel
+          \rst
+          Squared distances between a fixed set of samples (the columns of a DxN matrix), kept (e.g. by a GP) to rebuild the kernel matrix and its gradient when only the hyper-parameters change. The cache does not copy the samples: it is a view of the matrix given to ``bind()``, which must stay alive (and unchanged) while the cache is used. The distances are computed the first time they are needed (this is thread-safe), are shared by the copies of the cache and are dropped by ``reset()``.
+
+          - ``sq_dist()``: :math:`N\times N` matrix of the squared euclidean distances (for isotropic kernels)
+          - ``sq_diff()``: :math:`N^2\times D` matrix whose column :math:`k` is the (column-major) :math:`N\times N` matrix of the :math:`(x_i(k) - x_j(k))^2` (for ARD kernels); it is only available if ``sq_diff_fits()``, that is, if it holds less than ``max_size()`` doubles
+
+          An owner whose samples change (e.g. GP::add_sample()) only calls ``reset()``, in O(1), and calls ``bind()`` (also O(1)) before each use, so that the view follows its storage (and its copies).
+          \endrst
+        */
+        class DistanceCache {
+        public:
+            /// view of the samples (their matrix might have a larger outer stride)
+            using samples_t = Eigen::Map<const Eigen::MatrixXd, 0, Eigen::OuterStride<>>;
+
+            DistanceCache() : _data(nullptr), _rows(0), _cols(0), _stride(0) {}
+            // copies share the distances that are already computed (they are never modified)
+            DistanceCache(const DistanceCache& other)
+            {
+                std::lock_guard<std::mutex> lock(other._mutex);
+                _copy(other);
+            }
+
+            DistanceCache& operator=(const DistanceCache& other)
+            {
+                if (this != &other) {
+                    DistanceCache copy(other);
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _copy(copy);
+                }
+                return *this;
+            }
+
+            /// maximum number of doubles of sq_diff() (1 GB)
+            static size_t max_size() { return size_t(1) << 27; }
+
+            /// the samples have changed: drop the cached distances, in O(1)
+            void reset()
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _sq_dist.reset();
+                _sq_diff.reset();
+            }
+
+            /// use new samples (columns of X, which are not copied) and drop the cached distances
+            void reset(const Eigen::Ref<const Eigen::MatrixXd>& X)
+            {
+                reset();
+                bind(X);
+            }
+
+            /// view the samples (columns of X, which are not copied), without dropping the distances:
+            /// they must be the samples of the last reset()
+            void bind(const Eigen::Ref<const Eigen::MatrixXd>& X)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _data = X.data();
+                _rows = X.rows();
+                _cols = X.cols();
+                _stride = X.outerStride();
+            }
+
+            samples_t samples() const
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                return _samples();
+            }
+
+            int size() const
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                return _cols;
+            }
+
+            bool sq_diff_fits() const
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                return size_t(_cols) * _cols * _rows <= max_size();
+            }
+
+            const Eigen::MatrixXd& sq_dist() const
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_sq_dist) {
+                    samples_t X = _samples();
+                    int n = _cols;
+                    // computed dimension by dimension (and not with tools::sq_dist) to be exact
+                    std::shared_ptr<Eigen::MatrixXd> d = std::make_shared<Eigen::MatrixXd>(Eigen::MatrixXd::Zero(n, n));
+                    for (int k = 0; k < _rows; k++)
+                        d->array() += (X.row(k).transpose().replicate(1, n) - X.row(k).replicate(n, 1)).array().square();
+                    _sq_dist = d;
+                }
+                return *_sq_dist;
+            }
+
+            const Eigen::MatrixXd& sq_diff() const
+            {
+                assert(sq_diff_fits());
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_sq_diff) {
+                    samples_t X = _samples();
+                    int n = _cols;
+                    std::shared_ptr<Eigen::MatrixXd> d = std::make_shared<Eigen::MatrixXd>(n * n, _rows);
+                    for (int k = 0; k < _rows; k++) {
+                        Eigen::Map<Eigen::MatrixXd> d_k(d->col(k).data(), n, n);
+                        d_k = (X.row(k).transpose().replicate(1, n) - X.row(k).replicate(n, 1)).array().square().matrix();
+                    }
+                    _sq_diff = d;
+                }
+                return *_sq_diff;
+            }
+
+        protected:
+            const double* _data;
+            Eigen::Index _rows, _cols, _stride;
+            mutable std::shared_ptr<const Eigen::MatrixXd> _sq_dist;
+            mutable std::shared_ptr<const Eigen::MatrixXd> _sq_diff;
+            mutable std::mutex _mutex;
+
+            samples_t _samples() const
+            {
+                return samples_t(_data, _rows, _cols, Eigen::OuterStride<>(std::max<Eigen::Index>(_stride, _rows)));
+            }
+
+            void _copy(const DistanceCache& other)
+            {
+                _data = other._data;
+                _rows = other._rows;
+                _cols = other._cols;
+                _stride = other._stride;
+                _sq_dist = other._sq_dist;
+                _sq_diff = other._sq_diff;
+            }
+        };
+
         /**
           @ingroup kernel
           \rst
@@ -69,32 +228,113 @@ namespace limbo {
           Parameters:
              - ``double noise`` (initial signal noise squared)
              - ``bool optimize_noise`` (whether we are optimizing for the noise or not)
+             - ``int dim_in`` (dimension of the inputs if it is known at compile time, -1 otherwise; the point-by-point evaluations then use fixed-size vectors, so that the distances are unrolled and vectorized)
         */
         template <typename Params, typename Kernel>
         struct BaseKernel {
         public:
+            static_assert(fixed_dim_in<Params>::value > 0 || fixed_dim_in<Params>::value == Eigen::Dynamic, "dim_in must be positive (or -1 for a dynamic dimension)");
+
+            /// vector of the inputs, of fixed size if Params::kernel::dim_in() is set
+            using vector_t = Eigen::Matrix<double, fixed_dim_in<Params>::value, 1>;
+
             BaseKernel(size_t dim = 1) : _noise(Params::kernel::noise())
             {
                 _noise_p = std::log(std::sqrt(_noise));
             }
 
-            double operator()(const Eigen::VectorXd& v1, const Eigen::VectorXd& v2, int i = -1, int j = -2) const
+            // inputs are taken by Eigen::Ref so that columns of a sample matrix can be passed without copy
+            double operator()(const Eigen::Ref<const Eigen::VectorXd>& v1, const Eigen::Ref<const Eigen::VectorXd>& v2, int i = -1, int j = -2) const
             {
                 return static_cast<const Kernel*>(this)->kernel(v1, v2) + ((i == j) ? _noise + 1e-8 : 0.0);
             }
 
-            Eigen::VectorXd grad(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2, int i = -1, int j = -2) const
+            Eigen::VectorXd grad(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2, int i = -1, int j = -2) const
+            {
+                Eigen::VectorXd g(h_params_size());
+                grad_in_place(x1, x2, i, j, g);
+                return g;
+            }
+
+            // The same, written in g (of size h_params_size()): there is no allocation if the kernel defines its own
+            // gradient_in_place() (like the kernels of limbo/kernel/), e.g. for the gradient of each pair of samples
+            void grad_in_place(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2, int i, int j, Eigen::Ref<Eigen::VectorXd> g) const
+            {
+                size_t n = static_cast<const Kernel*>(this)->params_size();
+                static_cast<const Kernel*>(this)->gradient_in_place(x1, x2, g.head(n));
+
+                if (Params::kernel::optimize_noise())
+                    g(n) = ((i == j) ? 2.0 * _noise : 0.0);
+            }
+
+            // Derivative of the kernel (without noise) wrt its first input x1
+            Eigen::VectorXd grad_input(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2) const
+            {
+                return static_cast<const Kernel*>(this)->gradient_input(x1, x2);
+            }
+
+            // Kernel matrix (N1xN2, without noise) between the columns of X1 (DxN1) and the columns of X2 (DxN2).
+            // This generic version evaluates the kernel point by point; kernels can define their own
+            // (vectorized) kernel_matrix() that hides this one.
+            Eigen::MatrixXd kernel_matrix(const Eigen::Ref<const Eigen::MatrixXd>& X1, const Eigen::Ref<const Eigen::MatrixXd>& X2) const
+            {
+                Eigen::MatrixXd K(X1.cols(), X2.cols());
+                for (int j = 0; j < X2.cols(); j++)
+                    for (int i = 0; i < X1.cols(); i++)
+                        K(i, j) = static_cast<const Kernel*>(this)->kernel(X1.col(i), X2.col(j));
+                return K;
+            }
+
+            // Diagonal of the kernel matrix (without noise) of the columns of X (DxN)
+            Eigen::VectorXd kernel_diag(const Eigen::Ref<const Eigen::MatrixXd>& X) const
+            {
+                Eigen::VectorXd k(X.cols());
+                for (int i = 0; i < X.cols(); i++)
+                    k(i) = static_cast<const Kernel*>(this)->kernel(X.col(i), X.col(i));
+                return k;
+            }
+
+            // Kernel matrix (without noise) of the samples of a DistanceCache; kernels that only depend on
+            // (per-dimension) squared distances build it from the cached distances in kernel_cached()
+            Eigen::MatrixXd cached_kernel_matrix(const DistanceCache& cache) const
+            {
+                Eigen::MatrixXd K;
+                static_cast<const Kernel*>(this)->kernel_cached(cache, K);
+                return K;
+            }
+
+            // The same, written in K (its memory is reused if it already is N x N)
+            void cached_kernel_matrix(const DistanceCache& cache, Eigen::MatrixXd& K) const
+            {
+                static_cast<const Kernel*>(this)->kernel_cached(cache, K);
+            }
+
+            // Sum over (i, j) of W(i, j) * dK(i, j)/dtheta for every hyper-parameter theta,
+            // where K is the kernel matrix (with noise) of the samples of the cache
+            Eigen::VectorXd cached_grad_trace(const DistanceCache& cache, const Eigen::MatrixXd& W) const
             {
-                Eigen::VectorXd g = static_cast<const Kernel*>(this)->gradient(x1, x2);
+                Eigen::VectorXd g = static_cast<const Kernel*>(this)->gradient_trace_cached(cache, W);
 
                 if (Params::kernel::optimize_noise()) {
                     g.conservativeResize(g.size() + 1);
-                    g(g.size() - 1) = ((i == j) ? 2.0 * _noise : 0.0);
+                    g(g.size() - 1) = 2.0 * _noise * W.diagonal().sum();
                 }
 
                 return g;
             }
 
+            // Derivative (in dK) of the kernel matrix (with noise) of the samples of the cache
+            // wrt the p-th hyper-parameter
+            void cached_grad_matrix(const DistanceCache& cache, int p, Eigen::MatrixXd& dK) const
+            {
+                if (Params::kernel::optimize_noise() && p == int(h_params_size()) - 1) {
+                    dK = Eigen::MatrixXd::Zero(cache.size(), cache.size());
+                    dK.diagonal().setConstant(2.0 * _noise);
+                }
+                else
+                    static_cast<const Kernel*>(this)->gradient_matrix_cached(cache, p, dK);
+            }
+
             // Get the hyper parameters size
             size_t h_params_size() const
             {
@@ -129,6 +369,13 @@ namespace limbo {
             double _noise;
             double _noise_p;
 
+            // view of an input (or of a per-dimension parameter) as a vector_t, without copy;
+            // Eigen asserts that its size is dim_in() when the dimension is fixed
+            static Eigen::Map<const vector_t> _fixed(const Eigen::Ref<const Eigen::VectorXd>& x)
+            {
+                return Eigen::Map<const vector_t>(x.data(), x.size());
+            }
+
             // Functions for compilation issues
             // They should never be called like this
             size_t params_size() const { return 0; }
@@ -143,6 +390,77 @@ namespace limbo {
                 assert(false);
                 return Eigen::VectorXd();
             }
+
+            // Generic version, by central finite differences; kernels should define their own (analytic) gradient_input()
+            Eigen::VectorXd gradient_input(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2) const
+            {
+                Eigen::VectorXd g(x1.size());
+                Eigen::VectorXd x = x1;
+                for (int i = 0; i < x.size(); i++) {
+                    double h = 1e-6 * std::max(1., std::abs(x1(i)));
+                    x(i) = x1(i) + h;
+                    double k_p = static_cast<const Kernel*>(this)->kernel(x, x2);
+                    x(i) = x1(i) - h;
+                    double k_m = static_cast<const Kernel*>(this)->kernel(x, x2);
+                    x(i) = x1(i);
+                    g(i) = (k_p - k_m) / (2 * h);
+                }
+                return g;
+            }
+
+            // Gradient of the kernel (without noise) written in grad (of size params_size()). This generic version
+            // copies the vector returned by gradient(); kernels can define their own to avoid this allocation
+            void gradient_in_place(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2, Eigen::Ref<Eigen::VectorXd> grad) const
+            {
+                grad = static_cast<const Kernel*>(this)->gradient(x1, x2);
+            }
+
+            // Generic versions (from the samples of the cache)
+            void kernel_cached(const DistanceCache& cache, Eigen::MatrixXd& K) const
+            {
+                DistanceCache::samples_t X = cache.samples();
+                K = static_cast<const Kernel*>(this)->kernel_matrix(X, X);
+            }
+
+            Eigen::VectorXd gradient_trace_cached(const DistanceCache& cache, const Eigen::MatrixXd& W) const
+            {
+                DistanceCache::samples_t X = cache.samples();
+                int n = X.cols();
+                int block_size = 32;
+                int nb_blocks = (n + block_size - 1) / block_size;
+
+                // one pass over the lower triangle (the kernel is symmetrical), in parallel over blocks of rows;
+                // each block accumulates in its own column
+                int nb_params = static_cast<const Kernel*>(this)->params_size();
+                Eigen::MatrixXd g = Eigen::MatrixXd::Zero(nb_params, nb_blocks);
+                tools::par::loop(0, nb_blocks, [&](size_t b) {
+                    // the gradient of each pair is written in the same buffer (see gradient_in_place())
+                    Eigen::VectorXd grad(nb_params);
+                    int end = std::min(n, int(b + 1) * block_size);
+                    for (int i = b * block_size; i < end; ++i) {
+                        for (int j = 0; j < i; ++j) {
+                            static_cast<const Kernel*>(this)->gradient_in_place(X.col(i), X.col(j), grad);
+                            g.col(b) += (W(i, j) + W(j, i)) * grad;
+                        }
+                        static_cast<const Kernel*>(this)->gradient_in_place(X.col(i), X.col(i), grad);
+                        g.col(b) += W(i, i) * grad;
+                    }
+                });
+
+                return g.rowwise().sum();
+            }
+
+            void gradient_matrix_cached(const DistanceCache& cache, int p, Eigen::MatrixXd& dK) const
+            {
+                DistanceCache::samples_t X = cache.samples();
+                dK.resize(X.cols(), X.cols());
+                Eigen::VectorXd grad(static_cast<const Kernel*>(this)->params_size());
+                for (int i = 0; i < X.cols(); ++i)
+                    for (int j = 0; j <= i; ++j) {
+                        static_cast<const Kernel*>(this)->gradient_in_place(X.col(i), X.col(j), grad);
+                        dK(i, j) = dK(j, i) = grad(p);
+                    }
+            }
         };
     } // namespace kernel
 } // namespace limbo
@@ -101,9 +101,9 @@ namespace limbo {
                 _sf2 = std::exp(2.0 * p(1));
             }
 
-            double kernel(const Eigen::VectorXd& v1, const Eigen::VectorXd& v2) const
+            double kernel(const Eigen::Ref<const Eigen::VectorXd>& v1, const Eigen::Ref<const Eigen::VectorXd>& v2) const
             {
-                double d = (v1 - v2).norm();
+                double d = (this->_fixed(v1) - this->_fixed(v2)).norm();
                 double d_sq = d * d;
                 double l_sq = _l * _l;
                 double term1 = std::sqrt(5) * d / _l;
@@ -112,11 +112,16 @@ namespace limbo {
                 return _sf2 * (1 + term1 + term2) * std::exp(-term1);
             }
 
-            Eigen::VectorXd gradient(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+            Eigen::VectorXd gradient(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2) const
             {
                 Eigen::VectorXd grad(this->params_size());
+                gradient_in_place(x1, x2, grad);
+                return grad;
+            }
 
-                double d = (x1 - x2).norm();
+            void gradient_in_place(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2, Eigen::Ref<Eigen::VectorXd> grad) const
+            {
+                double d = (this->_fixed(x1) - this->_fixed(x2)).norm();
                 double d_sq = d * d;
                 double l_sq = _l * _l;
                 double term1 = std::sqrt(5) * d / _l;
@@ -128,10 +133,74 @@ namespace limbo {
                 // derivative of e^(-term1) = term1*r
                 grad(0) = _sf2 * (r * term1 * (1 + term1 + term2) + (-term1 - 2. * term2) * r);
                 grad(1) = 2 * _sf2 * (1 + term1 + term2) * r;
+            }
+
+            Eigen::VectorXd gradient_input(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2) const
+            {
+                // dk/dd = -sf2 * 5 * d / (3 * l^2) * (1 + term1) * e^(-term1) and dd/dx1 = (x1 - x2) / d
+                double d = (this->_fixed(x1) - this->_fixed(x2)).norm();
+                double term1 = std::sqrt(5) * d / _l;
+                return (-5. * _sf2 / (3. * _l * _l) * (1 + term1) * std::exp(-term1)) * (this->_fixed(x1) - this->_fixed(x2));
+            }
+
+            // Frequencies of random Fourier features (one per column) from standard normal draws Z (D x m) and E (at least 5 x m);
+            // the spectral density is a multivariate Student-t with 5 degrees of freedom and a scale of 1 / l,
+            // whose chi-square variables are the sums of the squares of the first 5 rows of E
+            Eigen::MatrixXd spectral_frequencies(const Eigen::MatrixXd& Z, const Eigen::MatrixXd& E) const
+            {
+                Eigen::ArrayXd u = E.topRows(5).colwise().squaredNorm().transpose();
+                return (Z.array().rowwise() * (5. / u).sqrt().transpose()).matrix() / _l;
+            }
+
+            Eigen::MatrixXd kernel_matrix(const Eigen::Ref<const Eigen::MatrixXd>& X1, const Eigen::Ref<const Eigen::MatrixXd>& X2) const
+            {
+                Eigen::ArrayXXd d_sq = tools::sq_dist(X1, X2).array();
+                double l_sq = _l * _l;
+                Eigen::ArrayXXd term1 = (std::sqrt(5) / _l) * d_sq.sqrt();
+
+                return _sf2 * (1 + term1 + (5. / (3. * l_sq)) * d_sq) * (-term1).exp();
+            }
+
+            void kernel_cached(const DistanceCache& cache, Eigen::MatrixXd& K) const
+            {
+                const Eigen::MatrixXd& d_sq = cache.sq_dist();
+                double l_sq = _l * _l;
+                // term1, then the kernel, in place
+                K = ((std::sqrt(5) / _l) * d_sq.array().sqrt()).matrix();
+                K.array() = _sf2 * (1 + K.array() + (5. / (3. * l_sq)) * d_sq.array()) * (-K.array()).exp();
+            }
+
+            Eigen::VectorXd gradient_trace_cached(const DistanceCache& cache, const Eigen::MatrixXd& W) const
+            {
+                const Eigen::MatrixXd& d_sq = cache.sq_dist();
+                double l_sq = _l * _l;
+                Eigen::ArrayXXd term1 = (std::sqrt(5) / _l) * d_sq.array().sqrt();
+                Eigen::ArrayXXd term2 = (5. / (3. * l_sq)) * d_sq.array();
+                Eigen::ArrayXXd wr = W.array() * (-term1).exp();
 
+                Eigen::VectorXd grad(this->params_size());
+                grad(0) = _sf2 * (wr * (term1 * (1 + term1 + term2) - term1 - 2. * term2)).sum();
+                grad(1) = 2 * _sf2 * (wr * (1 + term1 + term2)).sum();
                 return grad;
             }
 
+            void gradient_matrix_cached(const DistanceCache& cache, int p, Eigen::MatrixXd& dK) const
+            {
+                const Eigen::MatrixXd& d_sq = cache.sq_dist();
+                double c = std::sqrt(5) / _l;
+                double c2 = 5. / (3. * _l * _l);
+                // with term1 = c * d and term2 = c2 * d^2, d/dlog(l) = sf2 * term2 * (1 + term1) * exp(-term1)
+                if (p == 0)
+                    dK = (_sf2 * c2 * d_sq.array() * (1 + c * d_sq.array().sqrt()) * (-c * d_sq.array().sqrt()).exp()).matrix();
+                else
+                    dK = (2 * _sf2 * (1 + c * d_sq.array().sqrt() + c2 * d_sq.array()) * (-c * d_sq.array().sqrt()).exp()).matrix();
+            }
+
+            Eigen::VectorXd kernel_diag(const Eigen::Ref<const Eigen::MatrixXd>& X) const
+            {
+                return Eigen::VectorXd::Constant(X.cols(), _sf2);
+            }
+
         protected:
             double _sf2, _l;
 
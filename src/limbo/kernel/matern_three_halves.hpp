@@ -99,19 +99,24 @@ namespace limbo {
                 _sf2 = std::exp(2.0 * p(1));
             }
 
-            double kernel(const Eigen::VectorXd& v1, const Eigen::VectorXd& v2) const
+            double kernel(const Eigen::Ref<const Eigen::VectorXd>& v1, const Eigen::Ref<const Eigen::VectorXd>& v2) const
             {
-                double d = (v1 - v2).norm();
+                double d = (this->_fixed(v1) - this->_fixed(v2)).norm();
                 double term = std::sqrt(3) * d / _l;
 
                 return _sf2 * (1 + term) * std::exp(-term);
             }
 
-            Eigen::VectorXd gradient(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+            Eigen::VectorXd gradient(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2) const
             {
                 Eigen::VectorXd grad(this->params_size());
+                gradient_in_place(x1, x2, grad);
+                return grad;
+            }
 
-                double d = (x1 - x2).norm();
+            void gradient_in_place(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2, Eigen::Ref<Eigen::VectorXd> grad) const
+            {
+                double d = (this->_fixed(x1) - this->_fixed(x2)).norm();
                 double term = std::sqrt(3) * d / _l;
                 double r = std::exp(-term);
 
@@ -119,10 +124,65 @@ namespace limbo {
                 // derivative of e^(-term) = term*r
                 grad(0) = _sf2 * (-term * r + (1 + term) * term * r);
                 grad(1) = 2 * _sf2 * (1 + term) * r;
+            }
+
+            Eigen::VectorXd gradient_input(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2) const
+            {
+                // dk/dd = -sf2 * 3 * d / l^2 * e^(-term) and dd/dx1 = (x1 - x2) / d
+                double d = (this->_fixed(x1) - this->_fixed(x2)).norm();
+                double term = std::sqrt(3) * d / _l;
+                return (-3. * _sf2 / (_l * _l) * std::exp(-term)) * (this->_fixed(x1) - this->_fixed(x2));
+            }
+
+            // Frequencies of random Fourier features (one per column) from standard normal draws Z (D x m) and E (at least 3 x m);
+            // the spectral density is a multivariate Student-t with 3 degrees of freedom and a scale of 1 / l,
+            // whose chi-square variables are the sums of the squares of the first 3 rows of E
+            Eigen::MatrixXd spectral_frequencies(const Eigen::MatrixXd& Z, const Eigen::MatrixXd& E) const
+            {
+                Eigen::ArrayXd u = E.topRows(3).colwise().squaredNorm().transpose();
+                return (Z.array().rowwise() * (3. / u).sqrt().transpose()).matrix() / _l;
+            }
 
+            Eigen::MatrixXd kernel_matrix(const Eigen::Ref<const Eigen::MatrixXd>& X1, const Eigen::Ref<const Eigen::MatrixXd>& X2) const
+            {
+                Eigen::ArrayXXd term = (std::sqrt(3) / _l) * tools::sq_dist(X1, X2).array().sqrt();
+
+                return _sf2 * (1 + term) * (-term).exp();
+            }
+
+            void kernel_cached(const DistanceCache& cache, Eigen::MatrixXd& K) const
+            {
+                // term, then the kernel, in place
+                K = ((std::sqrt(3) / _l) * cache.sq_dist().array().sqrt()).matrix();
+                K.array() = _sf2 * (1 + K.array()) * (-K.array()).exp();
+            }
+
+            Eigen::VectorXd gradient_trace_cached(const DistanceCache& cache, const Eigen::MatrixXd& W) const
+            {
+                Eigen::ArrayXXd term = (std::sqrt(3) / _l) * cache.sq_dist().array().sqrt();
+                Eigen::ArrayXXd wr = W.array() * (-term).exp();
+
+                Eigen::VectorXd grad(this->params_size());
+                grad(0) = _sf2 * (wr * term.square()).sum();
+                grad(1) = 2 * _sf2 * (wr * (1 + term)).sum();
                 return grad;
             }
 
+            void gradient_matrix_cached(const DistanceCache& cache, int p, Eigen::MatrixXd& dK) const
+            {
+                const Eigen::MatrixXd& d_sq = cache.sq_dist();
+                double c = std::sqrt(3) / _l;
+                if (p == 0)
+                    dK = (_sf2 * c * c * d_sq.array() * (-c * d_sq.array().sqrt()).exp()).matrix();
+                else
+                    dK = (2 * _sf2 * (1 + c * d_sq.array().sqrt()) * (-c * d_sq.array().sqrt()).exp()).matrix();
+            }
+
+            Eigen::VectorXd kernel_diag(const Eigen::Ref<const Eigen::MatrixXd>& X) const
+            {
+                return Eigen::VectorXd::Constant(X.cols(), _sf2);
+            }
+
         protected:
             double _sf2, _l;
 
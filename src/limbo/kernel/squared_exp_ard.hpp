@@ -46,6 +46,8 @@
 #ifndef LIMBO_KERNEL_SQUARED_EXP_ARD_HPP
 #define LIMBO_KERNEL_SQUARED_EXP_ARD_HPP
 
+#include <Eigen/Cholesky>
+
 #include <limbo/kernel/kernel.hpp>
 
 namespace limbo {
@@ -104,50 +106,151 @@ namespace limbo {
                 _sf2 = std::exp(2.0 * p(params_size() - 1));
             }
 
-            Eigen::VectorXd gradient(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+            Eigen::VectorXd gradient(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2) const
+            {
+                Eigen::VectorXd grad(this->params_size());
+                gradient_in_place(x1, x2, grad);
+                return grad;
+            }
+
+            void gradient_in_place(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2, Eigen::Ref<Eigen::VectorXd> grad) const
             {
+                auto d = this->_fixed(x1) - this->_fixed(x2);
                 if (Params::kernel_squared_exp_ard::k() > 0) {
-                    Eigen::VectorXd grad = Eigen::VectorXd::Zero(this->params_size());
-                    Eigen::MatrixXd K = (_A * _A.transpose());
-                    K.diagonal() += (Eigen::MatrixXd)(_ell.array().inverse().square());
-                    double z = ((x1 - x2).transpose() * K * (x1 - x2));
-                    double k = _sf2 * std::exp(-0.5 * z);
+                    double k = kernel(x1, x2);
 
-                    grad.head(_input_dim) = (x1 - x2).cwiseQuotient(_ell).array().square() * k;
+                    grad.head(_input_dim) = d.cwiseQuotient(this->_fixed(_ell)).array().square() * k;
 
-                    for (size_t j = 0; j < (unsigned int)Params::kernel_squared_exp_ard::k(); ++j) {
-                        Eigen::VectorXd G = -((x1 - x2).transpose() * _A.col(j))(0) * (x1 - x2) * k;
-                        grad.segment((j + 1) * _input_dim, _input_dim) = G;
-                    }
+                    for (size_t j = 0; j < (unsigned int)Params::kernel_squared_exp_ard::k(); ++j)
+                        grad.segment((j + 1) * _input_dim, _input_dim) = -d.dot(this->_fixed(_A.col(j))) * d * k;
 
                     grad(grad.size() - 1) = 2 * k;
-
-                    return grad;
                 }
                 else {
-                    Eigen::VectorXd grad(this->params_size());
-                    Eigen::VectorXd z = (x1 - x2).cwiseQuotient(_ell).array().square();
-                    double k = _sf2 * std::exp(-0.5 * z.sum());
-                    grad.head(_input_dim) = z * k;
+                    grad.head(_input_dim) = d.cwiseQuotient(this->_fixed(_ell)).array().square();
+                    double k = _sf2 * std::exp(-0.5 * grad.head(_input_dim).sum());
+                    grad.head(_input_dim) *= k;
 
                     grad(grad.size() - 1) = 2 * k;
-                    return grad;
                 }
             }
 
-            double kernel(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+            Eigen::VectorXd gradient_input(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2) const
+            {
+                // dk/dx1 = -k * (A * A^T + diag(ell^-2)) * (x1 - x2)
+                auto d = this->_fixed(x1) - this->_fixed(x2);
+                typename Base::vector_t Md = d.cwiseQuotient(this->_fixed(_ell).array().square().matrix());
+                if (Params::kernel_squared_exp_ard::k() > 0)
+                    Md += _fixed_A() * (_fixed_A().transpose() * d);
+                return -kernel(x1, x2) * Md;
+            }
+
+            double kernel(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2) const
             {
                 assert(x1.size() == _ell.size());
-                double z;
+                auto d = this->_fixed(x1) - this->_fixed(x2);
+                // z = (x1 - x2)^T (A * A^T + diag(ell^-2)) (x1 - x2), without building the DxD matrix
+                double z = d.cwiseQuotient(this->_fixed(_ell)).squaredNorm();
+                if (Params::kernel_squared_exp_ard::k() > 0)
+                    z += (_fixed_A().transpose() * d).squaredNorm();
+                return _sf2 * std::exp(-0.5 * z);
+            }
+
+            Eigen::MatrixXd kernel_matrix(const Eigen::Ref<const Eigen::MatrixXd>& X1, const Eigen::Ref<const Eigen::MatrixXd>& X2) const
+            {
+                assert(X1.rows() == _ell.size());
+                // z = (x1 - x2)^T (A * A^T + diag(ell^-2)) (x1 - x2)
+                Eigen::MatrixXd z = tools::sq_dist((X1.array().colwise() / _ell.array()).matrix(), (X2.array().colwise() / _ell.array()).matrix());
+                if (Params::kernel_squared_exp_ard::k() > 0)
+                    z += tools::sq_dist(_A.transpose() * X1, _A.transpose() * X2);
+
+                return _sf2 * (-0.5 * z.array()).exp();
+            }
+
+            // Frequencies of random Fourier features (one per column) from standard normal draws Z (D x m);
+            // the spectral density is N(0, A * A^T + diag(ell^-2)), so E is not used
+            Eigen::MatrixXd spectral_frequencies(const Eigen::MatrixXd& Z, const Eigen::MatrixXd& E) const
+            {
                 if (Params::kernel_squared_exp_ard::k() > 0) {
-                    Eigen::MatrixXd K = (_A * _A.transpose());
-                    K.diagonal() += (Eigen::MatrixXd)(_ell.array().inverse().square());
-                    z = ((x1 - x2).transpose() * K * (x1 - x2));
+                    Eigen::MatrixXd M = _A * _A.transpose();
+                    M.diagonal() += _ell.array().inverse().square().matrix();
+                    return M.llt().matrixL() * Z;
                 }
-                else {
-                    z = (x1 - x2).cwiseQuotient(_ell).squaredNorm();
+                return (Z.array().colwise() / _ell.array()).matrix();
+            }
+
+            void kernel_cached(const DistanceCache& cache, Eigen::MatrixXd& K) const
+            {
+                if (Params::kernel_squared_exp_ard::k() > 0 || !cache.sq_diff_fits()) {
+                    DistanceCache::samples_t X = cache.samples();
+                    K = kernel_matrix(X, X);
+                    return;
                 }
-                return _sf2 * std::exp(-0.5 * z);
+
+                // z = sum_k (x1(k) - x2(k))^2 / ell_k^2, for all the pairs at once (in K)
+                int n = cache.size();
+                K.resize(n, n);
+                Eigen::Map<Eigen::VectorXd>(K.data(), n * n).noalias() = cache.sq_diff() * _ell.array().inverse().square().matrix();
+                K.array() = _sf2 * (-0.5 * K.array()).exp();
+            }
+
+            Eigen::VectorXd gradient_trace_cached(const DistanceCache& cache, const Eigen::MatrixXd& W) const
+            {
+                Eigen::VectorXd grad(this->params_size());
+
+                if (Params::kernel_squared_exp_ard::k() == 0 && cache.sq_diff_fits()) {
+                    int n = cache.size();
+                    Eigen::MatrixXd wk;
+                    kernel_cached(cache, wk);
+                    wk.array() *= W.array();
+
+                    // dK/dlog(ell_k) = K .* (x1(k) - x2(k))^2 / ell_k^2
+                    grad.head(_input_dim) = (cache.sq_diff().transpose() * Eigen::Map<const Eigen::VectorXd>(wk.data(), n * n)).cwiseQuotient(_ell.array().square().matrix());
+                    grad(grad.size() - 1) = 2 * wk.sum();
+                    return grad;
+                }
+
+                // matrix form from the samples, with M = W .* K and d_ij = x_i - x_j
+                DistanceCache::samples_t X = cache.samples();
+                Eigen::MatrixXd M = W.cwiseProduct(kernel_matrix(X, X));
+                Eigen::VectorXd r = M.rowwise().sum();
+                Eigen::VectorXd c = M.colwise().sum().transpose();
+
+                // sum_ij M_ij * d_ij(k)^2 = (X.^2 * (r + c) - 2 * diag(X * M * X^T))_k
+                grad.head(_input_dim) = (X.array().square().matrix() * (r + c) - 2 * (X * M).cwiseProduct(X).rowwise().sum()).cwiseQuotient(_ell.array().square().matrix());
+
+                // sum_ij M_ij * (d_ij^T a) * d_ij = X * (u .* r - M * u - M^T * u + u .* c), with u = X^T * a
+                for (size_t j = 0; j < (unsigned int)Params::kernel_squared_exp_ard::k(); ++j) {
+                    Eigen::VectorXd u = X.transpose() * _A.col(j);
+                    Eigen::VectorXd v = u.cwiseProduct(r + c) - M * u - M.transpose() * u;
+                    grad.segment((j + 1) * _input_dim, _input_dim) = -X * v;
+                }
+
+                grad(grad.size() - 1) = 2 * M.sum();
+                return grad;
+            }
+
+            void gradient_matrix_cached(const DistanceCache& cache, int p, Eigen::MatrixXd& dK) const
+            {
+                DistanceCache::samples_t X = cache.samples();
+                int n = X.cols();
+                int d = _input_dim;
+                kernel_cached(cache, dK);
+
+                if (p < d) // K .* (x1(p) - x2(p))^2 / ell_p^2
+                    dK.array() *= (X.row(p).transpose().replicate(1, n) - X.row(p).replicate(n, 1)).array().square() / (_ell(p) * _ell(p));
+                else if (p < int(this->params_size()) - 1) { // -K .* (d^T a_j) .* d(i), for A(i, j)
+                    int i = p % d, j = p / d - 1;
+                    Eigen::VectorXd u = X.transpose() * _A.col(j);
+                    dK.array() *= -(u.replicate(1, n) - u.transpose().replicate(n, 1)).array() * (X.row(i).transpose().replicate(1, n) - X.row(i).replicate(n, 1)).array();
+                }
+                else
+                    dK *= 2;
+            }
+
+            Eigen::VectorXd kernel_diag(const Eigen::Ref<const Eigen::MatrixXd>& X) const
+            {
+                return Eigen::VectorXd::Constant(X.cols(), _sf2);
             }
 
             const Eigen::VectorXd& ell() const { return _ell; }
@@ -158,6 +261,12 @@ namespace limbo {
             Eigen::MatrixXd _A;
             size_t _input_dim;
             Eigen::VectorXd _h_params;
+
+            using Base = BaseKernel<Params, SquaredExpARD<Params>>;
+            // A (D x k), with D fixed if Params::kernel::dim_in() is set (k might be a dynamic parameter)
+            using a_t = Eigen::Matrix<double, fixed_dim_in<Params>::value, Eigen::Dynamic>;
+
+            Eigen::Map<const a_t> _fixed_A() const { return Eigen::Map<const a_t>(_A.data(), _A.rows(), _A.cols()); }
         };
     } // namespace kernel
 } // namespace limbo
@@ -67,6 +67,8 @@ namespace limbo {
         struct Constant : public BaseMean<Params> {
             Constant(size_t dim_out = 1) : _dim_out(dim_out), _constant(Params::mean_constant::constant()) {}
 
+            static constexpr bool is_constant() { return true; }
+
             template <typename GP>
             Eigen::VectorXd operator()(const Eigen::VectorXd& v, const GP&) const
             {
@@ -56,6 +56,8 @@ namespace limbo {
         struct Data : public BaseMean<Params> {
             Data(size_t dim_out = 1) {}
 
+            static constexpr bool is_constant() { return true; }
+
             template <typename GP>
             Eigen::VectorXd operator()(const Eigen::VectorXd& v, const GP& gp) const
             {
@@ -46,6 +46,8 @@
 #ifndef LIMBO_MEAN_MEAN_HPP
 #define LIMBO_MEAN_MEAN_HPP
 
+#include <type_traits>
+
 #include <Eigen/Core>
 
 #include <limbo/tools/macros.hpp>
@@ -61,6 +63,9 @@ namespace limbo {
         struct BaseMean {
             BaseMean(size_t dim_out = 1) {}
 
+            /// true if the mean does not depend on the input (it can still depend on the GP, like mean::Data)
+            static constexpr bool is_constant() { return false; }
+
             size_t h_params_size() const { return 0; }
 
             Eigen::VectorXd h_params() const { return Eigen::VectorXd(); }
@@ -75,6 +80,20 @@ namespace limbo {
                 return Eigen::VectorXd();
             }
         };
+
+        /// true if MeanFunction::is_constant() exists and returns true
+        /// (the GP then updates alpha incrementally when samples are added)
+        template <typename MeanFunction>
+        struct is_constant {
+        private:
+            template <typename M>
+            static constexpr bool _check(decltype(M::is_constant())*) { return M::is_constant(); }
+            template <typename M>
+            static constexpr bool _check(...) { return false; }
+
+        public:
+            static constexpr bool value = _check<MeanFunction>(nullptr);
+        };
     } // namespace mean
 } // namespace limbo
 
@@ -56,6 +56,8 @@ namespace limbo {
         struct NullFunction : public BaseMean<Params> {
             NullFunction(size_t dim_out = 1) : _dim_out(dim_out) {}
 
+            static constexpr bool is_constant() { return true; }
+
             template <typename GP>
             Eigen::VectorXd operator()(const Eigen::VectorXd& v, const GP&) const
             {
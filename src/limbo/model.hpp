@@ -49,14 +49,21 @@
 ///@defgroup model_opt
 ///@defgroup model_opt_defaults
 
+#include <limbo/model/coregionalized_gp.hpp>
 #include <limbo/model/gp.hpp>
+#include <limbo/model/inducing_gp.hpp>
+#include <limbo/model/kiss_gp.hpp>
+#include <limbo/model/local_gp.hpp>
 #include <limbo/model/multi_gp.hpp>
+#include <limbo/model/rff_gp.hpp>
 #include <limbo/model/sparsified_gp.hpp>
 
+#include <limbo/model/coregionalized_gp/lf_opt.hpp>
 #include <limbo/model/gp/kernel_lf_opt.hpp>
 #include <limbo/model/gp/kernel_loo_opt.hpp>
 #include <limbo/model/gp/kernel_mean_lf_opt.hpp>
 #include <limbo/model/gp/mean_lf_opt.hpp>
 #include <limbo/model/gp/no_lf_opt.hpp>
+#include <limbo/model/gp/factorization.hpp>
 
 #endif
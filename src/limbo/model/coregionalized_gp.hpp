@@ -0,0 +1,523 @@
+//| Copyright Inria May 2015
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Jean-Baptiste Mouret (jean-baptiste.mouret@inria.fr)
+//|   - Antoine Cully (antoinecully@gmail.com)
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Federico Allocati (fede.allocati@gmail.com)
+//|   - Vaios Papaspyros (b.papaspyros@gmail.com)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is a computer library whose purpose is to optimize continuous,
+//| black-box functions. It mainly implements Gaussian processes and Bayesian
+//| optimization.
+//| Main repository: http://github.com/resibots/limbo
+//| Documentation: http://www.resibots.eu/limbo
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+
+#ifndef LIMBO_MODEL_COREGIONALIZED_GP_HPP
+#define LIMBO_MODEL_COREGIONALIZED_GP_HPP
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <tuple>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+
+#include <limbo/kernel/squared_exp_ard.hpp>
+#include <limbo/mean/data.hpp>
+#include <limbo/model/gp/no_lf_opt.hpp>
+#include <limbo/tools/macros.hpp>
+#include <limbo/tools/math.hpp>
+
+namespace limbo {
+    namespace defaults {
+        struct model_coregionalized_gp {
+            /// rank of the correlations between the outputs (number of columns of W, with B = W W^T + diag(kappa))
+            BO_PARAM(int, rank, 1);
+        };
+    } // namespace defaults
+
+    namespace model {
+        /**
+          @ingroup model
+          \rst
+          A multi-output Gaussian process with an intrinsic coregionalization model (ICM): the covariance between the output :math:`i` at :math:`x` and the output :math:`j` at :math:`x'` is :math:`B_{ij} k(x, x')`, with a (learned) :math:`p \times p` coregionalization matrix :math:`B = W W^T + \text{diag}(\kappa)` (:math:`W` being :math:`p \times` ``rank``). Correlated outputs share what is learned from each of them, unlike the independent GPs of MultiGP.
+
+          With :math:`n` samples (each with all the :math:`p` outputs) and the noise :math:`\sigma^2` of the kernel, the covariance of the :math:`np` observations is :math:`B \otimes K + \sigma^2 I`. With the eigendecompositions :math:`K = U \Lambda U^T` and :math:`B = V M V^T`, its inverse and its log-determinant are diagonal in the basis :math:`V \otimes U`:
+
+          - training is :math:`O(n^3 + p^3)` (instead of :math:`O(n^3p^3)` for the stacked GP), and so is the log-likelihood (and its gradient, see ``coregionalized_gp::LFOpt``)
+          - :math:`\mu` is :math:`O(np)` and :math:`\sigma^2` (of each output) is :math:`O(n^2 + np)`; query_batch() uses matrix products for all the points
+          - add_sample() recomputes the model (the eigendecomposition cannot be updated incrementally)
+
+          query() returns the same (:math:`\mu`, :math:`\sigma^2`) vectors (one value for each output) as MultiGP. The mean function is subtracted from the observations (like in MultiGP), and :math:`\sigma^2` includes the noise (like in GP).
+
+          ``coregionalization_params()`` are the (column-major) entries of :math:`W` then :math:`\log(\kappa) / 2`; they start with :math:`W = 0.1` and :math:`\kappa = 1`, that is, with almost independent outputs.
+
+          Parameters:
+            - ``int rank`` (rank of the correlations between the outputs)
+          \endrst
+        */
+        template <typename Params, typename KernelFunction = kernel::SquaredExpARD<Params>, typename MeanFunction = mean::Data<Params>, typename HyperParamsOptimizer = gp::NoLFOpt<Params>>
+        class CoregionalizedGP {
+        public:
+            /// buffers of the likelihood for given hyper-parameters, reused by the optimizers (see gp::WorkspacePool)
+            struct LikelihoodWorkspace {
+                // K = U * diag(lambda) * U^T, B = V * diag(m) * V^T
+                Eigen::MatrixXd U, V, B;
+                Eigen::VectorXd lambda, m;
+                // H(i, l) = 1 / (lambda_i * m_l + noise)
+                Eigen::MatrixXd H;
+                // (B x K + noise * I)^{-1} vec(Y) = vec(A), with A = U * A_tilde * V^T
+                Eigen::MatrixXd A_tilde, A;
+            };
+
+            /// useful because the model might be created before knowing anything about the process
+            CoregionalizedGP() : _dim_in(-1), _dim_out(-1), _nb_samples(0), _log_lik(0) {}
+
+            /// useful because the model might be created before having samples
+            CoregionalizedGP(int dim_in, int dim_out)
+                : _dim_in(-1), _dim_out(-1), _nb_samples(0), _log_lik(0)
+            {
+                _set_dims(dim_in, dim_out);
+            }
+
+            /// Compute the model from samples and observations. This call needs to be explicit!
+            void compute(const std::vector<Eigen::VectorXd>& samples,
+                const std::vector<Eigen::VectorXd>& observations, bool compute_kernel = true)
+            {
+                assert(samples.size() != 0);
+                assert(observations.size() != 0);
+                assert(samples.size() == observations.size());
+
+                _set_dims(samples[0].size(), observations[0].size());
+
+                _nb_samples = samples.size();
+                _samples.resize(_dim_in, _nb_samples);
+                _observations.resize(_nb_samples, _dim_out);
+                for (int i = 0; i < _nb_samples; ++i) {
+                    _samples.col(i) = samples[i];
+                    _observations.row(i) = observations[i];
+                }
+
+                _distance_cache.reset();
+
+                // like GP, the model is only usable after recompute() (or optimize_hyperparams()) if compute_kernel is false
+                if (compute_kernel)
+                    recompute(true, true);
+                else
+                    _compute_obs_mean();
+            }
+
+            /// Do not forget to call this if you use hyper-parameters optimization!!
+            void optimize_hyperparams()
+            {
+                _hp_optimize(*this);
+                // the cached distances are only useful while the hyper-parameters change
+                _distance_cache.reset();
+            }
+
+            /// add a sample and recompute the model, in O(n^3 + p^3)
+            void add_sample(const Eigen::VectorXd& sample, const Eigen::VectorXd& observation)
+            {
+                if (_nb_samples == 0)
+                    _set_dims(sample.size(), observation.size());
+                else {
+                    assert(sample.size() == _dim_in);
+                    assert(observation.size() == _dim_out);
+                }
+
+                // amortized growth of the storage
+                if (_nb_samples == _samples.cols()) {
+                    _samples.conservativeResize(_dim_in, std::max(2 * _nb_samples, 1));
+                    _observations.conservativeResize(std::max(2 * _nb_samples, 1), _dim_out);
+                }
+                _samples.col(_nb_samples) = sample;
+                _observations.row(_nb_samples) = observation.transpose();
+                _nb_samples++;
+
+                recompute(true, true);
+            }
+
+            /**
+             \rst
+             return :math:`\mu`, :math:`\sigma^2` (un-normalized; this will return a vector --- one for each output). If there is no sample, return the value according to the mean function and the prior variance.
+             \endrst
+            */
+            std::tuple<Eigen::VectorXd, Eigen::VectorXd> query(const Eigen::VectorXd& v) const
+            {
+                Eigen::VectorXd mu = _mean_function(v, *this);
+                double kvv = _kernel_function(v, v);
+                if (_nb_samples == 0)
+                    return std::make_tuple(mu, Eigen::VectorXd(_ws.B.diagonal() * kvv + Eigen::VectorXd::Constant(_dim_out, _kernel_function.noise())));
+
+                Eigen::VectorXd k = _kernel_function.kernel_matrix(samples_matrix(), v);
+                mu.noalias() += _alpha_b.transpose() * k;
+                return std::make_tuple(mu, _sigma(k, kvv));
+            }
+
+            /**
+             \rst
+             return :math:`\mu` (un-normalized). If there is no sample, return the value according to the mean function.
+             \endrst
+            */
+            Eigen::VectorXd mu(const Eigen::VectorXd& v) const
+            {
+                Eigen::VectorXd mu = _mean_function(v, *this);
+                if (_nb_samples == 0)
+                    return mu;
+                mu.noalias() += _alpha_b.transpose() * _kernel_function.kernel_matrix(samples_matrix(), v);
+                return mu;
+            }
+
+            /**
+             \rst
+             return :math:`\sigma^2` (un-normalized). This returns a vector; one value for each output.
+             \endrst
+            */
+            Eigen::VectorXd sigma(const Eigen::VectorXd& v) const
+            {
+                return std::get<1>(query(v));
+            }
+
+            /**
+             \rst
+             return :math:`\mu`, :math:`\sigma^2` (un-normalized) for a batch of points (one point per row of ``X``). Both are returned as (MxD) matrices (M points, D output dimensions), like MultiGP::query_batch().
+             \endrst
+            */
+            std::tuple<Eigen::MatrixXd, Eigen::MatrixXd> query_batch(const Eigen::MatrixXd& X) const
+            {
+                Eigen::MatrixXd mu = _mean_batch(X);
+                Eigen::VectorXd kdiag = _kernel_function.kernel_diag(X.transpose());
+                if (_nb_samples == 0)
+                    return std::make_tuple(mu, Eigen::MatrixXd((kdiag * _ws.B.diagonal().transpose()).array() + _kernel_function.noise()));
+
+                Eigen::MatrixXd K = _kernel_function.kernel_matrix(samples_matrix(), X.transpose());
+                mu.noalias() += K.transpose() * _alpha_b;
+                return std::make_tuple(mu, _sigma_batch(K, kdiag));
+            }
+
+            /// return :math:`\mu` (MxD, un-normalized) for the M rows of X
+            Eigen::MatrixXd mu_batch(const Eigen::MatrixXd& X) const
+            {
+                Eigen::MatrixXd mu = _mean_batch(X);
+                if (_nb_samples > 0)
+                    mu.noalias() += _kernel_function.kernel_matrix(samples_matrix(), X.transpose()).transpose() * _alpha_b;
+                return mu;
+            }
+
+            /// return :math:`\sigma^2` (MxD, un-normalized) for the M rows of X
+            Eigen::MatrixXd sigma_batch(const Eigen::MatrixXd& X) const
+            {
+                return std::get<1>(query_batch(X));
+            }
+
+            /// return the number of dimensions of the input
+            int dim_in() const
+            {
+                assert(_dim_in != -1); // need to compute first!
+                return _dim_in;
+            }
+
+            /// return the number of dimensions of the output
+            int dim_out() const
+            {
+                assert(_dim_out != -1); // need to compute first!
+                return _dim_out;
+            }
+
+            const KernelFunction& kernel_function() const { return _kernel_function; }
+
+            KernelFunction& kernel_function() { return _kernel_function; }
+
+            const MeanFunction& mean_function() const { return _mean_function; }
+
+            MeanFunction& mean_function() { return _mean_function; }
+
+            /// return the coregionalization matrix B (DxD)
+            const Eigen::MatrixXd& coregionalization_matrix() const { return _ws.B; }
+
+            /// return the parameters of the coregionalization matrix: the entries of W (column-major), then log(kappa) / 2
+            const Eigen::VectorXd& coregionalization_params() const { return _coregionalization_params; }
+
+            /// set the parameters of the coregionalization matrix (call recompute() afterwards)
+            void set_coregionalization_params(const Eigen::VectorXd& params)
+            {
+                assert(params.size() == _coregionalization_params.size());
+                _coregionalization_params = params;
+                _ws.B = coregionalization_matrix(params);
+            }
+
+            /// return the coregionalization matrix W W^T + diag(kappa) for the given parameters
+            Eigen::MatrixXd coregionalization_matrix(const Eigen::VectorXd& params) const
+            {
+                int r = Params::model_coregionalized_gp::rank();
+                Eigen::Map<const Eigen::MatrixXd> W(params.data(), _dim_out, r);
+                Eigen::MatrixXd B = W * W.transpose();
+                B.diagonal() += (2 * params.tail(_dim_out)).array().exp().matrix();
+                return B;
+            }
+
+            /// return the maximum observation (only call this if the output of the model is of dimension 1)
+            Eigen::VectorXd max_observation() const
+            {
+                if (_dim_out > 1)
+                    std::cout << "WARNING max_observation with multi dimensional "
+                                 "observations doesn't make sense"
+                              << std::endl;
+                return tools::make_vector(observations_matrix().maxCoeff());
+            }
+
+            /// return the mean observation
+            Eigen::VectorXd mean_observation() const
+            {
+                assert(_dim_out > 0);
+                return _nb_samples > 0 ? _mean_observation
+                                       : Eigen::VectorXd::Zero(_dim_out);
+            }
+
+            /// return the number of samples used to compute the model
+            int nb_samples() const { return _nb_samples; }
+
+            /// recompute the model (the eigendecompositions of the kernel matrix and of the coregionalization matrix), in O(n^3 + p^3)
+            void recompute(bool update_obs_mean = true, bool update_full_kernel = true)
+            {
+                assert(_nb_samples > 0);
+                if (update_obs_mean)
+                    _compute_obs_mean();
+                // the hyper-parameter optimizers end here: the distances cached for their evaluations are dropped
+                if (update_full_kernel)
+                    _distance_cache.reset();
+
+                _log_lik = _compute_log_lik(_kernel_function, _kernel_function.kernel_matrix(samples_matrix(), samples_matrix()), _coregionalization_params, _ws);
+                _alpha_b = _ws.A * _ws.B;
+                // G(j, l) = (m_l * V(j, l))^2
+                _g = (_ws.V * _ws.m.asDiagonal()).array().square();
+            }
+
+            /// compute and return the log likelihood (computed by recompute())
+            double compute_log_lik()
+            {
+                return _log_lik;
+            }
+
+            /// compute and return the log likelihood for the given hyper-parameters (without changing the model),
+            /// in O(n^3 + p^3), using the buffers of a workspace
+            double compute_log_lik(const KernelFunction& kernel_function, const Eigen::VectorXd& coregionalization_params, LikelihoodWorkspace& ws) const
+            {
+                return _compute_log_lik(kernel_function, kernel_function.cached_kernel_matrix(_cache()), coregionalization_params, ws);
+            }
+
+            /// compute and return the gradient of the log likelihood wrt to the parameters of `kernel_function`, then the
+            /// coregionalization parameters (call compute_log_lik(kernel_function, coregionalization_params, ws) first)
+            Eigen::VectorXd compute_grad_log_lik(const KernelFunction& kernel_function, const Eigen::VectorXd& coregionalization_params, const LikelihoodWorkspace& ws) const
+            {
+                int r = Params::model_coregionalized_gp::rank();
+                int nb_params = kernel_function.h_params_size();
+                Eigen::VectorXd grad(nb_params + coregionalization_params.size());
+
+                // with dSigma = B x dK: (sum(dK .* (A B A^T)) - tr(Sigma^{-1} (B x dK))) / 2, where
+                // tr(Sigma^{-1} (B x dK)) = sum(dK .* (U diag(w) U^T)) and w_i = sum_l m_l H(i, l)
+                Eigen::MatrixXd R = ws.A * ws.B * ws.A.transpose();
+                R.noalias() -= ws.U * (ws.H * ws.m).asDiagonal() * ws.U.transpose();
+                grad.head(nb_params) = 0.5 * kernel_function.cached_grad_trace(_cache(), R);
+
+                // noise = exp(2 * p), with dSigma = dnoise * I
+                if (Params::kernel::optimize_noise())
+                    grad(nb_params - 1) = (ws.A.squaredNorm() - ws.H.sum()) * kernel_function.noise();
+
+                // with dSigma = dB x K: dlik = sum(dB .* G_B), with G_B = (A^T K A - V diag(z) V^T) / 2
+                // and z_l = sum_i lambda_i H(i, l); then dB = dW W^T + W dW^T and dB_jj = 2 kappa_j dp_j
+                Eigen::MatrixXd G_B = ws.V * (ws.A_tilde.transpose() * ws.lambda.asDiagonal() * ws.A_tilde) * ws.V.transpose();
+                G_B.noalias() -= ws.V * (ws.H.transpose() * ws.lambda).asDiagonal() * ws.V.transpose();
+                G_B *= 0.5;
+                Eigen::Map<const Eigen::MatrixXd> W(coregionalization_params.data(), _dim_out, r);
+                Eigen::Map<Eigen::MatrixXd>(grad.data() + nb_params, _dim_out, r) = 2 * G_B * W;
+                grad.tail(_dim_out) = 2 * G_B.diagonal().cwiseProduct((2 * coregionalization_params.tail(_dim_out)).array().exp().matrix());
+
+                return grad;
+            }
+
+            /// return the likelihood (do not compute it -- return last computed)
+            double get_log_lik() const { return _log_lik; }
+
+            /// set the log likelihood (e.g. computed from outside)
+            void set_log_lik(double log_lik) { _log_lik = log_lik; }
+
+            /// return the list of samples
+            std::vector<Eigen::VectorXd> samples() const
+            {
+                std::vector<Eigen::VectorXd> samples(_nb_samples);
+                for (int i = 0; i < _nb_samples; i++)
+                    samples[i] = _samples.col(i);
+                return samples;
+            }
+
+            /// return the samples (in matrix form)
+            /// (DxN), where D is the dimension of the input and N the number of points
+            Eigen::MatrixXd::ConstColsBlockXpr samples_matrix() const
+            {
+                return _samples.leftCols(_nb_samples);
+            }
+
+            /// return the list of observations
+            std::vector<Eigen::VectorXd> observations() const
+            {
+                std::vector<Eigen::VectorXd> observations(_nb_samples);
+                for (int i = 0; i < _nb_samples; i++)
+                    observations[i] = _observations.row(i);
+                return observations;
+            }
+
+            /// return the observations (in matrix form)
+            /// (NxD), where N is the number of points and D is the dimension output
+            Eigen::MatrixXd::ConstRowsBlockXpr observations_matrix() const
+            {
+                return _observations.topRows(_nb_samples);
+            }
+
+        protected:
+            int _dim_in;
+            int _dim_out;
+
+            KernelFunction _kernel_function;
+            MeanFunction _mean_function;
+            Eigen::VectorXd _coregionalization_params;
+
+            // one sample per column (and one observation per row), with a spare capacity
+            Eigen::MatrixXd _samples;
+            Eigen::MatrixXd _observations;
+            int _nb_samples;
+            Eigen::VectorXd _mean_observation;
+            // observations minus the mean function (NxD)
+            Eigen::MatrixXd _obs_mean;
+            // (reset when the samples change, viewed through _cache())
+            mutable kernel::DistanceCache _distance_cache;
+
+            // decompositions for the current hyper-parameters, A * B (for mu) and G (for sigma)
+            LikelihoodWorkspace _ws;
+            Eigen::MatrixXd _alpha_b;
+            Eigen::MatrixXd _g;
+
+            HyperParamsOptimizer _hp_optimize;
+
+            double _log_lik;
+
+            void _set_dims(int dim_in, int dim_out)
+            {
+                if (_dim_in != dim_in) {
+                    _dim_in = dim_in;
+                    _kernel_function = KernelFunction(_dim_in); // the cost of building a functor should be relatively low
+                }
+                if (_dim_out != dim_out) {
+                    _dim_out = dim_out;
+                    _mean_function = MeanFunction(_dim_out); // the cost of building a functor should be relatively low
+                    int r = Params::model_coregionalized_gp::rank();
+                    _coregionalization_params = Eigen::VectorXd::Zero(_dim_out * r + _dim_out);
+                    _coregionalization_params.head(_dim_out * r).setConstant(0.1);
+                    _ws.B = coregionalization_matrix(_coregionalization_params);
+                }
+            }
+
+            void _compute_obs_mean()
+            {
+                _mean_observation = observations_matrix().colwise().mean();
+                _obs_mean.resize(_nb_samples, _dim_out);
+                for (int i = 0; i < _nb_samples; i++)
+                    _obs_mean.row(i) = _observations.row(i) - _mean_function(_samples.col(i), *this).transpose();
+            }
+
+            // log likelihood from the kernel matrix K of the samples (without the noise)
+            double _compute_log_lik(const KernelFunction& kernel_function, const Eigen::MatrixXd& K, const Eigen::VectorXd& coregionalization_params, LikelihoodWorkspace& ws) const
+            {
+                int n = _nb_samples, p = _dim_out;
+                Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eig_k(K);
+                ws.U = eig_k.eigenvectors();
+                ws.lambda = eig_k.eigenvalues().cwiseMax(0.);
+                ws.B = coregionalization_matrix(coregionalization_params);
+                Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eig_b(ws.B);
+                ws.V = eig_b.eigenvectors();
+                ws.m = eig_b.eigenvalues().cwiseMax(0.);
+
+                ws.H = ((ws.lambda * ws.m.transpose()).array() + _noise(kernel_function)).inverse();
+                Eigen::MatrixXd Y_tilde = ws.U.transpose() * _obs_mean * ws.V;
+                ws.A_tilde = Y_tilde.cwiseProduct(ws.H);
+                ws.A = ws.U * ws.A_tilde * ws.V.transpose();
+
+                // vec(Y)^T (B x K + noise * I)^{-1} vec(Y) and log|B x K + noise * I|
+                double a = Y_tilde.cwiseProduct(ws.A_tilde).sum();
+                double logdet = -ws.H.array().log().sum();
+                return -0.5 * a - 0.5 * logdet - 0.5 * n * p * std::log(2 * M_PI);
+            }
+
+            // the distance cache, as a view of the current samples
+            const kernel::DistanceCache& _cache() const
+            {
+                _distance_cache.bind(samples_matrix());
+                return _distance_cache;
+            }
+
+            static double _noise(const KernelFunction& kernel_function) { return kernel_function.noise() + 1e-8; }
+
+            // sigma^2 of each output: B_jj k(v, v) + noise - sum_{i, l} q_i^2 G(j, l) H(i, l), with q = U^T k
+            Eigen::VectorXd _sigma(const Eigen::VectorXd& k, double kvv) const
+            {
+                Eigen::VectorXd q = _ws.U.transpose() * k;
+                Eigen::VectorXd s = _ws.H.transpose() * q.cwiseAbs2();
+                Eigen::VectorXd sigma = _ws.B.diagonal() * kvv - _g * s;
+                return sigma.array().max(0.) + _kernel_function.noise();
+            }
+
+            // the same for the columns of K (NxM): (MxD)
+            Eigen::MatrixXd _sigma_batch(const Eigen::MatrixXd& K, const Eigen::VectorXd& kdiag) const
+            {
+                Eigen::MatrixXd Q = _ws.U.transpose() * K;
+                Eigen::MatrixXd S = Q.cwiseAbs2().transpose() * _ws.H;
+                Eigen::MatrixXd sigma = kdiag * _ws.B.diagonal().transpose() - S * _g.transpose();
+                return sigma.array().max(0.) + _kernel_function.noise();
+            }
+
+            Eigen::MatrixXd _mean_batch(const Eigen::MatrixXd& X) const
+            {
+                Eigen::MatrixXd mu(X.rows(), _dim_out);
+                for (int i = 0; i < X.rows(); i++)
+                    mu.row(i) = _mean_function(X.row(i).transpose(), *this);
+                return mu;
+            }
+        };
+    } // namespace model
+} // namespace limbo
+
+#endif
@@ -46,13 +46,16 @@
 #ifndef LIMBO_MODEL_GP_HPP
 #define LIMBO_MODEL_GP_HPP
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <limits>
+#include <type_traits>
 #include <vector>
 
 #include <Eigen/Cholesky>
 #include <Eigen/Core>
+#include <Eigen/Eigenvalues>
 #include <Eigen/LU>
 
 // Quick hack for definition of 'I' in <complex.h>
@@ -64,6 +67,7 @@
 #include <limbo/mean/data.hpp>
 #include <limbo/model/gp/kernel_lf_opt.hpp>
 #include <limbo/model/gp/no_lf_opt.hpp>
+#include <limbo/model/gp/factorization.hpp>
 #include <limbo/tools.hpp>
 
 namespace limbo {
@@ -74,15 +78,20 @@ namespace limbo {
         /// - a kernel function
         /// - a mean function
         /// - [optional] an optimizer for the hyper-parameters
-        template <typename Params, typename KernelFunction = kernel::MaternFiveHalves<Params>, typename MeanFunction = mean::Data<Params>, typename HyperParamsOptimizer = gp::NoLFOpt<Params>>
+        /// - [optional] a policy for the storage and the factorization of the kernel matrix (gp::DoublePrecision, gp::MixedPrecision, gp::Compact, gp::Tiled, gp::ConjugateGradient)
+        template <typename Params, typename KernelFunction = kernel::MaternFiveHalves<Params>, typename MeanFunction = mean::Data<Params>, typename HyperParamsOptimizer = gp::NoLFOpt<Params>, typename Factorization = gp::DoublePrecision>
         class GP {
         public:
+            /// scalar type of the kernel matrix and of its Cholesky factor
+            using scalar_t = typename Factorization::scalar_t;
+            using matrix_t = Eigen::Matrix<scalar_t, Eigen::Dynamic, Eigen::Dynamic>;
+
             /// useful because the model might be created before knowing anything about the process
-            GP() : _dim_in(-1), _dim_out(-1), _inv_kernel_updated(false) {}
+            GP() : _dim_in(-1), _dim_out(-1), _nb_samples(0), _inv_kernel_updated(false), _max_window(0) {}
 
             /// useful because the model might be created before having samples
             GP(int dim_in, int dim_out)
-                : _dim_in(dim_in), _dim_out(dim_out), _kernel_function(dim_in), _mean_function(dim_out), _inv_kernel_updated(false) {}
+                : _dim_in(dim_in), _dim_out(dim_out), _kernel_function(dim_in), _mean_function(dim_out), _nb_samples(0), _inv_kernel_updated(false), _max_window(0) {}
 
             /// Compute the GP from samples and observations. This call needs to be explicit!
             void compute(const std::vector<Eigen::VectorXd>& samples,
@@ -102,13 +111,20 @@ namespace limbo {
                     _mean_function = MeanFunction(_dim_out); // the cost of building a functor should be relatively low
                 }
 
-                _samples = samples;
+                // samples are stored contiguously (one sample per column)
+                _nb_samples = samples.size();
+                _samples.resize(_dim_in, _nb_samples);
+                for (int i = 0; i < _nb_samples; ++i)
+                    _samples.col(i) = samples[i];
+
+                _distance_cache.reset();
 
                 _observations.resize(observations.size(), _dim_out);
                 for (int i = 0; i < _observations.rows(); ++i)
                     _observations.row(i) = observations[i];
 
                 _mean_observation = _observations.colwise().mean();
+                _alpha.resize(0, 0); // (no initial guess for an iterative solver)
 
                 this->_compute_obs_mean();
                 if (compute_kernel)
@@ -119,13 +135,15 @@ namespace limbo {
             void optimize_hyperparams()
             {
                 _hp_optimize(*this);
+                // the cached distances (up to 1 GB for ARD kernels) are only useful while the hyper-parameters change
+                _distance_cache.reset();
             }
 
             /// add sample and update the GP. This code uses an incremental implementation of the Cholesky
             /// decomposition. It is therefore much faster than a call to compute()
             void add_sample(const Eigen::VectorXd& sample, const Eigen::VectorXd& observation)
             {
-                if (_samples.empty()) {
+                if (_nb_samples == 0) {
                     if (_dim_in != sample.size()) {
                         _dim_in = sample.size();
                         _kernel_function = KernelFunction(_dim_in); // the cost of building a functor should be relatively low
@@ -140,17 +158,134 @@ namespace limbo {
                     assert(observation.size() == _dim_out);
                 }
 
-                _samples.push_back(sample);
+                // amortized growth of the sample storage
+                if (_nb_samples == _samples.cols())
+                    _samples.conservativeResize(_dim_in, std::max(2 * _nb_samples, 1));
+                _samples.col(_nb_samples++) = sample;
+                _distance_cache.reset();
 
                 _observations.conservativeResize(_observations.rows() + 1, _dim_out);
                 _observations.bottomRows<1>() = observation.transpose();
 
-                _mean_observation = _observations.colwise().mean();
+                _update_mean_observation(1);
 
                 this->_compute_obs_mean();
                 this->_compute_incremental_kernel();
+
+                // sliding window: forget the oldest sample
+                if (_max_window > 0 && _nb_samples > _max_window)
+                    remove_sample(0);
             }
 
+            /// add a batch of samples (the rows of X) with their observations (the rows of Y) and update the GP.
+            /// The Cholesky factor is extended by blocks (one triangular solve and one Cholesky decomposition
+            /// of size X.rows()), and alpha is computed only once
+            void add_samples(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Y)
+            {
+                assert(X.rows() == Y.rows());
+                int k = X.rows();
+                if (k == 0)
+                    return;
+
+                if (_nb_samples == 0) {
+                    if (_dim_in != X.cols()) {
+                        _dim_in = X.cols();
+                        _kernel_function = KernelFunction(_dim_in); // the cost of building a functor should be relatively low
+                    }
+                    if (_dim_out != Y.cols()) {
+                        _dim_out = Y.cols();
+                        _mean_function = MeanFunction(_dim_out); // the cost of building a functor should be relatively low
+                    }
+                }
+                else {
+                    assert(X.cols() == _dim_in);
+                    assert(Y.cols() == _dim_out);
+                }
+
+                if (_nb_samples + k > _samples.cols())
+                    _samples.conservativeResize(_dim_in, std::max(2 * _nb_samples, _nb_samples + k));
+                _samples.middleCols(_nb_samples, k) = X.transpose();
+                _nb_samples += k;
+                _distance_cache.reset();
+
+                _observations.conservativeResize(_observations.rows() + k, _dim_out);
+                _observations.bottomRows(k) = Y;
+
+                _update_mean_observation(k);
+
+                this->_compute_obs_mean();
+                if (_nb_samples == k)
+                    this->_compute_full_kernel();
+                else
+                    this->_compute_incremental_kernel(k);
+
+                while (_max_window > 0 && _nb_samples > _max_window)
+                    remove_sample(0);
+            }
+
+            /// remove the i-th sample and update the GP. The Cholesky factor is updated in O(n^2)
+            /// (rank-1 update of the block below the removed row) instead of being recomputed
+            void remove_sample(int i)
+            {
+                assert(i >= 0 && i < _nb_samples);
+                int n = _nb_samples;
+
+                for (int j = i; j < n - 1; ++j)
+                    _samples.col(j) = _samples.col(j + 1);
+                _nb_samples--;
+                _distance_cache.reset();
+
+                _remove_row(_observations, i);
+
+                if (_nb_samples == 0) {
+                    _mean_vector.resize(0, _dim_out);
+                    _obs_mean.resize(0, _dim_out);
+                    _alpha.resize(0, _dim_out);
+                    _kernel.resize(0, 0);
+                    _matrixL.resize(0, 0);
+                    _panels.clear();
+                    _l_inv_obs.resize(0, _dim_out);
+                    _l_inv_ones.resize(0);
+                    _inv_kernel_updated = false;
+                    return;
+                }
+
+                _mean_observation = _observations.colwise().mean();
+                this->_compute_obs_mean();
+
+                if (Factorization::iterative()) {
+                    // the previous alpha, without the removed sample, is the initial guess
+                    _remove_row(_alpha, i);
+                    this->_compute_iterative();
+                    return;
+                }
+
+                // with L = [L11 0 0; l21 l22 0; L31 l32 L33], removing the i-th row and column gives
+                // [L11 0; L31 L33'] with L33' * L33'^T = L33 * L33^T + l32 * l32^T
+                if (Factorization::compact())
+                    _remove_from_panels(i, n);
+                else {
+                    _remove_from_matrixL(i, n);
+                    _remove_row(_kernel, i);
+                    _remove_col(_kernel, i);
+                }
+
+                this->_compute_forward_solve(_nb_samples);
+                this->_compute_alpha();
+                _inv_kernel_updated = false;
+            }
+
+            /// keep at most `max_window` samples: add_sample() removes the oldest sample when there are more
+            /// (0, the default, means no limit)
+            void set_max_window(int max_window)
+            {
+                _max_window = max_window;
+                while (_max_window > 0 && _nb_samples > _max_window)
+                    remove_sample(0);
+            }
+
+            int max_window() const { return _max_window; }
+
             /**
              \\rst
              return :math:`\mu`, :math:`\sigma^2` (un-normalized). If there is no sample, return the value according to the mean function. Using this method instead of separate calls to mu() and sigma() is more efficient because some computations are shared between mu() and sigma().
@@ -158,12 +293,37 @@ namespace limbo {
             */
             std::tuple<Eigen::VectorXd, double> query(const Eigen::VectorXd& v) const
             {
-                if (_samples.size() == 0)
+                if (_nb_samples == 0)
                     return std::make_tuple(_mean_function(v, *this),
                         _kernel_function(v, v) + _kernel_function.noise());
 
-                Eigen::VectorXd k = _compute_k(v);
-                return std::make_tuple(_mu(v, k), _sigma(v, k) + _kernel_function.noise());
+                Eigen::VectorXd mu(_dim_out);
+                double sigma;
+                query(v, mu, sigma);
+                return std::make_tuple(mu, sigma);
+            }
+
+            /**
+             \\rst
+             same as query(v), but :math:`\mu` is written into ``mu`` (of size ``dim_out()``) and :math:`\sigma^2` into ``sigma``. The intermediate vectors are kept in buffers that belong to the calling thread and are reused from one call to the next: once they are large enough, this does not allocate memory (except in the mean function, if it is not constant; see ``mean::is_constant``).
+
+             All the queries (query(), mu(), sigma() and their batch versions) only read the GP, so they can be called concurrently from several threads, as long as no thread modifies the GP (e.g. with add_sample() or optimize_hyperparams()) at the same time.
+             \\endrst
+            */
+            void query(const Eigen::VectorXd& v, Eigen::Ref<Eigen::VectorXd> mu, double& sigma) const
+            {
+                if (_nb_samples == 0) {
+                    mu = _mean_function(v, *this);
+                    sigma = _kernel_function(v, v) + _kernel_function.noise();
+                    return;
+                }
+
+                _mean(v, mu);
+                QueryScratch& scratch = _query_scratch(_nb_samples);
+                auto k = scratch.k.head(_nb_samples);
+                _compute_k(v, k);
+                mu.noalias() += _alpha.transpose() * k;
+                sigma = _sigma(v, k) + _kernel_function.noise();
             }
 
             /**
@@ -173,21 +333,173 @@ namespace limbo {
             */
             Eigen::VectorXd mu(const Eigen::VectorXd& v) const
             {
-                if (_samples.size() == 0)
+                if (_nb_samples == 0)
                     return _mean_function(v, *this);
-                return _mu(v, _compute_k(v));
+
+                Eigen::VectorXd m(_dim_out);
+                mu(v, m);
+                return m;
+            }
+
+            /// same as mu(v), but :math:`\mu` is written into ``m`` (of size ``dim_out()``), without allocation (see query())
+            void mu(const Eigen::VectorXd& v, Eigen::Ref<Eigen::VectorXd> m) const
+            {
+                if (_nb_samples == 0) {
+                    m = _mean_function(v, *this);
+                    return;
+                }
+
+                _mean(v, m);
+                QueryScratch& scratch = _query_scratch(_nb_samples);
+                auto k = scratch.k.head(_nb_samples);
+                _compute_k(v, k);
+                m.noalias() += _alpha.transpose() * k;
             }
 
             /**
              \\rst
-             return :math:`\sigma^2` (un-normalized). If there is no sample, return the max :math:`\sigma^2`.
+             return :math:`\sigma^2` (un-normalized). If there is no sample, return the max :math:`\sigma^2`. Like query(), this uses the buffers of the calling thread and does not allocate memory.
              \\endrst
             */
             double sigma(const Eigen::VectorXd& v) const
             {
-                if (_samples.size() == 0)
+                if (_nb_samples == 0)
                     return _kernel_function(v, v) + _kernel_function.noise();
-                return _sigma(v, _compute_k(v)) + _kernel_function.noise();
+
+                QueryScratch& scratch = _query_scratch(_nb_samples);
+                auto k = scratch.k.head(_nb_samples);
+                _compute_k(v, k);
+                return _sigma(v, k) + _kernel_function.noise();
+            }
+
+            /**
+             \\rst
+             return :math:`\mu`, :math:`\sigma^2` (un-normalized) and their derivatives with respect to the input: the (``dim_out() x dim_in()``) Jacobian of :math:`\mu` and the gradient of :math:`\sigma^2`. The cross-kernel and the forward substitution of query() are reused, with the derivatives of the kernel given by ``grad_input()``. The derivative of the mean function is zero for constant mean functions (see ``mean::is_constant``) and is computed by finite differences otherwise. Like query(), this can be called concurrently from several threads.
+             \\endrst
+            */
+            std::tuple<Eigen::VectorXd, double, Eigen::MatrixXd, Eigen::VectorXd> query_grad(const Eigen::VectorXd& v) const
+            {
+                // d k(v, v) / dv, with k symmetrical (zero for stationary kernels)
+                Eigen::VectorXd dsigma = 2 * _kernel_function.grad_input(v, v);
+                if (_nb_samples == 0) {
+                    Eigen::VectorXd mu = _mean_function(v, *this);
+                    return std::make_tuple(mu, _kernel_function(v, v) + _kernel_function.noise(), _mean_grad_input(v, mu.size()), dsigma);
+                }
+
+                Eigen::VectorXd mu(_dim_out);
+                _mean(v, mu);
+                QueryScratch& scratch = _query_scratch(_nb_samples);
+                auto k = scratch.k.head(_nb_samples);
+                _compute_k(v, k);
+                mu.noalias() += _alpha.transpose() * k;
+                // leaves z = L^{-1} * k in the scratch
+                double sigma = _sigma(v, k);
+
+                // row i: d k(v, x_i) / dv
+                Eigen::MatrixXd dK(_nb_samples, v.size());
+                for (int i = 0; i < _nb_samples; i++)
+                    dK.row(i) = _kernel_function.grad_input(v, _samples.col(i)).transpose();
+
+                Eigen::MatrixXd dmu = _mean_grad_input(v, _dim_out);
+                dmu.noalias() += _alpha.transpose() * dK;
+
+                if (sigma > 0 && Factorization::iterative()) {
+                    // z = R^T * k, with K^{-1} ~ R * R^T
+                    dsigma.noalias() -= 2 * dK.transpose() * (_var_factor * scratch.z.head(_var_factor.cols()).template cast<double>());
+                }
+                else if (sigma > 0) {
+                    // d(z^T z) / dv = 2 * dK^T * L^{-T} * z
+                    auto z = scratch.z.head(_nb_samples);
+                    _upper_solve_in_place(z);
+                    dsigma.noalias() -= 2 * dK.transpose() * z.template cast<double>();
+                }
+                else
+                    dsigma.setZero();
+
+                return std::make_tuple(mu, sigma + _kernel_function.noise(), dmu, dsigma);
+            }
+
+            /**
+             \\rst
+             return :math:`\mu`, :math:`\sigma^2` (un-normalized) for a batch of points (one point per row of ``X``). The cross-kernel between the samples and the points is computed once and a single multi-RHS triangular solve is used for all the points, which is much faster than calling query() for each point. :math:`\mu` is returned as a (MxD) matrix (M points, D output dimensions) and :math:`\sigma^2` as a vector of size M.
+             \\endrst
+            */
+            std::tuple<Eigen::MatrixXd, Eigen::VectorXd> query_batch(const Eigen::MatrixXd& X) const
+            {
+                if (_nb_samples == 0)
+                    return std::make_tuple(_mean_batch(X), sigma_batch(X));
+
+                Eigen::MatrixXd K = _compute_k_batch(X);
+                Eigen::VectorXd sigma = _sigma_batch(X, K).array() + _kernel_function.noise();
+                return std::make_tuple(_mu_batch(X, K), sigma);
+            }
+
+            /**
+             \\rst
+             return :math:`\mu` (un-normalized) for a batch of points (one point per row of ``X``) as a (MxD) matrix. If there is no sample, return the value according to the mean function.
+             \\endrst
+            */
+            Eigen::MatrixXd mu_batch(const Eigen::MatrixXd& X) const
+            {
+                if (_nb_samples == 0)
+                    return _mean_batch(X);
+                return _mu_batch(X, _compute_k_batch(X));
+            }
+
+            /**
+             \\rst
+             return :math:`\sigma^2` (un-normalized) for a batch of points (one point per row of ``X``). If there is no sample, return the max :math:`\sigma^2`.
+             \\endrst
+            */
+            Eigen::VectorXd sigma_batch(const Eigen::MatrixXd& X) const
+            {
+                if (_nb_samples == 0)
+                    return _kernel_diag_batch(X).array() + _kernel_function.noise();
+                return _sigma_batch(X, _compute_k_batch(X)).array() + _kernel_function.noise();
+            }
+
+            /**
+             \\rst
+             return the (MxM) joint posterior covariance (un-normalized) of the M rows of ``X``, computed with a single multi-RHS triangular solve. Like sigma(), it includes the noise, so that its diagonal is ``sigma_batch(X)``.
+             \\endrst
+            */
+            Eigen::MatrixXd posterior_cov(const Eigen::MatrixXd& X) const
+            {
+                Eigen::MatrixXd C = _kernel_function.kernel_matrix(X.transpose(), X.transpose());
+                C.diagonal().array() += _kernel_function.noise();
+                if (_nb_samples == 0)
+                    return C;
+
+                Eigen::MatrixXd Z = _whiten(_compute_k_batch(X));
+                C.noalias() -= Z.transpose() * Z;
+                return C;
+            }
+
+            /**
+             \\rst
+             return ``n_draws`` joint samples of the posterior (un-normalized, noise included as in posterior_cov()) at the M rows of ``X``, each as a (MxD) matrix (like mu_batch()). ``rng.rand()`` should return samples of :math:`\mathcal{N}(0, 1)` (e.g. a ``tools::rgen_gauss_t(0, 1)``).
+
+             - if M <= ``max_exact_size``, the Cholesky of posterior_cov() is used (with a jitter on the diagonal if needed)
+             - otherwise, prior samples are drawn with a low-rank (Nystrom) approximation of the prior built on the samples and on 256 rows of ``X``, with the missing variance added independently for each point, and they are turned into posterior samples with a pathwise update (Matheron's rule) that reuses the factor of the GP. The covariance between the rows of ``X`` is then approximate, but the marginal variances are exact and the cost is only linear in M.
+             \\endrst
+            */
+            template <typename Rng>
+            std::vector<Eigen::MatrixXd> sample_posterior(const Eigen::MatrixXd& X, int n_draws, Rng& rng, int max_exact_size = 1000) const
+            {
+                Eigen::MatrixXd mu = mu_batch(X);
+                int d = mu.cols();
+
+                // all the draws and outputs at once: column i * d + j is output j of draw i
+                Eigen::MatrixXd F;
+                if (X.rows() <= max_exact_size)
+                    F = _jittered_cholesky(posterior_cov(X)).template triangularView<Eigen::Lower>() * _gaussian_matrix(X.rows(), n_draws * d, rng);
+                else
+                    F = _pathwise_draws(X, n_draws * d, rng);
+
+                std::vector<Eigen::MatrixXd> draws(n_draws, mu);
+                for (int i = 0; i < n_draws; i++)
+                    draws[i] += F.middleCols(i * d, d);
+                return draws;
             }
 
             /// return the number of dimensions of the input
@@ -226,7 +538,7 @@ namespace limbo {
             Eigen::VectorXd mean_observation() const
             {
                 assert(_dim_out > 0);
-                return _samples.size() > 0 ? _mean_observation
+                return _nb_samples > 0 ? _mean_observation
                                            : Eigen::VectorXd::Zero(_dim_out);
             }
 
@@ -235,18 +547,21 @@ namespace limbo {
             const Eigen::MatrixXd& obs_mean() const { return _obs_mean; }
 
             /// return the number of samples used to compute the GP
-            int nb_samples() const { return _samples.size(); }
+            int nb_samples() const { return _nb_samples; }
 
             ///  recomputes the GP
             void recompute(bool update_obs_mean = true, bool update_full_kernel = true)
             {
-                assert(!_samples.empty());
+                assert(_nb_samples > 0);
 
                 if (update_obs_mean)
                     this->_compute_obs_mean();
 
-                if (update_full_kernel)
+                if (update_full_kernel) {
+                    // the hyper-parameter optimizers end here: the distances cached for their evaluations are dropped
+                    _distance_cache.reset();
                     this->_compute_full_kernel();
+                }
                 else
                     this->_compute_alpha();
             }
@@ -257,8 +572,7 @@ namespace limbo {
                 // K^{-1} using Cholesky decomposition
                 _inv_kernel = Eigen::MatrixXd::Identity(n, n);
 
-                _matrixL.template triangularView<Eigen::Lower>().solveInPlace(_inv_kernel);
-                _matrixL.template triangularView<Eigen::Lower>().transpose().solveInPlace(_inv_kernel);
+                _solve(_inv_kernel);
 
                 _inv_kernel_updated = true;
             }
@@ -266,12 +580,19 @@ namespace limbo {
             /// compute and return the log likelihood
             double compute_log_lik()
             {
+                if (Factorization::iterative()) {
+                    // stochastic estimate (see gp::ConjugateGradient)
+                    LikelihoodWorkspace ws;
+                    _log_lik = _compute_log_lik(_kernel_function, _obs_mean, ws);
+                    return _log_lik;
+                }
+
                 size_t n = _obs_mean.rows();
 
                 // --- cholesky ---
                 // see:
                 // http://xcorr.net/2008/06/11/log-determinant-of-positive-definite-matrices-in-matlab/
-                long double logdet = 2 * _matrixL.diagonal().array().log().sum();
+                long double logdet = 2 * _factor_diagonal().array().log().sum();
 
                 double a = (_obs_mean.transpose() * _alpha)
                                .trace(); // generalization for multi dimensional observation
@@ -284,30 +605,30 @@ namespace limbo {
             /// compute and return the gradient of the log likelihood wrt to the kernel parameters
             Eigen::VectorXd compute_kernel_grad_log_lik()
             {
-                size_t n = _obs_mean.rows();
+                if (Factorization::iterative()) {
+                    LikelihoodWorkspace ws;
+                    _compute_log_lik(_kernel_function, _obs_mean, ws);
+                    return compute_kernel_grad_log_lik(_kernel_function, ws);
+                }
 
-                // compute K^{-1} only if needed
-                if (!_inv_kernel_updated) {
-                    compute_inv_kernel();
+                if (Factorization::compact()) {
+                    return _compact_grad_log_lik(_kernel_function, _alpha, [this](Eigen::Ref<Eigen::MatrixXd> E, int start) {
+                        _solve_lower(E.bottomRows(E.rows() - start), start);
+                        _solve_upper(E);
+                    });
                 }
-                Eigen::MatrixXd w = _inv_kernel;
+
+                // compute K^{-1} only if needed
+                Eigen::MatrixXd w;
+                const Eigen::MatrixXd& inv_kernel = _get_inv_kernel(w);
 
                 // alpha * alpha.transpose() - K^{-1}
-                w = _alpha * _alpha.transpose() - w;
-
-                // only compute half of the matrix (symmetrical matrix)
-                Eigen::VectorXd grad = Eigen::VectorXd::Zero(_kernel_function.h_params_size());
-                for (size_t i = 0; i < n; ++i) {
-                    for (size_t j = 0; j <= i; ++j) {
-                        Eigen::VectorXd g = _kernel_function.grad(_samples[i], _samples[j], i, j);
-                        if (i == j)
-                            grad += w(i, j) * g * 0.5;
-                        else
-                            grad += w(i, j) * g;
-                    }
-                }
+                w = _alpha * _alpha.transpose() - inv_kernel;
 
-                return grad;
+                // (the distances are only kept by the likelihood evaluations of the hyper-parameter optimizers)
+                kernel::DistanceCache cache;
+                cache.bind(samples_matrix());
+                return _kernel_grad_log_lik(_kernel_function, w, cache);
             }
 
             /// compute and return the gradient of the log likelihood wrt to the mean parameters
@@ -315,20 +636,134 @@ namespace limbo {
             {
                 size_t n = _obs_mean.rows();
 
+                Eigen::VectorXd grad = Eigen::VectorXd::Zero(_mean_function.h_params_size());
+                if (Factorization::compact() || Factorization::iterative()) {
+                    // obs_mean^T * K^{-1} = alpha^T
+                    for (size_t n_obs = 0; n_obs < n; n_obs++)
+                        grad += (_alpha.row(n_obs) * _mean_function.grad(_samples.col(n_obs), *this)).transpose();
+                    return grad;
+                }
+
                 // compute K^{-1} only if needed
                 if (!_inv_kernel_updated) {
                     compute_inv_kernel();
                 }
 
-                Eigen::VectorXd grad = Eigen::VectorXd::Zero(_mean_function.h_params_size());
                 for (int i_obs = 0; i_obs < _dim_out; ++i_obs)
                     for (size_t n_obs = 0; n_obs < n; n_obs++) {
-                        grad += _obs_mean.col(i_obs).transpose() * _inv_kernel.col(n_obs) * _mean_function.grad(_samples[n_obs], *this).row(i_obs);
+                        grad += _obs_mean.col(i_obs).transpose() * _inv_kernel.col(n_obs) * _mean_function.grad(_samples.col(n_obs), *this).row(i_obs);
                     }
 
                 return grad;
             }
 
+            /// preconditioner of the conjugate gradients of an iterative solver (see gp::ConjugateGradient):
+            /// P = F * F^T + noise * I, with F (n x r) a pivoted Cholesky decomposition of the kernel matrix
+            struct Preconditioner {
+                Eigen::MatrixXd factor;
+                /// Cholesky decomposition of noise * I + F^T * F (r x r)
+                Eigen::LLT<Eigen::MatrixXd> llt;
+                double noise = 1;
+
+                /// Z = P^{-1} * R (Woodbury identity, in O(n * r) per column)
+                void operator()(const Eigen::MatrixXd& R, Eigen::MatrixXd& Z) const
+                {
+                    Z = R;
+                    if (factor.cols() > 0)
+                        Z.noalias() -= factor * llt.solve(factor.transpose() * R);
+                    Z /= noise;
+                }
+
+                /// log |P| = (n - r) * log(noise) + log |noise * I + F^T * F|
+                double log_det() const
+                {
+                    double res = (factor.rows() - factor.cols()) * std::log(noise);
+                    if (factor.cols() > 0)
+                        res += 2 * llt.matrixLLT().diagonal().array().log().sum();
+                    return res;
+                }
+            };
+
+            /// buffers used to evaluate the log likelihood for other hyper-parameters
+            /// without copying (or modifying) the GP (see gp::KernelLFOpt);
+            /// they keep their memory between two evaluations with the same number of samples
+            struct LikelihoodWorkspace {
+                /// kernel matrix, then (alpha * alpha^T - K^{-1}) for the gradient
+                Eigen::MatrixXd kernel;
+                Eigen::LLT<Eigen::MatrixXd> llt;
+                Eigen::MatrixXd obs_mean;
+                Eigen::MatrixXd alpha;
+                /// with an iterative solver, the kernel matrix is not stored: K^{-1} * Z and P^{-1} * Z
+                /// for the Hutchinson probes Z, and the preconditioner P
+                Eigen::MatrixXd probe_solves;
+                Eigen::MatrixXd preconditioned_probes;
+                Preconditioner preconditioner;
+                /// with a compact factorization, the factor by panels (the kernel matrix is not stored)
+                std::vector<Eigen::MatrixXd> panels;
+            };
+
+            /// compute and return the log likelihood of the current samples
+            /// with the kernel function `kernel_function` (and the current mean);
+            /// the factorization is stored in `ws` and the GP is left untouched
+            double compute_log_lik(const KernelFunction& kernel_function, LikelihoodWorkspace& ws) const
+            {
+                return _compute_log_lik(kernel_function, _obs_mean, ws);
+            }
+
+            /// compute and return the log likelihood of the current samples
+            /// with the kernel function `kernel_function` and the mean function `mean_function`
+            double compute_log_lik(const KernelFunction& kernel_function, const MeanFunction& mean_function, LikelihoodWorkspace& ws) const
+            {
+                ws.obs_mean.resize(_nb_samples, _dim_out);
+                for (int i = 0; i < _nb_samples; i++)
+                    ws.obs_mean.row(i) = _observations.row(i) - mean_function(_samples.col(i), *this).transpose();
+
+                return _compute_log_lik(kernel_function, ws.obs_mean, ws);
+            }
+
+            /// compute and return the gradient of the log likelihood wrt to the parameters of `kernel_function`
+            /// (call compute_log_lik(kernel_function, ..., ws) first)
+            Eigen::VectorXd compute_kernel_grad_log_lik(const KernelFunction& kernel_function, LikelihoodWorkspace& ws) const
+            {
+                if (Factorization::iterative()) {
+                    // alpha * alpha^T - K^{-1}, with K^{-1} ~ (K^{-1} * Z) * (P^{-1} * Z)^T / nb_probes
+                    int p = ws.probe_solves.cols();
+                    Eigen::MatrixXd A(_nb_samples, _dim_out + p), B(_nb_samples, _dim_out + p);
+                    A << ws.alpha, -ws.probe_solves / p;
+                    B << ws.alpha, ws.preconditioned_probes;
+                    return 0.5 * _low_rank_grad_trace(kernel_function, A, B);
+                }
+
+                if (Factorization::compact()) {
+                    return _compact_grad_log_lik(kernel_function, ws.alpha, [&ws](Eigen::Ref<Eigen::MatrixXd> E, int start) {
+                        Eigen::Ref<Eigen::MatrixXd> lower = E.bottomRows(E.rows() - start);
+                        _lower_solve_panels(ws.panels, lower, start);
+                        _upper_solve_panels(ws.panels, E);
+                    });
+                }
+
+                // the kernel matrix is not needed anymore: K^{-1} is computed in place,
+                // then turned into alpha * alpha.transpose() - K^{-1}
+                ws.kernel.setIdentity(_nb_samples, _nb_samples);
+                ws.llt.solveInPlace(ws.kernel);
+                ws.kernel *= -1;
+                ws.kernel.noalias() += ws.alpha * ws.alpha.transpose();
+
+                return _kernel_grad_log_lik(kernel_function, ws.kernel, _cache());
+            }
+
+            /// compute and return the gradient of the log likelihood wrt to the parameters of `mean_function`
+            /// (call compute_log_lik(kernel_function, mean_function, ws) first)
+            Eigen::VectorXd compute_mean_grad_log_lik(const MeanFunction& mean_function, const LikelihoodWorkspace& ws) const
+            {
+                // obs_mean^T * K^{-1} = alpha^T
+                Eigen::VectorXd grad = Eigen::VectorXd::Zero(mean_function.h_params_size());
+                for (int n_obs = 0; n_obs < _nb_samples; n_obs++)
+                    grad += (ws.alpha.row(n_obs) * mean_function.grad(_samples.col(n_obs), *this)).transpose();
+
+                return grad;
+            }
+
             /// return the likelihood (do not compute it -- return last computed)
             double get_log_lik() const { return _log_lik; }
 
@@ -338,12 +773,8 @@ namespace limbo {
             /// compute and return the log probability of LOO CV
             double compute_log_loo_cv()
             {
-                // compute K^{-1} only if needed
-                if (!_inv_kernel_updated) {
-                    compute_inv_kernel();
-                }
-
-                Eigen::VectorXd inv_diag = _inv_kernel.diagonal().array().inverse();
+                // only the diagonal of K^{-1} is needed
+                Eigen::VectorXd inv_diag = _inv_kernel_diagonal().array().inverse();
 
                 _log_loo_cv = (((-0.5 * (_alpha.array().square().array().colwise() * inv_diag.array())).array().colwise() - 0.5 * inv_diag.array().log().array()) - 0.5 * std::log(2 * M_PI)).colwise().sum().sum();
 
@@ -357,48 +788,30 @@ namespace limbo {
                 size_t n_params = _kernel_function.h_params_size();
 
                 // compute K^{-1} only if needed
-                if (!_inv_kernel_updated) {
-                    compute_inv_kernel();
-                }
+                Eigen::MatrixXd inv_tmp;
+                const Eigen::MatrixXd& inv_kernel = _get_inv_kernel(inv_tmp);
 
-                Eigen::VectorXd grad = Eigen::VectorXd::Zero(n_params);
                 Eigen::MatrixXd grads = Eigen::MatrixXd::Zero(n_params, _dim_out);
-
-                // only compute half of the matrix (symmetrical matrix)
-                // TO-DO: Make it better
-                std::vector<std::vector<Eigen::VectorXd>> full_dk;
-                for (size_t i = 0; i < n; i++) {
-                    full_dk.push_back(std::vector<Eigen::VectorXd>());
-                    for (size_t j = 0; j <= i; j++)
-                        full_dk[i].push_back(_kernel_function.grad(_samples[i], _samples[j], i, j));
-                    for (size_t j = i + 1; j < n; j++)
-                        full_dk[i].push_back(Eigen::VectorXd::Zero(n_params));
-                }
-                for (size_t i = 0; i < n; i++)
-                    for (size_t j = 0; j < i; ++j)
-                        full_dk[j][i] = full_dk[i][j];
-
-                Eigen::VectorXd inv_diag = _inv_kernel.diagonal().array().inverse();
-
-                for (int j = 0; j < grad.size(); j++) {
-                    Eigen::MatrixXd dKdTheta_j = Eigen::MatrixXd::Zero(n, n);
-                    for (size_t i = 0; i < n; i++) {
-                        for (size_t k = 0; k < n; k++)
-                            dKdTheta_j(i, k) = full_dk[i][k](j);
-                    }
-                    Eigen::MatrixXd Zeta_j = _inv_kernel * dKdTheta_j;
+                Eigen::VectorXd inv_diag = inv_kernel.diagonal().array().inverse();
+
+                // dK/dtheta_j is computed for one parameter at a time (O(n^2) memory per parameter),
+                // and only the diagonal of Zeta_j * K^{-1} is needed
+                kernel::DistanceCache cache;
+                cache.bind(samples_matrix());
+                tools::par::loop(0, n_params, [&](size_t j) {
+                    Eigen::MatrixXd dKdTheta_j(n, n);
+                    _kernel_function.cached_grad_matrix(cache, j, dKdTheta_j);
+
+                    Eigen::MatrixXd Zeta_j(n, n);
+                    Zeta_j.noalias() = inv_kernel * dKdTheta_j;
                     Eigen::MatrixXd Zeta_j_alpha = Zeta_j * _alpha;
-                    Eigen::MatrixXd Zeta_j_K = Zeta_j * _inv_kernel;
+                    // diag(Zeta_j * K^{-1}) (K^{-1} is symmetrical)
+                    Eigen::VectorXd Zeta_j_K_diag = Zeta_j.cwiseProduct(inv_kernel).rowwise().sum();
 
-                    grads.row(j) = ((_alpha.array() * Zeta_j_alpha.array() - 0.5 * ((1. + _alpha.array().square().array().colwise() * inv_diag.array()).array().colwise() * Zeta_j_K.diagonal().array())).array().colwise() * inv_diag.array()).colwise().sum();
+                    grads.row(j) = ((_alpha.array() * Zeta_j_alpha.array() - 0.5 * ((1. + _alpha.array().square().array().colwise() * inv_diag.array()).array().colwise() * Zeta_j_K_diag.array())).array().colwise() * inv_diag.array()).colwise().sum();
+                });
 
-                    // for (size_t i = 0; i < n; i++)
-                    //     grads.row(j).array() += (_alpha.row(i).array() * Zeta_j_alpha.row(i).array() - 0.5 * (1. + _alpha.row(i).array().square() / _inv_kernel.diagonal()(i)) * Zeta_j_K.diagonal()(i)) / _inv_kernel.diagonal()(i);
-                }
-
-                grad = grads.rowwise().sum();
-
-                return grad;
+                return grads.rowwise().sum();
             }
 
             /// return the LOO-CV log probability (do not compute it -- return last computed)
@@ -407,13 +820,27 @@ namespace limbo {
             /// set the LOO-CV log probability (e.g. computed from outside)
             void set_log_loo_cv(double log_loo_cv) { _log_loo_cv = log_loo_cv; }
 
-            /// LLT matrix (from Cholesky decomposition)
-            const Eigen::MatrixXd& matrixL() const { return _matrixL; }
+            /// LLT matrix (from Cholesky decomposition); empty with a compact factorization (see gp::Compact) or an iterative solver (see gp::ConjugateGradient)
+            const matrix_t& matrixL() const { return _matrixL; }
 
             const Eigen::MatrixXd& alpha() const { return _alpha; }
 
-            /// return the list of samples
-            const std::vector<Eigen::VectorXd>& samples() const { return _samples; }
+            /// return the list of samples (compatibility view: the samples are copied from the internal storage)
+            std::vector<Eigen::VectorXd> samples() const
+            {
+                std::vector<Eigen::VectorXd> samples(_nb_samples);
+                for (int i = 0; i < _nb_samples; i++)
+                    samples[i] = _samples.col(i);
+
+                return samples;
+            }
+
+            /// return the samples (in matrix form)
+            /// (DxN), where D is the dimension of the input and N the number of points
+            Eigen::MatrixXd::ConstColsBlockXpr samples_matrix() const
+            {
+                return _samples.leftCols(_nb_samples);
+            }
 
             /// return the list of observations
             std::vector<Eigen::VectorXd> observations() const
@@ -453,9 +880,12 @@ namespace limbo {
                 if (_mean_function.h_params_size() > 0) {
                     archive.save(_mean_function.h_params(), "mean_params");
                 }
-                archive.save(_samples, "samples");
+                archive.save(samples(), "samples");
                 archive.save(_observations, "observations");
-                archive.save(_matrixL, "matrixL");
+                if (Factorization::compact())
+                    archive.save(_packed_factor(), "matrixL_packed");
+                else if (!Factorization::iterative())
+                    archive.save(Eigen::MatrixXd(_matrixL.template cast<double>()), "matrixL");
                 archive.save(_alpha, "alpha");
             }
 
@@ -475,14 +905,20 @@ namespace limbo {
             template <typename A>
             void load(const A& archive, bool recompute = true)
             {
-                _samples.clear();
-                archive.load(_samples, "samples");
+                std::vector<Eigen::VectorXd> samples;
+                archive.load(samples, "samples");
 
                 archive.load(_observations, "observations");
 
-                _dim_in = _samples[0].size();
+                _dim_in = samples[0].size();
                 _kernel_function = KernelFunction(_dim_in);
 
+                _nb_samples = samples.size();
+                _samples.resize(_dim_in, _nb_samples);
+                for (int i = 0; i < _nb_samples; ++i)
+                    _samples.col(i) = samples[i];
+                _distance_cache.reset();
+
                 if (_kernel_function.h_params_size() > 0) {
                     Eigen::VectorXd h_params;
                     archive.load(h_params, "kernel_params");
@@ -502,11 +938,23 @@ namespace limbo {
 
                 _mean_observation = _observations.colwise().mean();
 
-                if (recompute)
+                // (there is no factor to load with an iterative solver)
+                if (recompute || Factorization::iterative())
                     this->recompute(true, true);
                 else {
-                    archive.load(_matrixL, "matrixL");
+                    // (the queries of constant mean functions read the mean vector)
+                    this->_compute_obs_mean();
+                    Eigen::MatrixXd L;
+                    if (Factorization::compact()) {
+                        archive.load(L, "matrixL_packed");
+                        _unpack_factor(L);
+                    }
+                    else {
+                        archive.load(L, "matrixL");
+                        _matrixL = L.template cast<scalar_t>();
+                    }
                     archive.load(_alpha, "alpha");
+                    this->_compute_forward_solve(_nb_samples);
                 }
             }
 
@@ -517,7 +965,10 @@ namespace limbo {
             KernelFunction _kernel_function;
             MeanFunction _mean_function;
 
-            std::vector<Eigen::VectorXd> _samples;
+            /// samples stored column-wise (DxC); only the first _nb_samples columns are used
+            /// (the capacity C grows geometrically in add_sample)
+            Eigen::MatrixXd _samples;
+            int _nb_samples;
             Eigen::MatrixXd _observations;
             Eigen::MatrixXd _mean_vector;
             Eigen::MatrixXd _obs_mean;
@@ -525,110 +976,971 @@ namespace limbo {
             Eigen::MatrixXd _alpha;
             Eigen::VectorXd _mean_observation;
 
-            Eigen::MatrixXd _kernel, _inv_kernel;
+            matrix_t _kernel;
+            Eigen::MatrixXd _inv_kernel;
+
+            matrix_t _matrixL;
+            // lower triangular factor stored by panels of rows (only with a compact factorization)
+            // panel p holds the rows [p * b, (p + 1) * b) and the columns [0, (p + 1) * b)
+            std::vector<matrix_t> _panels;
+
+            // L^{-1} * observations and L^{-1} * ones, only kept up to date for constant mean functions
+            // (see mean::is_constant): alpha can then be updated without a full forward substitution
+            Eigen::MatrixXd _l_inv_obs;
+            Eigen::VectorXd _l_inv_ones;
 
-            Eigen::MatrixXd _matrixL;
+            // iterative solver only: preconditioner of the conjugate gradients and
+            // Lanczos factor R of the predictive variance (K^{-1} ~ R * R^T)
+            Preconditioner _preconditioner;
+            Eigen::MatrixXd _var_factor;
 
             double _log_lik, _log_loo_cv;
             bool _inv_kernel_updated;
 
+            int _max_window;
+
+            // squared distances between the samples, used by the likelihood evaluations of the hyper-parameter
+            // optimizers (reset when the samples change and by recompute(), viewed through _cache())
+            mutable kernel::DistanceCache _distance_cache;
+
             HyperParamsOptimizer _hp_optimize;
 
+            /// iterative solver: preconditioner, alpha (warm-started) and variance factor
+            void _compute_iterative()
+            {
+                _compute_preconditioner(_kernel_function, _preconditioner);
+                this->_compute_alpha();
+                _compute_variance_factor();
+                _inv_kernel_updated = false;
+            }
+
+            /// greedy pivoted Cholesky decomposition of the kernel matrix of `kernel_function` (without noise),
+            /// of rank Factorization::preconditioner_rank() at most, in O(n * r^2) (only r columns of K are computed)
+            void _compute_preconditioner(const KernelFunction& kernel_function, Preconditioner& p) const
+            {
+                int n = _nb_samples, r = std::min(Factorization::preconditioner_rank(), n);
+                p.noise = kernel_function.noise() + 1e-8;
+                p.factor.resize(n, r);
+
+                // diagonal of the residual K - F * F^T
+                Eigen::VectorXd d = kernel_function.kernel_diag(samples_matrix());
+                int j = 0;
+                for (; j < r; ++j) {
+                    int i;
+                    double d_max = d.maxCoeff(&i);
+                    if (d_max <= 1e-8 * p.noise) // the rest is negligible compared to the noise
+                        break;
+                    p.factor.col(j) = kernel_function.kernel_matrix(samples_matrix(), _samples.col(i));
+                    p.factor.col(j).noalias() -= p.factor.leftCols(j) * p.factor.row(i).head(j).transpose();
+                    p.factor.col(j) /= std::sqrt(d_max);
+                    d -= p.factor.col(j).cwiseAbs2();
+                    d(i) = 0;
+                }
+                p.factor.conservativeResize(n, j);
+
+                Eigen::MatrixXd M = p.factor.transpose() * p.factor;
+                M.diagonal().array() += p.noise;
+                p.llt.compute(M);
+            }
+
+            /// preconditioned conjugate gradients for K * X = B (X is the initial guess)
+            int _conjugate_gradient(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) const
+            {
+                auto op = [this](const Eigen::MatrixXd& V, Eigen::MatrixXd& KV) { KV = _kernel_product(V); };
+                return tools::preconditioned_conjugate_gradient(op, _preconditioner, B, X, Factorization::cg_tolerance(), Factorization::cg_max_iterations());
+            }
+
+            /// LOVE (Pleiss et al., 2018): with the Lanczos decomposition K * Q ~ Q * T (started from K * 1),
+            /// K^{-1} ~ Q * T^{-1} * Q^T = R * R^T with R = Q * L_T^{-T}
+            void _compute_variance_factor()
+            {
+                auto op = [this](const Eigen::MatrixXd& V, Eigen::MatrixXd& KV) { KV = _kernel_product(V); };
+                Eigen::MatrixXd Q;
+                Eigen::VectorXd diag, sub_diag;
+                tools::lanczos(op, _kernel_product(Eigen::MatrixXd::Ones(_nb_samples, 1)).col(0), Factorization::lanczos_iterations(), Q, diag, sub_diag);
+
+                Eigen::MatrixXd T = diag.asDiagonal();
+                T.diagonal(-1) = sub_diag;
+                T.diagonal(1) = sub_diag;
+                Eigen::MatrixXd Rt = Q.transpose();
+                Eigen::LLT<Eigen::MatrixXd>(T).matrixL().solveInPlace(Rt);
+                _var_factor = Rt.transpose();
+            }
+
+            /// stochastic estimate of the log likelihood (BBMM, Gardner et al., 2018): alpha and the solves of the
+            /// probes z ~ N(0, P) are computed by the same conjugate gradients, whose coefficients give
+            /// log |K| = log |P| + tr(log(P^{-1} * K)) ~ log |P| + mean(z^T * P^{-1} * z * e1^T * log(T_z) * e1)
+            double _compute_log_lik_iterative(const KernelFunction& kernel_function, const Eigen::MatrixXd& obs_mean, LikelihoodWorkspace& ws) const
+            {
+                int n = _nb_samples, d = obs_mean.cols(), p = Factorization::nb_probes();
+                _compute_preconditioner(kernel_function, ws.preconditioner);
+
+                // fixed seed: the likelihood is a deterministic function of the hyper-parameters
+                tools::rgen_gauss_t rgen(0., 1., 0);
+                Eigen::MatrixXd B(n, d + p);
+                B.leftCols(d) = obs_mean;
+                B.rightCols(p) = std::sqrt(ws.preconditioner.noise) * _gaussian_matrix(n, p, rgen);
+                B.rightCols(p).noalias() += ws.preconditioner.factor * _gaussian_matrix(ws.preconditioner.factor.cols(), p, rgen);
+
+                auto op = [&](const Eigen::MatrixXd& V, Eigen::MatrixXd& KV) { KV = _kernel_product(kernel_function, V); };
+                Eigen::MatrixXd X;
+                std::vector<tools::CGCoefficients> coefficients;
+                tools::preconditioned_conjugate_gradient(op, ws.preconditioner, B, X, Factorization::cg_tolerance(), Factorization::cg_max_iterations(), &coefficients);
+                ws.alpha = X.leftCols(d);
+                ws.probe_solves = X.rightCols(p);
+                ws.preconditioner(B.rightCols(p), ws.preconditioned_probes);
+
+                long double logdet = ws.preconditioner.log_det();
+                Eigen::VectorXd diag, sub_diag;
+                Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eigen;
+                for (int l = 0; l < p; l++) {
+                    coefficients[d + l].tridiagonal(diag, sub_diag);
+                    if (diag.size() == 0)
+                        continue;
+                    eigen.computeFromTridiagonal(diag, sub_diag);
+                    double quadrature = (eigen.eigenvectors().row(0).transpose().array().square() * eigen.eigenvalues().array().max(std::numeric_limits<double>::min()).log()).sum();
+                    logdet += B.col(d + l).dot(ws.preconditioned_probes.col(l)) * quadrature / p;
+                }
+                double a = (obs_mean.array() * ws.alpha.array()).sum(); // trace(obs_mean^T * alpha)
+
+                return -0.5 * a - 0.5 * logdet - 0.5 * n * std::log(2 * M_PI);
+            }
+
+            /// sum over (i, j) of (A * B^T)(i, j) * dK(i, j)/dtheta for every hyper-parameter theta, without
+            /// building A * B^T or dK: one pass over the lower triangle (dK is symmetrical), in parallel over blocks of rows
+            Eigen::VectorXd _low_rank_grad_trace(const KernelFunction& kernel_function, const Eigen::MatrixXd& A, const Eigen::MatrixXd& B) const
+            {
+                int n = _nb_samples, block_size = 32;
+                int nb_blocks = (n + block_size - 1) / block_size;
+
+                // each block accumulates in its own column
+                Eigen::MatrixXd g = Eigen::MatrixXd::Zero(kernel_function.h_params_size(), nb_blocks);
+                tools::par::loop(0, nb_blocks, [&](size_t b) {
+                    Eigen::VectorXd w(n);
+                    // (the gradient of each pair is written in the same buffer)
+                    Eigen::VectorXd grad(kernel_function.h_params_size());
+                    int end = std::min(n, int(b + 1) * block_size);
+                    for (int i = b * block_size; i < end; ++i) {
+                        // W(i, j) + W(j, i), for j <= i
+                        w.head(i + 1).noalias() = B.topRows(i + 1) * A.row(i).transpose();
+                        w.head(i + 1).noalias() += A.topRows(i + 1) * B.row(i).transpose();
+                        for (int j = 0; j < i; ++j) {
+                            kernel_function.grad_in_place(_samples.col(i), _samples.col(j), i, j, grad);
+                            g.col(b) += w(j) * grad;
+                        }
+                        kernel_function.grad_in_place(_samples.col(i), _samples.col(i), i, i, grad);
+                        g.col(b) += 0.5 * w(i) * grad;
+                    }
+                });
+
+                return g.rowwise().sum();
+            }
+
+            /// gradient of the log likelihood with a compact factorization: 1/2 * sum_ij W(i, j) * dK(i, j)/dtheta
+            /// with W = alpha * alpha^T - K^{-1}, by blocks of columns of K^{-1} (`solve(E, start)` turns the
+            /// columns [start, start + E.cols()) of the identity into those of K^{-1}) and the gradient of each pair:
+            /// neither K^{-1} nor the distance cache are built, O(n * panel_size()) memory per block
+            template <typename Solve>
+            Eigen::VectorXd _compact_grad_log_lik(const KernelFunction& kernel_function, const Eigen::MatrixXd& alpha, Solve solve) const
+            {
+                int n = _nb_samples, b = Factorization::panel_size();
+                int nb_blocks = (n + b - 1) / b;
+
+                // each block accumulates in its own column
+                Eigen::MatrixXd g = Eigen::MatrixXd::Zero(kernel_function.h_params_size(), nb_blocks);
+                tools::par::loop(0, nb_blocks, [&](size_t p) {
+                    int start = p * b;
+                    int cols = std::min(b, n - start);
+                    Eigen::MatrixXd W = Eigen::MatrixXd::Zero(n, cols);
+                    W.middleRows(start, cols).setIdentity();
+                    solve(W, start);
+                    W = alpha * alpha.middleRows(start, cols).transpose() - W;
+
+                    // W is symmetric: the pairs (i, j) with i > j count twice
+                    // (the gradient of each pair is written in the same buffer)
+                    Eigen::VectorXd grad(kernel_function.h_params_size());
+                    for (int c = 0; c < cols; ++c) {
+                        int j = start + c;
+                        for (int i = j + 1; i < n; ++i) {
+                            kernel_function.grad_in_place(_samples.col(i), _samples.col(j), i, j, grad);
+                            g.col(p) += W(i, c) * grad;
+                        }
+                        kernel_function.grad_in_place(_samples.col(j), _samples.col(j), j, j, grad);
+                        g.col(p) += 0.5 * W(j, c) * grad;
+                    }
+                });
+
+                return g.rowwise().sum();
+            }
+
+            /// K^{-1} * B in place (triangular solves, or conjugate gradients with an iterative solver)
+            void _solve(Eigen::Ref<Eigen::MatrixXd> B) const
+            {
+                if (Factorization::iterative()) {
+                    Eigen::MatrixXd X;
+                    _conjugate_gradient(B, X);
+                    B = X;
+                    return;
+                }
+                _solve_lower(B);
+                _solve_upper(B);
+            }
+
+            /// Z with Z^T * Z = K^T * K^{-1} * K: L^{-1} * K, or R^T * K with an iterative solver (K^{-1} ~ R * R^T)
+            Eigen::MatrixXd _whiten(const Eigen::MatrixXd& K) const
+            {
+                if (Factorization::iterative())
+                    return _var_factor.transpose() * K;
+                Eigen::MatrixXd Z = K;
+                _solve_lower(Z);
+                return Z;
+            }
+
+            void _remove_from_matrixL(int i, int n)
+            {
+                int m = n - i - 1;
+                Eigen::Matrix<scalar_t, Eigen::Dynamic, 1> x = _matrixL.block(i + 1, i, m, 1);
+                for (int k = 0; k < m; ++k) {
+                    int l = i + 1 + k;
+                    scalar_t r = std::sqrt(_matrixL(l, l) * _matrixL(l, l) + x(k) * x(k));
+                    scalar_t c = r / _matrixL(l, l);
+                    scalar_t s = x(k) / _matrixL(l, l);
+                    _matrixL(l, l) = r;
+                    int t = m - k - 1;
+                    _matrixL.block(l + 1, l, t, 1) = (_matrixL.block(l + 1, l, t, 1) + s * x.tail(t)) / c;
+                    x.tail(t) = c * x.tail(t) - s * _matrixL.block(l + 1, l, t, 1);
+                }
+                _remove_row(_matrixL, i);
+                _remove_col(_matrixL, i);
+            }
+
+            /// same as _remove_from_matrixL, with the factor stored by panels of rows
+            void _remove_from_panels(int i, int n)
+            {
+                int m = n - i - 1;
+                Eigen::Matrix<scalar_t, Eigen::Dynamic, 1> x(m);
+                for (int k = 0; k < m; ++k)
+                    x(k) = _factor(i + 1 + k, i);
+                for (int k = 0; k < m; ++k) {
+                    int l = i + 1 + k;
+                    scalar_t L_ll = _factor(l, l);
+                    scalar_t r = std::sqrt(L_ll * L_ll + x(k) * x(k));
+                    scalar_t c = r / L_ll;
+                    scalar_t s = x(k) / L_ll;
+                    _factor(l, l) = r;
+                    for (int j = k + 1; j < m; ++j) {
+                        scalar_t& L_jl = _factor(i + 1 + j, l);
+                        L_jl = (L_jl + s * x(j)) / c;
+                        x(j) = c * x(j) - s * L_jl;
+                    }
+                }
+
+                // shift the rows below i by one row up, without the i-th column
+                for (int r = i; r < n - 1; ++r) {
+                    for (int c = 0; c < i; ++c)
+                        _factor(r, c) = _factor(r + 1, c);
+                    for (int c = i; c <= r; ++c)
+                        _factor(r, c) = _factor(r + 1, c + 1);
+                }
+                if ((n - 1) % Factorization::panel_size() == 0)
+                    _panels.pop_back();
+            }
+
+            /// element (r, c) of the factor stored by panels (only the lower triangle is valid)
+            scalar_t& _factor(int r, int c)
+            {
+                return _panels[r / Factorization::panel_size()](r % Factorization::panel_size(), c);
+            }
+
+            scalar_t _factor(int r, int c) const
+            {
+                return _panels[r / Factorization::panel_size()](r % Factorization::panel_size(), c);
+            }
+
+            template <typename M>
+            static void _remove_row(M& m, int i)
+            {
+                int rows = m.rows() - i - 1;
+                m.middleRows(i, rows) = m.middleRows(i + 1, rows).eval();
+                m.conservativeResize(m.rows() - 1, m.cols());
+            }
+
+            template <typename M>
+            static void _remove_col(M& m, int i)
+            {
+                int cols = m.cols() - i - 1;
+                m.middleCols(i, cols) = m.middleCols(i + 1, cols).eval();
+                m.conservativeResize(m.rows(), m.cols() - 1);
+            }
+
             void _compute_obs_mean()
             {
-                assert(!_samples.empty());
-                _mean_vector.resize(_samples.size(), _dim_out);
-                for (int i = 0; i < _mean_vector.rows(); i++) {
-                    assert(_samples[i].cols() == 1);
-                    assert(_samples[i].rows() != 0);
-                    assert(_samples[i].rows() == _dim_in);
-                    _mean_vector.row(i) = _mean_function(_samples[i], *this);
+                assert(_nb_samples > 0);
+                assert(_samples.rows() == _dim_in);
+                if (mean::is_constant<MeanFunction>::value)
+                    _mean_vector = _mean_function(_samples.col(0), *this).transpose().replicate(_nb_samples, 1);
+                else {
+                    _mean_vector.resize(_nb_samples, _dim_out);
+                    for (int i = 0; i < _mean_vector.rows(); i++)
+                        _mean_vector.row(i) = _mean_function(_samples.col(i), *this);
                 }
                 _obs_mean = _observations - _mean_vector;
             }
 
             void _compute_full_kernel()
             {
-                size_t n = _samples.size();
-                _kernel.resize(n, n);
+                size_t n = _nb_samples;
 
-                // O(n^2) [should be negligible]
-                for (size_t i = 0; i < n; i++)
-                    for (size_t j = 0; j <= i; ++j)
-                        _kernel(i, j) = _kernel_function(_samples[i], _samples[j], i, j);
+                if (Factorization::iterative()) {
+                    this->_compute_iterative();
+                    return;
+                }
+
+                if (Factorization::compact()) {
+                    // the factor is built panel by panel, like add_samples() (the kernel matrix is never stored)
+                    _panels.clear();
+                    for (int start = 0; start < _nb_samples; start += Factorization::panel_size()) {
+                        int k = std::min(Factorization::panel_size(), _nb_samples - start);
+                        this->_extend_factor(_kernel_columns(start + k, start, k));
+                    }
 
+                    this->_compute_forward_solve(n);
+                    this->_compute_alpha();
+                    _inv_kernel_updated = false;
+                    return;
+                }
+
+                // O(n^2) [should be negligible]
+                Eigen::MatrixXd K = _kernel_function.kernel_matrix(samples_matrix(), samples_matrix());
+                // the diagonal is computed point-wise to add the noise
                 for (size_t i = 0; i < n; i++)
-                    for (size_t j = 0; j < i; ++j)
-                        _kernel(j, i) = _kernel(i, j);
+                    K(i, i) = _kernel_function(_samples.col(i), _samples.col(i), i, i);
+                _kernel = K.template cast<scalar_t>();
 
-                // O(n^3)
-                _matrixL = Eigen::LLT<Eigen::MatrixXd>(_kernel).matrixL();
+                // O(n^3), always in double precision (in place)
+                bool success;
+                if (Factorization::tile_size() > 0)
+                    success = tools::tiled_llt(K, Factorization::tile_size());
+                else
+                    success = Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>>(K).info() == Eigen::Success;
+                if (!success)
+                    std::cerr << "[GP]: the kernel matrix is not positive definite (Cholesky decomposition failed)" << std::endl;
+                K.template triangularView<Eigen::StrictlyUpper>().setZero();
+                _matrixL = K.template cast<scalar_t>();
 
+                this->_compute_forward_solve(n);
                 this->_compute_alpha();
 
                 // notify change of kernel
                 _inv_kernel_updated = false;
             }
 
-            void _compute_incremental_kernel()
+            double _compute_log_lik(const KernelFunction& kernel_function, const Eigen::MatrixXd& obs_mean, LikelihoodWorkspace& ws) const
             {
-                // Incremental LLT
-                // This part of the code is inspired from the Bayesopt Library (cholesky_add_row function).
-                // However, the mathematical foundations can be easily retrieved by detailing the equations of the
-                // extended L matrix that produces the desired kernel.
+                if (Factorization::iterative())
+                    return _compute_log_lik_iterative(kernel_function, obs_mean, ws);
+
+                size_t n = _nb_samples;
+
+                if (Factorization::compact()) {
+                    // the factor is built panel by panel in the workspace, like _compute_full_kernel()
+                    int b = Factorization::panel_size();
+                    ws.panels.clear();
+                    for (int start = 0; start < _nb_samples; start += b) {
+                        int k = std::min(b, _nb_samples - start);
+                        _extend_panels(ws.panels, _kernel_columns(kernel_function, start + k, start, k));
+                    }
+                    ws.alpha = obs_mean;
+                    _lower_solve_panels(ws.panels, ws.alpha, 0);
+                    _upper_solve_panels(ws.panels, ws.alpha);
 
-                size_t n = _samples.size();
-                _kernel.conservativeResize(n, n);
+                    long double logdet = 0;
+                    for (int i = 0; i < _nb_samples; ++i)
+                        logdet += 2 * std::log(ws.panels[i / b](i % b, i));
+                    double a = (obs_mean.array() * ws.alpha.array()).sum();
 
-                for (size_t i = 0; i < n; ++i) {
-                    _kernel(i, n - 1) = _kernel_function(_samples[i], _samples[n - 1], i, n - 1);
-                    _kernel(n - 1, i) = _kernel(i, n - 1);
+                    return -0.5 * a - 0.5 * logdet - 0.5 * n * std::log(2 * M_PI);
                 }
 
-                _matrixL.conservativeResizeLike(Eigen::MatrixXd::Zero(n, n));
+                kernel_function.cached_kernel_matrix(_cache(), ws.kernel);
+                for (size_t i = 0; i < n; i++)
+                    ws.kernel(i, i) = kernel_function(_samples.col(i), _samples.col(i), i, i);
 
-                double L_j;
-                for (size_t j = 0; j < n - 1; ++j) {
-                    L_j = _kernel(n - 1, j) - (_matrixL.block(j, 0, 1, j) * _matrixL.block(n - 1, 0, 1, j).transpose())(0, 0);
-                    _matrixL(n - 1, j) = (L_j) / _matrixL(j, j);
+                // the factorization and the solve reuse the memory of the workspace
+                ws.llt.compute(ws.kernel);
+                ws.alpha = obs_mean;
+                ws.llt.solveInPlace(ws.alpha);
+
+                long double logdet = 2 * ws.llt.matrixLLT().diagonal().array().log().sum();
+                double a = (obs_mean.array() * ws.alpha.array()).sum(); // trace(obs_mean^T * alpha)
+
+                return -0.5 * a - 0.5 * logdet - 0.5 * n * std::log(2 * M_PI);
+            }
+
+            // the distance cache, as a view of the current samples (it does not copy them)
+            const kernel::DistanceCache& _cache() const
+            {
+                _distance_cache.bind(samples_matrix());
+                return _distance_cache;
+            }
+
+            Eigen::VectorXd _kernel_grad_log_lik(const KernelFunction& kernel_function, const Eigen::MatrixXd& w, const kernel::DistanceCache& cache) const
+            {
+                // 1/2 * sum_ij w(i, j) * dK(i, j)/dtheta
+                return 0.5 * kernel_function.cached_grad_trace(cache, w);
+            }
+
+            void _compute_incremental_kernel(int k = 1)
+            {
+                // Incremental LLT, by blocks: with K = [K11 K12; K21 K22] and K11 = L11 * L11^T,
+                // L = [L11 0; L21 L22] with L21^T = L11^{-1} * K12 (one triangular solve)
+                // and L22 * L22^T = K22 - L21 * L21^T (Cholesky of the kxk Schur complement)
+                if (Factorization::iterative()) {
+                    // the previous alpha (completed with zeros) is the initial guess
+                    this->_compute_iterative();
+                    return;
                 }
 
-                L_j = _kernel(n - 1, n - 1) - (_matrixL.block(n - 1, 0, 1, n - 1) * _matrixL.block(n - 1, 0, 1, n - 1).transpose())(0, 0);
-                _matrixL(n - 1, n - 1) = sqrt(L_j);
+                int n = _nb_samples - k;
+                int n_new = _nb_samples;
+
+                Eigen::MatrixXd K = _kernel_columns(n_new, n, k);
 
+                if (!Factorization::compact()) {
+                    _kernel.conservativeResize(n_new, n_new);
+                    _kernel.rightCols(k) = K.template cast<scalar_t>();
+                    _kernel.bottomLeftCorner(k, n) = _kernel.topRightCorner(n, k).transpose();
+                }
+
+                this->_extend_factor(K);
+
+                this->_compute_forward_solve(k);
                 this->_compute_alpha();
 
                 // notify change of kernel
                 _inv_kernel_updated = false;
             }
 
+            /// add k rows to the factor, given the last k columns K ((n+k)xk) of the kernel matrix
+            void _extend_factor(const Eigen::MatrixXd& K)
+            {
+                if (Factorization::compact()) {
+                    _extend_panels(_panels, K);
+                    return;
+                }
+
+                int k = K.cols();
+                int n = K.rows() - k;
+
+                Eigen::MatrixXd L21t = K.topRows(n);
+                _solve_lower(L21t);
+
+                // the Schur complement is computed and factorized in double precision
+                Eigen::MatrixXd schur = K.bottomRows(k);
+                schur.noalias() -= L21t.transpose() * L21t;
+                Eigen::MatrixXd L22 = Eigen::LLT<Eigen::MatrixXd>(schur).matrixL();
+
+                _matrixL.conservativeResizeLike(matrix_t::Zero(n + k, n + k));
+                _matrixL.bottomLeftCorner(k, n) = L21t.transpose().template cast<scalar_t>();
+                _matrixL.bottomRightCorner(k, k) = L22.template cast<scalar_t>();
+            }
+
+            /// same as _extend_factor(), for a factor stored in `panels` (the solve runs in the precision of the panels)
+            template <typename P>
+            static void _extend_panels(std::vector<P>& panels, const Eigen::MatrixXd& K)
+            {
+                int k = K.cols();
+                int n = K.rows() - k;
+                int b = Factorization::panel_size();
+
+                P L21t = K.topRows(n).template cast<typename P::Scalar>();
+                _lower_solve_panels(panels, L21t, 0);
+
+                Eigen::MatrixXd schur = K.bottomRows(k);
+                schur.noalias() -= L21t.transpose().template cast<double>() * L21t.template cast<double>();
+                Eigen::MatrixXd L22 = Eigen::LLT<Eigen::MatrixXd>(schur).matrixL();
+
+                for (int j = 0; j < k; ++j) {
+                    int r = n + j;
+                    if (r % b == 0)
+                        panels.push_back(P::Zero(b, r + b));
+                    P& panel = panels[r / b];
+                    panel.row(r % b).head(n) = L21t.col(j).transpose();
+                    panel.row(r % b).segment(n, j + 1) = L22.row(j).head(j + 1).template cast<typename P::Scalar>();
+                }
+            }
+
+            /// kernel (with the noise) between the first `rows` samples and the samples [start, start + k)
+            Eigen::MatrixXd _kernel_columns(int rows, int start, int k) const
+            {
+                return _kernel_columns(_kernel_function, rows, start, k);
+            }
+
+            Eigen::MatrixXd _kernel_columns(const KernelFunction& kernel_function, int rows, int start, int k) const
+            {
+                Eigen::MatrixXd K = kernel_function.kernel_matrix(_samples.leftCols(rows), _samples.middleCols(start, k));
+                for (int i = start; i < std::min(start + k, rows); ++i)
+                    K(i, i - start) = kernel_function(_samples.col(i), _samples.col(i), i, i);
+                return K;
+            }
+
+            /// K^{-1}: cached in _inv_kernel, or computed in `tmp` with a compact factorization or an iterative solver (the inverse is not kept)
+            const Eigen::MatrixXd& _get_inv_kernel(Eigen::MatrixXd& tmp)
+            {
+                if (Factorization::compact() || Factorization::iterative()) {
+                    tmp.setIdentity(_nb_samples, _nb_samples);
+                    _solve(tmp);
+                    return tmp;
+                }
+
+                if (!_inv_kernel_updated)
+                    compute_inv_kernel();
+                return _inv_kernel;
+            }
+
+            /// diagonal of K^{-1}, i.e. the squared norms of the columns of L^{-1}
+            /// (computed by blocks of columns with a compact factorization or an iterative solver)
+            Eigen::VectorXd _inv_kernel_diagonal()
+            {
+                if (Factorization::iterative()) {
+                    int n = _nb_samples, b = Factorization::panel_size();
+                    Eigen::VectorXd d(n);
+                    for (int j = 0; j < n; j += b) {
+                        int cols = std::min(b, n - j);
+                        Eigen::MatrixXd E = Eigen::MatrixXd::Zero(n, cols);
+                        E.middleRows(j, cols).setIdentity();
+                        _solve(E);
+                        d.segment(j, cols) = E.middleRows(j, cols).diagonal();
+                    }
+                    return d;
+                }
+
+                if (!Factorization::compact()) {
+                    if (!_inv_kernel_updated)
+                        compute_inv_kernel();
+                    return _inv_kernel.diagonal();
+                }
+
+                int n = _nb_samples, b = Factorization::panel_size();
+                Eigen::VectorXd d(n);
+                for (int j = 0; j < n; j += b) {
+                    int cols = std::min(b, n - j);
+                    // L^{-1} * e_j is zero above j
+                    Eigen::MatrixXd E = Eigen::MatrixXd::Identity(n - j, cols);
+                    _solve_lower(E, j);
+                    d.segment(j, cols) = E.colwise().squaredNorm().transpose();
+                }
+                return d;
+            }
+
+            /// lower triangle of the factor, row by row (compact factorization)
+            Eigen::MatrixXd _packed_factor() const
+            {
+                Eigen::MatrixXd packed(_nb_samples * (_nb_samples + 1) / 2, 1);
+                for (int r = 0, i = 0; r < _nb_samples; ++r)
+                    for (int c = 0; c <= r; ++c)
+                        packed(i++, 0) = _factor(r, c);
+                return packed;
+            }
+
+            void _unpack_factor(const Eigen::MatrixXd& packed)
+            {
+                int b = Factorization::panel_size();
+                _panels.clear();
+                for (int r = 0, i = 0; r < _nb_samples; ++r) {
+                    if (r % b == 0)
+                        _panels.push_back(matrix_t::Zero(b, r + b));
+                    for (int c = 0; c <= r; ++c)
+                        _factor(r, c) = packed(i++, 0);
+                }
+            }
+
+            /// diagonal of the factor
+            Eigen::VectorXd _factor_diagonal() const
+            {
+                if (!Factorization::compact())
+                    return _matrixL.diagonal().template cast<double>();
+
+                Eigen::VectorXd d(_nb_samples);
+                for (int i = 0; i < _nb_samples; ++i)
+                    d(i) = _factor(i, i);
+                return d;
+            }
+
+            void _update_mean_observation(int k)
+            {
+                // running mean over the k new observations (the last k rows)
+                int n = _observations.rows();
+                if (n == k)
+                    _mean_observation = _observations.colwise().mean();
+                else
+                    _mean_observation = (_mean_observation * (n - k) + _observations.bottomRows(k).colwise().sum().transpose()) / n;
+            }
+
+            /// extend L^{-1} * observations and L^{-1} * ones to the last k rows of _matrixL (k = n: from scratch)
+            void _compute_forward_solve(int k)
+            {
+                if (!mean::is_constant<MeanFunction>::value || Factorization::iterative())
+                    return;
+
+                // with L = [L11 0; L21 L22], L^{-1} * [b1; b2] = [z1; L22^{-1} * (b2 - L21 * z1)], O(n * k)
+                int n = _nb_samples - k;
+                _l_inv_obs.conservativeResize(_nb_samples, _dim_out);
+                _l_inv_ones.conservativeResize(_nb_samples);
+                _l_inv_obs.bottomRows(k) = _observations.bottomRows(k);
+                _l_inv_ones.tail(k).setOnes();
+                if (n > 0 && Factorization::compact()) {
+                    for (int j = 0; j < k; ++j) {
+                        int r = n + j;
+                        auto row = _panels[r / Factorization::panel_size()].row(r % Factorization::panel_size()).head(n).template cast<double>();
+                        _l_inv_obs.row(r).noalias() -= row * _l_inv_obs.topRows(n);
+                        _l_inv_ones(r) -= row.dot(_l_inv_ones.head(n));
+                    }
+                }
+                else if (n > 0) {
+                    _l_inv_obs.bottomRows(k).noalias() -= _matrixL.bottomLeftCorner(k, n).template cast<double>() * _l_inv_obs.topRows(n);
+                    _l_inv_ones.tail(k).noalias() -= _matrixL.bottomLeftCorner(k, n).template cast<double>() * _l_inv_ones.head(n);
+                }
+                _solve_lower(_l_inv_obs.bottomRows(k), n);
+                _solve_lower(_l_inv_ones.tail(k), n);
+            }
+
             void _compute_alpha()
             {
+                if (Factorization::iterative()) {
+                    // the previous alpha (completed with zeros) is the initial guess
+                    int previous = (_alpha.cols() == _dim_out) ? std::min(int(_alpha.rows()), _nb_samples) : 0;
+                    _alpha.conservativeResize(_nb_samples, _dim_out);
+                    _alpha.bottomRows(_nb_samples - previous).setZero();
+                    _conjugate_gradient(_obs_mean, _alpha);
+                    return;
+                }
+
                 // alpha = K^{-1} * this->_obs_mean;
-                Eigen::TriangularView<Eigen::MatrixXd, Eigen::Lower> triang = _matrixL.template triangularView<Eigen::Lower>();
-                _alpha = triang.solve(_obs_mean);
-                triang.adjoint().solveInPlace(_alpha);
+                if (mean::is_constant<MeanFunction>::value && _nb_samples > 0) {
+                    // obs_mean = observations - ones * m^T, so the forward substitution is not needed
+                    _alpha = _l_inv_obs - _l_inv_ones * _mean_vector.row(0);
+                }
+                else {
+                    _alpha = _obs_mean;
+                    _solve_lower(_alpha);
+                }
+                _solve_upper(_alpha);
+
+                // iterative refinement when the factor is not stored in double precision
+                for (int i = 0; i < Factorization::refinement_steps(); i++) {
+                    Eigen::MatrixXd r = _obs_mean - _kernel_product(_alpha);
+                    _solve_lower(r);
+                    _solve_upper(r);
+                    _alpha += r;
+                }
             }
 
-            Eigen::VectorXd _mu(const Eigen::VectorXd& v, const Eigen::VectorXd& k) const
+            /// K * A in double precision (by blocks of rows when K is not stored in double)
+            Eigen::MatrixXd _kernel_product(const Eigen::MatrixXd& A) const
             {
-                return (k.transpose() * _alpha) + _mean_function(v, *this).transpose();
+                if (Factorization::compact() || Factorization::iterative())
+                    return _kernel_product(_kernel_function, A);
+                return _kernel_product(A, std::is_same<scalar_t, double>());
             }
 
-            double _sigma(const Eigen::VectorXd& v, const Eigen::VectorXd& k) const
+            /// K * A, with the kernel matrix of `kernel_function` rebuilt by blocks of columns,
+            /// in parallel (O(n * panel_size()) memory per block)
+            Eigen::MatrixXd _kernel_product(const KernelFunction& kernel_function, const Eigen::MatrixXd& A) const
             {
-                Eigen::VectorXd z = _matrixL.triangularView<Eigen::Lower>().solve(k);
-                double res = _kernel_function(v, v) - z.dot(z);
+                int n = _nb_samples, b = Factorization::panel_size();
+                Eigen::MatrixXd res(n, A.cols());
+                tools::par::loop(0, (n + b - 1) / b, [&](size_t p) {
+                    int i = p * b;
+                    int cols = std::min(b, n - i);
+                    res.middleRows(i, cols).noalias() = _kernel_columns(kernel_function, n, i, cols).transpose() * A;
+                });
+                return res;
+            }
+
+            Eigen::MatrixXd _kernel_product(const Eigen::MatrixXd& A, std::true_type) const
+            {
+                return _kernel * A;
+            }
+
+            Eigen::MatrixXd _kernel_product(const Eigen::MatrixXd& A, std::false_type) const
+            {
+                int n = _kernel.rows(), b = 256;
+                Eigen::MatrixXd res(n, A.cols());
+                for (int i = 0; i < n; i += b) {
+                    int rows = std::min(b, n - i);
+                    res.middleRows(i, rows).noalias() = _kernel.middleRows(i, rows).template cast<double>() * A;
+                }
+                return res;
+            }
+
+            /// solve L * X = B in place, with the diagonal block of L that starts at `start`
+            /// (the solve runs in the precision of the factor)
+            void _solve_lower(Eigen::Ref<Eigen::MatrixXd> B, int start = 0) const
+            {
+                _solve_lower(B, start, std::is_same<scalar_t, double>());
+            }
+
+            void _solve_lower(Eigen::Ref<Eigen::MatrixXd> B, int start, std::true_type) const
+            {
+                _lower_solve_in_place(B, start);
+            }
+
+            void _solve_lower(Eigen::Ref<Eigen::MatrixXd> B, int start, std::false_type) const
+            {
+                matrix_t X = B.template cast<scalar_t>();
+                _lower_solve_in_place(X, start);
+                B = X.template cast<double>();
+            }
+
+            template <typename M>
+            void _lower_solve_in_place(M& B, int start) const
+            {
+                int r = B.rows();
+                if (!Factorization::compact()) {
+                    // a single vector (e.g. a query) is solved directly: the tiles only pay off with many right-hand sides
+                    if (Factorization::tile_size() > 0 && B.cols() > 1)
+                        tools::tiled_lower_solve(_matrixL.block(start, start, r, r), B, Factorization::tile_size());
+                    else
+                        _matrixL.block(start, start, r, r).template triangularView<Eigen::Lower>().solveInPlace(B);
+                    return;
+                }
+
+                _lower_solve_panels(_panels, B, start);
+            }
+
+            /// forward substitution by panels: B_p = L_pp^{-1} * (B_p - L_p,<p * B_<p), with the factor stored in `panels`
+            template <typename P, typename M>
+            static void _lower_solve_panels(const std::vector<P>& panels, M& B, int start)
+            {
+                int r = B.rows(), b = Factorization::panel_size();
+                for (int a = start; a < start + r;) {
+                    int p = a / b;
+                    int e = std::min((p + 1) * b, start + r);
+                    const P& panel = panels[p];
+                    if (a > start)
+                        B.middleRows(a - start, e - a).noalias() -= panel.block(a - p * b, start, e - a, a - start) * B.topRows(a - start);
+                    panel.block(a - p * b, a, e - a, e - a).template triangularView<Eigen::Lower>().solveInPlace(B.middleRows(a - start, e - a));
+                    a = e;
+                }
+            }
+
+            /// solve L^T * X = B in place
+            void _solve_upper(Eigen::Ref<Eigen::MatrixXd> B) const
+            {
+                _solve_upper(B, std::is_same<scalar_t, double>());
+            }
+
+            void _solve_upper(Eigen::Ref<Eigen::MatrixXd> B, std::true_type) const
+            {
+                _upper_solve_in_place(B);
+            }
+
+            void _solve_upper(Eigen::Ref<Eigen::MatrixXd> B, std::false_type) const
+            {
+                matrix_t X = B.template cast<scalar_t>();
+                _upper_solve_in_place(X);
+                B = X.template cast<double>();
+            }
+
+            template <typename M>
+            void _upper_solve_in_place(M& B) const
+            {
+                if (!Factorization::compact()) {
+                    if (Factorization::tile_size() > 0 && B.cols() > 1)
+                        tools::tiled_upper_solve(_matrixL, B, Factorization::tile_size());
+                    else
+                        _matrixL.template triangularView<Eigen::Lower>().adjoint().solveInPlace(B);
+                    return;
+                }
+
+                _upper_solve_panels(_panels, B);
+            }
+
+            /// backward substitution by panels, from the last one: B_p = L_pp^{-T} * B_p, then B_<p -= L_p,<p^T * B_p
+            template <typename P, typename M>
+            static void _upper_solve_panels(const std::vector<P>& panels, M& B)
+            {
+                int n = B.rows(), b = Factorization::panel_size();
+                for (int p = (n + b - 1) / b - 1; p >= 0; --p) {
+                    int a = p * b;
+                    int rows = std::min(b, n - a);
+                    const P& panel = panels[p];
+                    panel.block(0, a, rows, rows).template triangularView<Eigen::Lower>().adjoint().solveInPlace(B.middleRows(a, rows));
+                    if (a > 0)
+                        B.topRows(a).noalias() -= panel.block(0, 0, rows, a).adjoint() * B.middleRows(a, rows);
+                }
+            }
+
+            // buffers of the single-point queries: k (cross-kernel) and z = L^{-1} * k (in the precision of the factor);
+            // there is one set per thread, shared by all the GPs of this type, and it only grows
+            struct QueryScratch {
+                Eigen::VectorXd k;
+                Eigen::Matrix<scalar_t, Eigen::Dynamic, 1> z;
+            };
+
+            static QueryScratch& _query_scratch(int n)
+            {
+                static thread_local QueryScratch scratch;
+                if (scratch.k.size() < n) {
+                    scratch.k.resize(n);
+                    scratch.z.resize(n);
+                }
+                return scratch;
+            }
+
+            // mean at v; for constant mean functions, the value used to compute alpha is copied (no allocation)
+            void _mean(const Eigen::VectorXd& v, Eigen::Ref<Eigen::VectorXd> m) const
+            {
+                assert(m.size() == _dim_out);
+                if (mean::is_constant<MeanFunction>::value)
+                    m = _mean_vector.row(0).transpose();
+                else
+                    m = _mean_function(v, *this);
+            }
+
+            // Jacobian (rows x dim_in) of the mean function at v: zero for constant mean functions, central finite differences otherwise
+            Eigen::MatrixXd _mean_grad_input(const Eigen::VectorXd& v, int rows) const
+            {
+                Eigen::MatrixXd J = Eigen::MatrixXd::Zero(rows, v.size());
+                if (mean::is_constant<MeanFunction>::value)
+                    return J;
+
+                Eigen::VectorXd x = v;
+                for (int i = 0; i < v.size(); i++) {
+                    double h = 1e-6 * std::max(1., std::abs(v(i)));
+                    x(i) = v(i) + h;
+                    Eigen::VectorXd m_p = _mean_function(x, *this);
+                    x(i) = v(i) - h;
+                    Eigen::VectorXd m_m = _mean_function(x, *this);
+                    x(i) = v(i);
+                    J.col(i) = (m_p - m_m) / (2 * h);
+                }
+                return J;
+            }
+
+            template <typename K>
+            double _sigma(const Eigen::VectorXd& v, const K& k) const
+            {
+                double res;
+                if (Factorization::iterative()) {
+                    auto z = _query_scratch(_nb_samples).z.head(_var_factor.cols());
+                    z.noalias() = (_var_factor.transpose() * k).template cast<scalar_t>();
+                    res = _kernel_function(v, v) - z.template cast<double>().squaredNorm();
+                }
+                else {
+                    auto z = _query_scratch(_nb_samples).z.head(_nb_samples);
+                    z = k.template cast<scalar_t>();
+                    _lower_solve_in_place(z, 0);
+                    res = _kernel_function(v, v) - z.template cast<double>().squaredNorm();
+                }
 
                 return (res <= std::numeric_limits<double>::epsilon()) ? 0 : res;
             }
 
-            Eigen::VectorXd _compute_k(const Eigen::VectorXd& v) const
+            // cross-kernel between the samples and v, point by point so that nothing is allocated
+            template <typename K>
+            void _compute_k(const Eigen::VectorXd& v, K& k) const
+            {
+                for (int i = 0; i < _nb_samples; i++)
+                    k(i) = _kernel_function(_samples.col(i), v);
+            }
+
+            Eigen::MatrixXd _mu_batch(const Eigen::MatrixXd& X, const Eigen::MatrixXd& K) const
+            {
+                return K.transpose() * _alpha + _mean_batch(X);
+            }
+
+            Eigen::VectorXd _sigma_batch(const Eigen::MatrixXd& X, const Eigen::MatrixXd& K) const
+            {
+                // one multi-RHS solve for all the points
+                Eigen::MatrixXd Z = _whiten(K);
+                Eigen::VectorXd res = _kernel_diag_batch(X) - Z.colwise().squaredNorm().transpose();
+
+                return (res.array() <= std::numeric_limits<double>::epsilon()).select(0., res);
+            }
+
+            Eigen::MatrixXd _mean_batch(const Eigen::MatrixXd& X) const
+            {
+                Eigen::MatrixXd mu(X.rows(), _dim_out);
+                for (int i = 0; i < X.rows(); i++)
+                    mu.row(i) = _mean_function(X.row(i).transpose(), *this);
+                return mu;
+            }
+
+            Eigen::VectorXd _kernel_diag_batch(const Eigen::MatrixXd& X) const
+            {
+                return _kernel_function.kernel_diag(X.transpose());
+            }
+
+            // lower Cholesky factor of A, with an increasing jitter on the diagonal until it succeeds
+            // (if no jitter is enough, the factor is NaN, so that the draws are not silently wrong)
+            static Eigen::MatrixXd _jittered_cholesky(const Eigen::MatrixXd& A)
+            {
+                double scale = std::max(A.diagonal().mean(), std::numeric_limits<double>::min());
+                Eigen::LLT<Eigen::MatrixXd> llt;
+                for (double jitter = 0; jitter < scale; jitter = (jitter == 0) ? 1e-10 * scale : 10 * jitter) {
+                    Eigen::MatrixXd B = A;
+                    B.diagonal().array() += jitter;
+                    llt.compute(B);
+                    if (llt.info() == Eigen::Success)
+                        return llt.matrixL();
+                }
+                std::cerr << "[GP]: the covariance of the draws is not positive definite (Cholesky decomposition failed)" << std::endl;
+                return Eigen::MatrixXd::Constant(A.rows(), A.cols(), std::numeric_limits<double>::quiet_NaN());
+            }
+
+            template <typename Rng>
+            static Eigen::MatrixXd _gaussian_matrix(int rows, int cols, Rng& rng)
+            {
+                Eigen::MatrixXd G(rows, cols);
+                for (int j = 0; j < cols; j++)
+                    for (int i = 0; i < rows; i++)
+                        G(i, j) = rng.rand();
+                return G;
+            }
+
+            // centered posterior draws (one per column) at the rows of X: low-rank prior and pathwise update
+            template <typename Rng>
+            Eigen::MatrixXd _pathwise_draws(const Eigen::MatrixXd& X, int cols, Rng& rng) const
+            {
+                int m = X.rows(), n = _nb_samples, r = std::min(m, 256);
+
+                // landmarks: the samples (so that the prior is exact on them) and r evenly spaced rows of X
+                Eigen::MatrixXd U(X.cols(), n + r);
+                U.leftCols(n) = samples_matrix();
+                for (int i = 0; i < r; i++)
+                    U.col(n + i) = X.row(int((long(i) * m) / r)).transpose();
+                Eigen::MatrixXd Lu = _jittered_cholesky(_kernel_function.kernel_matrix(U, U));
+                Eigen::MatrixXd Kxu = _kernel_function.kernel_matrix(X.transpose(), U);
+
+                // prior: f(U) = Lu * W and f(X) = Kxu * Lu^{-T} * W, with W ~ N(0, I)
+                Eigen::MatrixXd W = _gaussian_matrix(n + r, cols, rng);
+                Eigen::MatrixXd V = W;
+                Lu.triangularView<Eigen::Lower>().adjoint().solveInPlace(V);
+                Eigen::MatrixXd F = Kxu * V;
+
+                // variance missed by the low-rank prior, and noise, added independently for each point
+                Eigen::MatrixXd B = Kxu.transpose();
+                Lu.triangularView<Eigen::Lower>().solveInPlace(B);
+                Eigen::VectorXd missing = (_kernel_diag_batch(X) - B.colwise().squaredNorm().transpose()).cwiseMax(0.).array() + _kernel_function.noise();
+                F += missing.cwiseSqrt().asDiagonal() * _gaussian_matrix(m, cols, rng);
+
+                if (n == 0)
+                    return F;
+
+                // Matheron's rule: f(X) - K(X, S) * K^{-1} * (f(S) + noise)
+                Eigen::MatrixXd R = Lu.topLeftCorner(n, n).triangularView<Eigen::Lower>() * W.topRows(n);
+                R += std::sqrt(_kernel_function.noise() + 1e-8) * _gaussian_matrix(n, cols, rng);
+                _solve(R);
+                F.noalias() -= Kxu.leftCols(n) * R;
+                return F;
+            }
+
+            /// cross-kernel (NxM) between the N samples and the M rows of X
+            Eigen::MatrixXd _compute_k_batch(const Eigen::MatrixXd& X) const
             {
-                Eigen::VectorXd k(_samples.size());
-                for (int i = 0; i < k.size(); i++)
-                    k[i] = _kernel_function(_samples[i], v);
-                return k;
+                return _kernel_function.kernel_matrix(samples_matrix(), X.transpose());
             }
         };
         /// GPBasic is a GP with a "mean data" mean function, Exponential kernel,
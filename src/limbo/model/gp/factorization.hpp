@@ -0,0 +1,148 @@
+//| Copyright Inria May 2015
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Jean-Baptiste Mouret (jean-baptiste.mouret@inria.fr)
+//|   - Antoine Cully (antoinecully@gmail.com)
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Federico Allocati (fede.allocati@gmail.com)
+//|   - Vaios Papaspyros (b.papaspyros@gmail.com)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is a computer library whose purpose is to optimize continuous,
+//| black-box functions. It mainly implements Gaussian processes and Bayesian
+//| optimization.
+//| Main repository: http://github.com/resibots/limbo
+//| Documentation: http://www.resibots.eu/limbo
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef LIMBO_MODEL_GP_FACTORIZATION_HPP
+#define LIMBO_MODEL_GP_FACTORIZATION_HPP
+
+namespace limbo {
+    namespace model {
+        namespace gp {
+            ///@ingroup model
+            ///everything is stored and computed in double precision (default)
+            struct DoublePrecision {
+                /// type used to store the kernel matrix and its Cholesky factor
+                using scalar_t = double;
+                /// number of steps of iterative refinement for alpha
+                static constexpr int refinement_steps() { return 0; }
+                /// true if only the Cholesky factor is stored (see Compact)
+                static constexpr bool compact() { return false; }
+                /// number of rows of the panels of a compact factor
+                static constexpr int panel_size() { return 128; }
+                /// size of the tiles of the parallel Cholesky decomposition (0: Eigen's LLT, see Tiled)
+                static constexpr int tile_size() { return 0; }
+                /// true if the kernel matrix is not factorized (see ConjugateGradient)
+                static constexpr bool iterative() { return false; }
+                /// parameters of the iterative solver (see ConjugateGradient)
+                static constexpr int preconditioner_rank() { return 0; }
+                static constexpr int nb_probes() { return 0; }
+                static constexpr int lanczos_iterations() { return 0; }
+                static constexpr double cg_tolerance() { return 1e-8; }
+                static constexpr int cg_max_iterations() { return 1000; }
+            };
+
+            ///@ingroup model
+            ///the kernel matrix and its Cholesky factor are stored in single precision,
+            ///which halves the memory of a GP and the bandwidth needed for the triangular solves
+            ///(predictions, alpha). The kernel values are computed in double, the Cholesky
+            ///factorization (and the log-determinant) are computed in double, then alpha is
+            ///corrected with a few steps of iterative refinement (residuals computed in double).
+            ///Use it for large GPs with a reasonable noise: the conditioning of the kernel matrix
+            ///must stay well below 1e7.
+            struct MixedPrecision {
+                using scalar_t = float;
+                static constexpr int refinement_steps() { return 2; }
+                static constexpr bool compact() { return false; }
+                static constexpr int panel_size() { return 128; }
+                static constexpr int tile_size() { return 0; }
+                static constexpr bool iterative() { return false; }
+                static constexpr int preconditioner_rank() { return 0; }
+                static constexpr int nb_probes() { return 0; }
+                static constexpr int lanczos_iterations() { return 0; }
+                static constexpr double cg_tolerance() { return 1e-8; }
+                static constexpr int cg_max_iterations() { return 1000; }
+            };
+
+            ///@ingroup model
+            ///only the lower triangle of the Cholesky factor is stored, by panels of PanelSize rows
+            ///(about n^2/2 numbers instead of three n x n matrices for the kernel, its factor and its inverse).
+            ///The factorization is done panel by panel from the kernel function, so the full kernel
+            ///matrix is never built, and the quantities that depend on K^{-1} are recomputed when needed.
+            ///The likelihood and its gradient (and so the hyper-parameter optimizers) work the same way,
+            ///by blocks of columns of K^{-1}; only the gradient of the LOO-CV still builds dense n x n matrices.
+            ///Base gives the precision (e.g. Compact<MixedPrecision>).
+            template <typename Base = DoublePrecision, int PanelSize = 128>
+            struct Compact : public Base {
+                static constexpr bool compact() { return true; }
+                static constexpr int panel_size() { return PanelSize; }
+            };
+
+            ///@ingroup model
+            ///the Cholesky decomposition and the triangular solves of the dense factor are done by tiles
+            ///of TileSize x TileSize, in parallel with tools::par (see tools::tiled_llt); this is useful
+            ///for large GPs when Eigen is not linked to a multi-threaded LAPACK/BLAS (e.g. MKL).
+            ///Base gives the precision (e.g. Tiled<MixedPrecision>); it has no effect on a Compact factor.
+            template <typename Base = DoublePrecision, int TileSize = 256>
+            struct Tiled : public Base {
+                static constexpr int tile_size() { return TileSize; }
+            };
+
+            ///@ingroup model
+            ///the kernel matrix is neither stored nor factorized (matrix-free solver, as in BBMM, Gardner et al., 2018):
+            ///its products are computed by blocks of BlockSize columns, rebuilt from the kernel function
+            ///(in parallel, with O(n * BlockSize) memory per thread), and
+            ///- alpha is computed with preconditioned conjugate gradients (the preconditioner is a
+            ///  pivoted Cholesky decomposition of rank PreconditionerRank, plus the noise), warm-started
+            ///  from the previous alpha when samples are added;
+            ///- the predictive variance uses a Lanczos decomposition of LanczosIterations steps
+            ///  (LOVE, Pleiss et al., 2018), which slightly over-estimates it when there are more samples;
+            ///- the log-determinant of the likelihood and its gradient are estimated with NbProbes
+            ///  Hutchinson probes (stochastic Lanczos quadrature, from the coefficients of the conjugate
+            ///  gradients), so that gp::KernelLFOpt does not need any n x n matrix. The probes are drawn
+            ///  with a fixed seed, so that the likelihood is a deterministic function of the hyper-parameters.
+            ///LOO-CV (and compute_inv_kernel()) still build dense n x n matrices.
+            template <int PreconditionerRank = 64, int NbProbes = 16, int LanczosIterations = 64, int BlockSize = 512>
+            struct ConjugateGradient : public DoublePrecision {
+                static constexpr bool iterative() { return true; }
+                /// number of columns of the blocks of the kernel matrix
+                static constexpr int panel_size() { return BlockSize; }
+                static constexpr int preconditioner_rank() { return PreconditionerRank; }
+                static constexpr int nb_probes() { return NbProbes; }
+                static constexpr int lanczos_iterations() { return LanczosIterations; }
+            };
+        } // namespace gp
+    } // namespace model
+} // namespace limbo
+
+#endif
@@ -46,6 +46,10 @@
 #ifndef LIMBO_MODEL_GP_HP_OPT_HPP
 #define LIMBO_MODEL_GP_HP_OPT_HPP
 
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include <Eigen/Core>
 
 #include <limbo/opt/rprop.hpp>
@@ -53,6 +57,38 @@
 namespace limbo {
     namespace model {
         namespace gp {
+            /// pool of the buffers used by the likelihood functors: the same functor can be
+            /// evaluated by several threads at the same time (e.g. with opt::ParallelRepeater),
+            /// so each running evaluation takes its own workspace and gives it back when it is done;
+            /// the workspaces (and their memory) are reused until the pool is destroyed
+            template <typename Workspace>
+            class WorkspacePool {
+            public:
+                WorkspacePool() {}
+                /// a copy starts with an empty pool (workspaces are never shared)
+                WorkspacePool(const WorkspacePool&) {}
+
+                std::unique_ptr<Workspace> acquire()
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    if (_workspaces.empty())
+                        return std::unique_ptr<Workspace>(new Workspace());
+                    std::unique_ptr<Workspace> ws = std::move(_workspaces.back());
+                    _workspaces.pop_back();
+                    return ws;
+                }
+
+                void release(std::unique_ptr<Workspace> ws)
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _workspaces.push_back(std::move(ws));
+                }
+
+            protected:
+                std::mutex _mutex;
+                std::vector<std::unique_ptr<Workspace>> _workspaces;
+            };
+
             ///@ingroup model_opt
             ///base class for optimization of the hyper-parameters of a GP
             template <typename Params, typename Optimizer = opt::Rprop<Params>>
@@ -76,23 +76,28 @@ namespace limbo {
 
                     opt::eval_t operator()(const Eigen::VectorXd& params, bool compute_grad) const
                     {
-                        GP gp(this->_original_gp);
-                        gp.kernel_function().set_h_params(params);
+                        // the GP is not copied: the likelihood is evaluated in a reusable workspace
+                        auto kernel_function = _original_gp.kernel_function();
+                        kernel_function.set_h_params(params);
 
-                        gp.recompute(false);
+                        std::unique_ptr<typename GP::LikelihoodWorkspace> ws = _workspaces.acquire();
 
-                        double lik = gp.compute_log_lik();
+                        double lik = _original_gp.compute_log_lik(kernel_function, *ws);
 
-                        if (!compute_grad)
+                        if (!compute_grad) {
+                            _workspaces.release(std::move(ws));
                             return opt::no_grad(lik);
+                        }
 
-                        Eigen::VectorXd grad = gp.compute_kernel_grad_log_lik();
+                        Eigen::VectorXd grad = _original_gp.compute_kernel_grad_log_lik(kernel_function, *ws);
+                        _workspaces.release(std::move(ws));
 
                         return {lik, grad};
                     }
 
                 protected:
                     const GP& _original_gp;
+                    mutable WorkspacePool<typename GP::LikelihoodWorkspace> _workspaces;
                 };
             };
         } // namespace gp
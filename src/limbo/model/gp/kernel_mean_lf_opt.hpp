@@ -85,27 +85,33 @@ namespace limbo {
 
                     opt::eval_t operator()(const Eigen::VectorXd& params, bool compute_grad) const
                     {
-                        GP gp(this->_original_gp);
-                        gp.kernel_function().set_h_params(params.head(gp.kernel_function().h_params_size()));
-                        gp.mean_function().set_h_params(params.tail(gp.mean_function().h_params_size()));
+                        // the GP is not copied: the likelihood is evaluated in a reusable workspace
+                        auto kernel_function = _original_gp.kernel_function();
+                        auto mean_function = _original_gp.mean_function();
+                        kernel_function.set_h_params(params.head(kernel_function.h_params_size()));
+                        mean_function.set_h_params(params.tail(mean_function.h_params_size()));
 
-                        gp.recompute(true);
+                        std::unique_ptr<typename GP::LikelihoodWorkspace> ws = _workspaces.acquire();
 
-                        double lik = gp.compute_log_lik();
+                        double lik = _original_gp.compute_log_lik(kernel_function, mean_function, *ws);
 
-                        if (!compute_grad)
+                        if (!compute_grad) {
+                            _workspaces.release(std::move(ws));
                             return opt::no_grad(lik);
+                        }
 
                         Eigen::VectorXd grad = Eigen::VectorXd::Zero(params.size());
 
-                        grad.head(gp.kernel_function().h_params_size()) = gp.compute_kernel_grad_log_lik();
-                        grad.tail(gp.mean_function().h_params_size()) = gp.compute_mean_grad_log_lik();
+                        grad.head(kernel_function.h_params_size()) = _original_gp.compute_kernel_grad_log_lik(kernel_function, *ws);
+                        grad.tail(mean_function.h_params_size()) = _original_gp.compute_mean_grad_log_lik(mean_function, *ws);
+                        _workspaces.release(std::move(ws));
 
                         return {lik, grad};
                     }
 
                 protected:
                     const GP& _original_gp;
+                    mutable WorkspacePool<typename GP::LikelihoodWorkspace> _workspaces;
                 };
             };
         } // namespace gp
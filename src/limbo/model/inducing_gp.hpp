@@ -0,0 +1,705 @@
+//| Copyright Inria May 2015
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Jean-Baptiste Mouret (jean-baptiste.mouret@inria.fr)
+//|   - Antoine Cully (antoinecully@gmail.com)
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Federico Allocati (fede.allocati@gmail.com)
+//|   - Vaios Papaspyros (b.papaspyros@gmail.com)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is a computer library whose purpose is to optimize continuous,
+//| black-box functions. It mainly implements Gaussian processes and Bayesian
+//| optimization.
+//| Main repository: http://github.com/resibots/limbo
+//| Documentation: http://www.resibots.eu/limbo
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+
+#ifndef LIMBO_MODEL_INDUCING_GP_HPP
+#define LIMBO_MODEL_INDUCING_GP_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+#include <Eigen/Cholesky>
+#include <Eigen/Core>
+
+#include <limbo/kernel/squared_exp_ard.hpp>
+#include <limbo/mean/data.hpp>
+#include <limbo/model/gp/no_lf_opt.hpp>
+#include <limbo/tools/macros.hpp>
+#include <limbo/tools/math.hpp>
+#include <limbo/tools/parallel.hpp>
+
+namespace limbo {
+    namespace defaults {
+        struct model_inducing_gp {
+            /// maximum number of inducing points (as long as there are fewer samples, all the samples are inducing points)
+            BO_PARAM(int, inducing_points, 100);
+            /// jitter added to the diagonal of the kernel matrix of the inducing points (relative to its mean diagonal)
+            BO_PARAM(double, jitter, 1e-6);
+        };
+    } // namespace defaults
+
+    namespace model {
+        namespace inducing_gp {
+            ///@ingroup model
+            /// Fully Independent Training Conditional (Snelson and Ghahramani, 2006):
+            /// the prior variance of each sample is kept exact (Lambda = diag(K - Q) + noise)
+            struct FITC {
+                static constexpr bool exact_variance() { return true; }
+            };
+
+            ///@ingroup model
+            /// Variational Free Energy (Titsias, 2009): Lambda = noise, and the likelihood
+            /// is a lower bound of the one of the exact GP (with the trace term -tr(K - Q) / (2 noise))
+            struct VFE {
+                static constexpr bool exact_variance() { return false; }
+            };
+        } // namespace inducing_gp
+
+        /**
+          @ingroup model
+          \rst
+          A sparse Gaussian process with m inducing points :math:`Z` (FITC or VFE, see ``inducing_gp::FITC`` and ``inducing_gp::VFE``): with :math:`V = L_u^{-1} K_{uf}` (:math:`L_u` being the Cholesky factor of :math:`K_{uu}`), the kernel matrix of the samples is approximated by :math:`V^T V + \Lambda`, with a diagonal :math:`\Lambda`, so that only the Cholesky factor of the :math:`m \times m` matrix :math:`B = I + V \Lambda^{-1} V^T` is needed:
+
+          - training is :math:`O(nm^2)` with triangular solves only (the samples are processed by blocks, so that :math:`K_{uf}` is never stored)
+          - adding a sample is :math:`O(m^2)` (rank-1 update of the Cholesky factor of :math:`B`); the inducing points are kept fixed until update_inducing() or optimize_hyperparams() is called
+          - :math:`\mu` is :math:`O(m)` and :math:`\sigma^2` is :math:`O(m^2)`, whatever the number of samples; query_batch() does them with multi-RHS solves
+
+          As long as there are fewer samples than ``inducing_points``, all the samples are inducing points (and the model is an exact GP). Otherwise, the inducing points are chosen among the samples by a greedy pivoted Cholesky decomposition of the kernel matrix (each new point is the sample with the largest variance left unexplained by the previous ones, in :math:`O(nm^2)`).
+
+          The interface is the one of GP (compute(), add_sample(), query(), optimize_hyperparams(), ...), so that it can be used by the Bayesian optimizers. The hyper-parameters of any kernel of ``limbo/kernel/`` can be optimized with gp::KernelLFOpt (analytic gradient of the FITC likelihood or of the VFE bound, in :math:`O(nm^2)`); the inducing points are selected again before and after the optimization.
+
+          Parameters:
+            - ``int inducing_points`` (maximum number of inducing points)
+            - ``double jitter`` (relative jitter of the kernel matrix of the inducing points)
+          \endrst
+        */
+        template <typename Params, typename KernelFunction = kernel::SquaredExpARD<Params>, typename MeanFunction = mean::Data<Params>, typename HyperParamsOptimizer = gp::NoLFOpt<Params>, typename Approximation = inducing_gp::FITC>
+        class InducingGP {
+        public:
+            /// useful because the model might be created before knowing anything about the process
+            InducingGP() : _dim_in(-1), _dim_out(-1), _nb_samples(0), _log_lik(0) {}
+
+            /// useful because the model might be created before having samples
+            InducingGP(int dim_in, int dim_out)
+                : _dim_in(dim_in), _dim_out(dim_out), _kernel_function(dim_in), _mean_function(dim_out), _nb_samples(0), _log_lik(0) {}
+
+            /// Compute the model from samples and observations (and select the inducing points). This call needs to be explicit!
+            void compute(const std::vector<Eigen::VectorXd>& samples,
+                const std::vector<Eigen::VectorXd>& observations, bool compute_kernel = true)
+            {
+                assert(samples.size() != 0);
+                assert(observations.size() != 0);
+                assert(samples.size() == observations.size());
+
+                _set_dims(samples[0].size(), observations[0].size());
+
+                _nb_samples = samples.size();
+                _samples.resize(_dim_in, _nb_samples);
+                _observations.resize(_nb_samples, _dim_out);
+                for (int i = 0; i < _nb_samples; ++i) {
+                    _samples.col(i) = samples[i];
+                    _observations.row(i) = observations[i];
+                }
+                _mean_observation = observations_matrix().colwise().mean();
+
+                if (compute_kernel)
+                    update_inducing();
+            }
+
+            /// Do not forget to call this if you use hyper-parameters optimization!!
+            /// (the inducing points are selected again before and after the optimization)
+            void optimize_hyperparams()
+            {
+                _select_inducing();
+                _hp_optimize(*this);
+                update_inducing();
+            }
+
+            /// select the inducing points among the samples (with the current hyper-parameters) and recompute the model, in O(nm^2)
+            void update_inducing()
+            {
+                _select_inducing();
+                recompute();
+            }
+
+            /// add a sample; once there are more samples than inducing points, the inducing points are kept fixed
+            /// and the model is updated with a rank-1 update of the Cholesky factor of B, in O(m^2)
+            void add_sample(const Eigen::VectorXd& sample, const Eigen::VectorXd& observation)
+            {
+                if (_nb_samples == 0)
+                    _set_dims(sample.size(), observation.size());
+                else {
+                    assert(sample.size() == _dim_in);
+                    assert(observation.size() == _dim_out);
+                }
+
+                // amortized growth of the storage
+                if (_nb_samples == _samples.cols()) {
+                    _samples.conservativeResize(_dim_in, std::max(2 * _nb_samples, 1));
+                    _observations.conservativeResize(std::max(2 * _nb_samples, 1), _dim_out);
+                }
+                _samples.col(_nb_samples) = sample;
+                _observations.row(_nb_samples) = observation.transpose();
+                _nb_samples++;
+
+                // running mean of the observations
+                _mean_observation = (_nb_samples == 1) ? observation : Eigen::VectorXd(_mean_observation + (observation - _mean_observation) / _nb_samples);
+
+                if (_nb_samples <= nb_inducing() || _inducing.cols() == 0) {
+                    update_inducing();
+                    return;
+                }
+
+                Eigen::MatrixXd v;
+                Eigen::VectorXd lambda;
+                _project_block(_kernel_function, _llt_u, _nb_samples - 1, 1, v, lambda);
+                _llt_b.rankUpdate(v.col(0) / std::sqrt(lambda(0)));
+                _b_obs.noalias() += v.col(0) * observation.transpose() / lambda(0);
+                _b_ones += v.col(0) / lambda(0);
+                if (!mean::is_constant<MeanFunction>::value)
+                    _b_mean.noalias() += v.col(0) * _mean_function(sample, *this).transpose() / lambda(0);
+                _compute_alpha();
+            }
+
+            /**
+             \\rst
+             return :math:`\mu`, :math:`\sigma^2` (un-normalized). If there is no sample, return the value according to the mean function and the prior variance.
+             \\endrst
+            */
+            std::tuple<Eigen::VectorXd, double> query(const Eigen::VectorXd& v) const
+            {
+                if (_nb_samples == 0)
+                    return std::make_tuple(_mean_function(v, *this), _kernel_function(v, v) + _kernel_function.noise());
+
+                Eigen::VectorXd k = _compute_k(v);
+                return std::make_tuple(_mu(v, k), _sigma(v, k) + _kernel_function.noise());
+            }
+
+            /**
+             \\rst
+             return :math:`\mu` (un-normalized). If there is no sample, return the value according to the mean function.
+             \\endrst
+            */
+            Eigen::VectorXd mu(const Eigen::VectorXd& v) const
+            {
+                if (_nb_samples == 0)
+                    return _mean_function(v, *this);
+                return _mu(v, _compute_k(v));
+            }
+
+            /**
+             \\rst
+             return :math:`\sigma^2` (un-normalized). If there is no sample, return the prior variance.
+             \\endrst
+            */
+            double sigma(const Eigen::VectorXd& v) const
+            {
+                if (_nb_samples == 0)
+                    return _kernel_function(v, v) + _kernel_function.noise();
+                return _sigma(v, _compute_k(v)) + _kernel_function.noise();
+            }
+
+            /**
+             \\rst
+             return :math:`\mu` (MxD) and :math:`\sigma^2` (M) (un-normalized) for the M rows of ``X``, with a single kernel matrix and multi-RHS triangular solves.
+             \\endrst
+            */
+            std::tuple<Eigen::MatrixXd, Eigen::VectorXd> query_batch(const Eigen::MatrixXd& X) const
+            {
+                if (_nb_samples == 0)
+                    return std::make_tuple(_mean_batch(X), sigma_batch(X));
+
+                Eigen::MatrixXd K = _kernel_function.kernel_matrix(_inducing, X.transpose());
+                Eigen::VectorXd sigma = _sigma_batch(X, K).array() + _kernel_function.noise();
+                return std::make_tuple(_mu_batch(X, K), sigma);
+            }
+
+            /// return :math:`\mu` (MxD, un-normalized) for the M rows of X
+            Eigen::MatrixXd mu_batch(const Eigen::MatrixXd& X) const
+            {
+                if (_nb_samples == 0)
+                    return _mean_batch(X);
+                return _mu_batch(X, _kernel_function.kernel_matrix(_inducing, X.transpose()));
+            }
+
+            /// return :math:`\sigma^2` (M, un-normalized) for the M rows of X
+            Eigen::VectorXd sigma_batch(const Eigen::MatrixXd& X) const
+            {
+                if (_nb_samples == 0)
+                    return _kernel_function.kernel_diag(X.transpose()).array() + _kernel_function.noise();
+                return _sigma_batch(X, _kernel_function.kernel_matrix(_inducing, X.transpose())).array() + _kernel_function.noise();
+            }
+
+            /// return the inducing points (DxM, one per column)
+            const Eigen::MatrixXd& inducing_points() const { return _inducing; }
+
+            /// return the maximum number of inducing points
+            int nb_inducing() const { return Params::model_inducing_gp::inducing_points(); }
+
+            /// return the number of dimensions of the input
+            int dim_in() const
+            {
+                assert(_dim_in != -1); // need to compute first!
+                return _dim_in;
+            }
+
+            /// return the number of dimensions of the output
+            int dim_out() const
+            {
+                assert(_dim_out != -1); // need to compute first!
+                return _dim_out;
+            }
+
+            const KernelFunction& kernel_function() const { return _kernel_function; }
+
+            KernelFunction& kernel_function() { return _kernel_function; }
+
+            const MeanFunction& mean_function() const { return _mean_function; }
+
+            MeanFunction& mean_function() { return _mean_function; }
+
+            /// return the maximum observation (only call this if the output of the model is of dimension 1)
+            Eigen::VectorXd max_observation() const
+            {
+                if (_dim_out > 1)
+                    std::cout << "WARNING max_observation with multi dimensional "
+                                 "observations doesn't make sense"
+                              << std::endl;
+                return tools::make_vector(observations_matrix().maxCoeff());
+            }
+
+            /// return the mean observation (only call this if the output of the model is of dimension 1)
+            Eigen::VectorXd mean_observation() const
+            {
+                assert(_dim_out > 0);
+                return _nb_samples > 0 ? _mean_observation
+                                       : Eigen::VectorXd::Zero(_dim_out);
+            }
+
+            /// return the number of samples used to compute the model
+            int nb_samples() const { return _nb_samples; }
+
+            /// recompute the model with the current inducing points, in O(nm^2)
+            /// (if update_full_kernel is false, only the mean has changed)
+            void recompute(bool update_obs_mean = true, bool update_full_kernel = true)
+            {
+                assert(_nb_samples > 0);
+
+                if (update_full_kernel || !mean::is_constant<MeanFunction>::value) {
+                    _factorize_inducing(_kernel_function, _llt_u);
+                    Eigen::MatrixXd B;
+                    _accumulate(_kernel_function, _llt_u, B, _b_obs, _b_ones, _b_mean);
+                    _llt_b.compute(B);
+                }
+
+                _compute_alpha();
+            }
+
+            /// compute and return the log likelihood (or its lower bound for VFE), in O(nm^2)
+            double compute_log_lik()
+            {
+                LikelihoodWorkspace ws;
+                _log_lik = compute_log_lik(_kernel_function, ws);
+                return _log_lik;
+            }
+
+            /// buffers used to evaluate the log likelihood for other hyper-parameters
+            /// without copying (or modifying) the model (see gp::KernelLFOpt)
+            struct LikelihoodWorkspace {
+                /// Cholesky factors of K_uu (with jitter) and of B = I + V * Lambda^{-1} * V^T
+                Eigen::LLT<Eigen::MatrixXd> llt_u, llt_b;
+                /// L_B^{-1} * V * Lambda^{-1} * (observations - mean)
+                Eigen::MatrixXd c;
+                /// V and Lambda for a block of samples
+                Eigen::MatrixXd V;
+                Eigen::VectorXd lambda;
+            };
+
+            /// compute and return the log likelihood of the current samples with the kernel function `kernel_function`
+            /// (and the current mean and inducing points); the factorization is stored in `ws` and the model is left untouched
+            double compute_log_lik(const KernelFunction& kernel_function, LikelihoodWorkspace& ws) const
+            {
+                int n = _nb_samples, m = _inducing.cols();
+                double noise = kernel_function.noise() + 1e-8;
+
+                _factorize_inducing(kernel_function, ws.llt_u);
+                Eigen::MatrixXd B = Eigen::MatrixXd::Identity(m, m);
+                Eigen::MatrixXd b = Eigen::MatrixXd::Zero(m, _dim_out);
+                double r_sq = 0, log_lambda = 0, trace = 0;
+                for (int start = 0; start < n; start += _block_size()) {
+                    int rows = std::min(_block_size(), n - start);
+                    _project_block(kernel_function, ws.llt_u, start, rows, ws.V, ws.lambda);
+                    Eigen::MatrixXd R = _residual_block(start, rows);
+                    B.selfadjointView<Eigen::Lower>().rankUpdate(ws.V * ws.lambda.cwiseSqrt().cwiseInverse().asDiagonal());
+                    b.noalias() += ws.V * ws.lambda.cwiseInverse().asDiagonal() * R;
+                    r_sq += (R.array().square().colwise() / ws.lambda.array()).sum();
+                    log_lambda += ws.lambda.array().log().sum();
+                    if (!Approximation::exact_variance())
+                        trace += _residual_variance(kernel_function, start, rows, ws.V).sum();
+                }
+                ws.llt_b.compute(B);
+                ws.c = ws.llt_b.matrixL().solve(b);
+
+                // with C = V^T * V + Lambda: r^T C^{-1} r = r^T Lambda^{-1} r - |c|^2
+                // and log|C| = log|B| + log|Lambda| (only once for all the outputs, like GP)
+                double a = r_sq - ws.c.squaredNorm();
+                long double logdet = 2 * ws.llt_b.matrixLLT().diagonal().array().log().sum() + log_lambda;
+
+                double lik = -0.5 * a - 0.5 * logdet - 0.5 * n * std::log(2 * M_PI);
+                if (!Approximation::exact_variance())
+                    lik -= 0.5 * trace / noise;
+                return lik;
+            }
+
+            /// compute and return the gradient of the log likelihood wrt to the parameters of `kernel_function`
+            /// (call compute_log_lik(kernel_function, ws) first)
+            Eigen::VectorXd compute_kernel_grad_log_lik(const KernelFunction& kernel_function, LikelihoodWorkspace& ws) const
+            {
+                int n = _nb_samples, m = _inducing.cols();
+                double noise = kernel_function.noise() + 1e-8;
+                int nb_params = kernel_function.h_params_size() - (Params::kernel::optimize_noise() ? 1 : 0);
+
+                // with W = C^{-1} r r^T C^{-1} - C^{-1}, dlik = tr(M dQ) / 2 + sum_i g_i dK_ii + (noise terms),
+                // where M = W - diag(W) and g = diag(W) / 2 (FITC), or M = W + I / noise and g = -1 / (2 noise) (VFE);
+                // with A = K_uu^{-1} K_uf and dQ = dK_fu A + A^T dK_uf - A^T dK_uu A, tr(M dQ) / 2 is
+                // sum(P .* dK_uf) - sum(A M A^T .* dK_uu) / 2, with P = A M (accumulated by blocks of samples)
+                Eigen::MatrixXd d = ws.llt_b.matrixU().solve(ws.c);
+                Eigen::MatrixXd B_inv = ws.llt_b.solve(Eigen::MatrixXd::Identity(m, m));
+                Eigen::MatrixXd R_uu = Eigen::MatrixXd::Zero(m, m);
+                Eigen::VectorXd grad = Eigen::VectorXd::Zero(kernel_function.h_params_size());
+                double g_noise = 0;
+                for (int start = 0; start < n; start += _block_size()) {
+                    int rows = std::min(_block_size(), n - start);
+                    _project_block(kernel_function, ws.llt_u, start, rows, ws.V, ws.lambda);
+                    Eigen::ArrayXd lambda_inv = ws.lambda.array().inverse();
+
+                    // beta = C^{-1} r = Lambda^{-1} (r - V^T L_B^{-T} c) and diag(C^{-1}) = (1 - diag(V^T B^{-1} V) / lambda) / lambda
+                    Eigen::MatrixXd beta = lambda_inv.matrix().asDiagonal() * (_residual_block(start, rows) - ws.V.transpose() * d);
+                    Eigen::MatrixXd BV = B_inv * ws.V;
+                    Eigen::ArrayXd c_inv_diag = lambda_inv * (1. - (ws.V.array() * BV.array()).colwise().sum().transpose() * lambda_inv);
+                    Eigen::ArrayXd w_diag = beta.rowwise().squaredNorm().array() - c_inv_diag;
+
+                    // A C^{-1} = L_u^{-T} B^{-1} V Lambda^{-1}
+                    Eigen::MatrixXd A = ws.llt_u.matrixU().solve(ws.V);
+                    Eigen::MatrixXd P = (A * beta) * beta.transpose() - ws.llt_u.matrixU().solve(BV * lambda_inv.matrix().asDiagonal());
+                    Eigen::VectorXd g_diag;
+                    if (Approximation::exact_variance()) {
+                        P -= A * w_diag.matrix().asDiagonal();
+                        g_diag = 0.5 * w_diag.matrix();
+                        g_noise += 0.5 * w_diag.sum();
+                    }
+                    else {
+                        P += A / noise;
+                        g_diag = Eigen::VectorXd::Constant(rows, -0.5 / noise);
+                        g_noise += 0.5 * w_diag.sum() + 0.5 * _residual_variance(kernel_function, start, rows, ws.V).sum() / (noise * noise);
+                    }
+                    R_uu.noalias() += P * A.transpose();
+
+                    auto X = _samples.middleCols(start, rows);
+                    grad.head(nb_params) += _grad_sum(kernel_function, _inducing, X, P, nb_params) + _grad_diag_sum(kernel_function, X, g_diag, nb_params);
+                }
+                grad.head(nb_params) -= 0.5 * _grad_sum(kernel_function, _inducing, _inducing, R_uu, nb_params);
+
+                // noise = exp(2 * p)
+                if (Params::kernel::optimize_noise())
+                    grad(nb_params) = g_noise * 2 * kernel_function.noise();
+
+                return grad;
+            }
+
+            /// return the likelihood (do not compute it -- return last computed)
+            double get_log_lik() const { return _log_lik; }
+
+            /// set the log likelihood (e.g. computed from outside)
+            void set_log_lik(double log_lik) { _log_lik = log_lik; }
+
+            /// return the list of samples
+            std::vector<Eigen::VectorXd> samples() const
+            {
+                std::vector<Eigen::VectorXd> samples(_nb_samples);
+                for (int i = 0; i < _nb_samples; i++)
+                    samples[i] = _samples.col(i);
+                return samples;
+            }
+
+            /// return the samples (in matrix form)
+            /// (DxN), where D is the dimension of the input and N the number of points
+            Eigen::MatrixXd::ConstColsBlockXpr samples_matrix() const
+            {
+                return _samples.leftCols(_nb_samples);
+            }
+
+            /// return the list of observations
+            std::vector<Eigen::VectorXd> observations() const
+            {
+                std::vector<Eigen::VectorXd> observations(_nb_samples);
+                for (int i = 0; i < _nb_samples; i++)
+                    observations[i] = _observations.row(i);
+                return observations;
+            }
+
+            /// return the observations (in matrix form)
+            /// (NxD), where N is the number of points and D is the dimension output
+            Eigen::MatrixXd::ConstRowsBlockXpr observations_matrix() const
+            {
+                return _observations.topRows(_nb_samples);
+            }
+
+        protected:
+            int _dim_in;
+            int _dim_out;
+
+            KernelFunction _kernel_function;
+            MeanFunction _mean_function;
+
+            // one sample per column (and one observation per row), with a spare capacity
+            Eigen::MatrixXd _samples;
+            Eigen::MatrixXd _observations;
+            int _nb_samples;
+            Eigen::VectorXd _mean_observation;
+
+            // inducing points (one per column)
+            Eigen::MatrixXd _inducing;
+
+            // Cholesky factors of K_uu and of B = I + V * Lambda^{-1} * V^T, V * Lambda^{-1} * observations,
+            // V * Lambda^{-1} * 1 and V * Lambda^{-1} * mean (only for mean functions that are not constant)
+            Eigen::LLT<Eigen::MatrixXd> _llt_u, _llt_b;
+            Eigen::MatrixXd _b_obs;
+            Eigen::VectorXd _b_ones;
+            Eigen::MatrixXd _b_mean;
+            // mu(x) = mean(x) + k_u(x)^T * alpha
+            Eigen::MatrixXd _alpha;
+
+            double _log_lik;
+
+            HyperParamsOptimizer _hp_optimize;
+
+            static int _block_size() { return 1024; }
+
+            void _set_dims(int dim_in, int dim_out)
+            {
+                if (_dim_in != dim_in) {
+                    _dim_in = dim_in;
+                    _kernel_function = KernelFunction(_dim_in); // the cost of building a functor should be relatively low
+                }
+                if (_dim_out != dim_out) {
+                    _dim_out = dim_out;
+                    _mean_function = MeanFunction(_dim_out); // the cost of building a functor should be relatively low
+                }
+            }
+
+            // greedy pivoted Cholesky decomposition of the kernel matrix of the samples, in O(nm^2):
+            // the next inducing point is the sample with the largest residual variance
+            void _select_inducing()
+            {
+                int n = _nb_samples, m = std::min(n, nb_inducing());
+                if (m == n) {
+                    _inducing = samples_matrix();
+                    return;
+                }
+
+                Eigen::VectorXd d = _kernel_function.kernel_diag(samples_matrix());
+                double tol = 1e-10 * std::max(d.maxCoeff(), std::numeric_limits<double>::min());
+                Eigen::MatrixXd L(n, m);
+                std::vector<int> selected;
+                for (int j = 0; j < m; j++) {
+                    int p;
+                    if (d.maxCoeff(&p) <= tol)
+                        break;
+                    selected.push_back(p);
+                    L.col(j) = _kernel_function.kernel_matrix(samples_matrix(), _samples.col(p));
+                    L.col(j).noalias() -= L.leftCols(j) * L.row(p).head(j).transpose();
+                    L.col(j) /= std::sqrt(d(p));
+                    d -= L.col(j).cwiseAbs2();
+                    d(p) = 0;
+                }
+
+                _inducing.resize(_dim_in, selected.size());
+                for (size_t j = 0; j < selected.size(); j++)
+                    _inducing.col(j) = _samples.col(selected[j]);
+            }
+
+            void _factorize_inducing(const KernelFunction& kernel_function, Eigen::LLT<Eigen::MatrixXd>& llt_u) const
+            {
+                Eigen::MatrixXd K = kernel_function.kernel_matrix(_inducing, _inducing);
+                double scale = std::max(K.diagonal().mean(), std::numeric_limits<double>::min());
+                K.diagonal().array() += Params::model_inducing_gp::jitter() * scale;
+                llt_u.compute(K);
+            }
+
+            // V = L_u^{-1} K_uf and the diagonal of Lambda for the samples [start, start + rows)
+            void _project_block(const KernelFunction& kernel_function, const Eigen::LLT<Eigen::MatrixXd>& llt_u, int start, int rows, Eigen::MatrixXd& V, Eigen::VectorXd& lambda) const
+            {
+                V = kernel_function.kernel_matrix(_inducing, _samples.middleCols(start, rows));
+                llt_u.matrixL().solveInPlace(V);
+                double noise = kernel_function.noise() + 1e-8;
+                if (Approximation::exact_variance())
+                    lambda = _residual_variance(kernel_function, start, rows, V).array() + noise;
+                else
+                    lambda = Eigen::VectorXd::Constant(rows, noise);
+            }
+
+            // diag(K - Q) for the samples [start, start + rows), with Q = V^T * V
+            Eigen::VectorXd _residual_variance(const KernelFunction& kernel_function, int start, int rows, const Eigen::MatrixXd& V) const
+            {
+                return (kernel_function.kernel_diag(_samples.middleCols(start, rows)) - V.colwise().squaredNorm().transpose()).cwiseMax(0.);
+            }
+
+            // B = I + V * Lambda^{-1} * V^T (lower triangle only), and V * Lambda^{-1} times the observations, 1 and the mean, by blocks of samples
+            void _accumulate(const KernelFunction& kernel_function, const Eigen::LLT<Eigen::MatrixXd>& llt_u, Eigen::MatrixXd& B, Eigen::MatrixXd& b_obs, Eigen::VectorXd& b_ones, Eigen::MatrixXd& b_mean) const
+            {
+                int m = _inducing.cols();
+                B = Eigen::MatrixXd::Identity(m, m);
+                b_obs.setZero(m, _dim_out);
+                b_ones.setZero(m);
+                b_mean.setZero(m, _dim_out);
+
+                Eigen::MatrixXd V, V_l;
+                Eigen::VectorXd lambda;
+                for (int start = 0; start < _nb_samples; start += _block_size()) {
+                    int rows = std::min(_block_size(), _nb_samples - start);
+                    _project_block(kernel_function, llt_u, start, rows, V, lambda);
+                    B.selfadjointView<Eigen::Lower>().rankUpdate(V * lambda.cwiseSqrt().cwiseInverse().asDiagonal());
+                    V_l = V * lambda.cwiseInverse().asDiagonal();
+                    b_obs.noalias() += V_l * _observations.middleRows(start, rows);
+                    b_ones.noalias() += V_l.rowwise().sum();
+                    if (!mean::is_constant<MeanFunction>::value)
+                        b_mean.noalias() += V_l * _mean_block(start, rows);
+                }
+            }
+
+            // mean function at the samples [start, start + rows) (one row per sample)
+            Eigen::MatrixXd _mean_block(int start, int rows) const
+            {
+                Eigen::MatrixXd mean(rows, _dim_out);
+                if (mean::is_constant<MeanFunction>::value)
+                    mean = _mean_function(_samples.col(0), *this).transpose().replicate(rows, 1);
+                else
+                    for (int i = 0; i < rows; i++)
+                        mean.row(i) = _mean_function(_samples.col(start + i), *this);
+                return mean;
+            }
+
+            Eigen::MatrixXd _residual_block(int start, int rows) const
+            {
+                return _observations.middleRows(start, rows) - _mean_block(start, rows);
+            }
+
+            // alpha = L_u^{-T} * B^{-1} * V * Lambda^{-1} * (observations - mean)
+            void _compute_alpha()
+            {
+                Eigen::MatrixXd b = mean::is_constant<MeanFunction>::value
+                    ? Eigen::MatrixXd(_b_obs - _b_ones * _mean_function(_samples.col(0), *this).transpose())
+                    : Eigen::MatrixXd(_b_obs - _b_mean);
+                _alpha = _llt_b.solve(b);
+                _llt_u.matrixU().solveInPlace(_alpha);
+            }
+
+            // sum over (i, j) of W(i, j) * dk(X1.col(i), X2.col(j)) for the (non-noise) hyper-parameters,
+            // in parallel over blocks of columns (each block accumulates in its own column)
+            template <typename M>
+            static Eigen::VectorXd _grad_sum(const KernelFunction& kernel_function, const Eigen::MatrixXd& X1, const M& X2, const Eigen::MatrixXd& W, int nb_params)
+            {
+                int n = X2.cols(), block_size = 32;
+                int nb_blocks = (n + block_size - 1) / block_size;
+                Eigen::MatrixXd g = Eigen::MatrixXd::Zero(nb_params, nb_blocks);
+                tools::par::loop(0, nb_blocks, [&](size_t b) {
+                    int end = std::min(n, int(b + 1) * block_size);
+                    for (int j = b * block_size; j < end; ++j)
+                        for (int i = 0; i < X1.cols(); ++i)
+                            g.col(b) += W(i, j) * kernel_function.grad(X1.col(i), X2.col(j)).head(nb_params);
+                });
+                return g.rowwise().sum();
+            }
+
+            // sum over i of w(i) * dk(X.col(i), X.col(i)) for the (non-noise) hyper-parameters
+            template <typename M>
+            static Eigen::VectorXd _grad_diag_sum(const KernelFunction& kernel_function, const M& X, const Eigen::VectorXd& w, int nb_params)
+            {
+                Eigen::VectorXd g = Eigen::VectorXd::Zero(nb_params);
+                for (int i = 0; i < X.cols(); ++i)
+                    g += w(i) * kernel_function.grad(X.col(i), X.col(i)).head(nb_params);
+                return g;
+            }
+
+            Eigen::VectorXd _compute_k(const Eigen::VectorXd& v) const
+            {
+                return _kernel_function.kernel_matrix(_inducing, v);
+            }
+
+            Eigen::VectorXd _mu(const Eigen::VectorXd& v, const Eigen::VectorXd& k) const
+            {
+                return _alpha.transpose() * k + _mean_function(v, *this);
+            }
+
+            double _sigma(const Eigen::VectorXd& v, const Eigen::VectorXd& k) const
+            {
+                // k(v, v) - |w|^2 + |L_B^{-1} w|^2, with w = L_u^{-1} k
+                Eigen::VectorXd w = _llt_u.matrixL().solve(k);
+                double res = _kernel_function(v, v) - w.squaredNorm() + _llt_b.matrixL().solve(w).squaredNorm();
+                return (res <= std::numeric_limits<double>::epsilon()) ? 0 : res;
+            }
+
+            Eigen::MatrixXd _mu_batch(const Eigen::MatrixXd& X, const Eigen::MatrixXd& K) const
+            {
+                return K.transpose() * _alpha + _mean_batch(X);
+            }
+
+            Eigen::VectorXd _sigma_batch(const Eigen::MatrixXd& X, const Eigen::MatrixXd& K) const
+            {
+                Eigen::MatrixXd W = _llt_u.matrixL().solve(K);
+                Eigen::VectorXd res = _kernel_function.kernel_diag(X.transpose()) - W.colwise().squaredNorm().transpose();
+                _llt_b.matrixL().solveInPlace(W);
+                res += W.colwise().squaredNorm().transpose();
+                return (res.array() <= std::numeric_limits<double>::epsilon()).select(0., res);
+            }
+
+            Eigen::MatrixXd _mean_batch(const Eigen::MatrixXd& X) const
+            {
+                Eigen::MatrixXd mu(X.rows(), _dim_out);
+                for (int i = 0; i < X.rows(); i++)
+                    mu.row(i) = _mean_function(X.row(i).transpose(), *this);
+                return mu;
+            }
+        };
+    } // namespace model
+} // namespace limbo
+
+#endif
@@ -0,0 +1,644 @@
+//| Copyright Inria May 2015
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Jean-Baptiste Mouret (jean-baptiste.mouret@inria.fr)
+//|   - Antoine Cully (antoinecully@gmail.com)
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Federico Allocati (fede.allocati@gmail.com)
+//|   - Vaios Papaspyros (b.papaspyros@gmail.com)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is a computer library whose purpose is to optimize continuous,
+//| black-box functions. It mainly implements Gaussian processes and Bayesian
+//| optimization.
+//| Main repository: http://github.com/resibots/limbo
+//| Documentation: http://www.resibots.eu/limbo
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+
+#ifndef LIMBO_MODEL_KISS_GP_HPP
+#define LIMBO_MODEL_KISS_GP_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+#include <Eigen/Cholesky>
+#include <Eigen/Core>
+#include <unsupported/Eigen/FFT>
+
+#include <limbo/kernel/squared_exp_ard.hpp>
+#include <limbo/mean/data.hpp>
+#include <limbo/tools/krylov.hpp>
+#include <limbo/tools/macros.hpp>
+#include <limbo/tools/math.hpp>
+#include <limbo/tools/parallel.hpp>
+
+namespace limbo {
+    namespace defaults {
+        struct model_kiss_gp {
+            /// number of grid points per dimension (0: as many as possible, up to 128, with at most 2^18 points
+            /// in the circulant embedding of the grid, i.e. 128 in 1-D and 2-D, 32 in 3-D and 10 in 4-D)
+            BO_PARAM(int, grid_size, 0);
+            /// relative tolerance of the conjugate gradients
+            BO_PARAM(double, cg_tolerance, 1e-8);
+            /// maximum number of iterations of the conjugate gradients
+            BO_PARAM(int, cg_max_iterations, 1000);
+            /// number of Lanczos iterations for the predictive variance
+            BO_PARAM(int, lanczos_iterations, 100);
+        };
+    } // namespace defaults
+
+    namespace model {
+        /**
+          @ingroup model
+          \rst
+          A Gaussian process with structured kernel interpolation (KISS-GP, Wilson and Nickisch, 2015), for low-dimensional inputs and many samples: the kernel matrix of the samples is approximated by :math:`W K_{uu} W^T`, where :math:`K_{uu}` is the kernel matrix of a regular grid of :math:`g^d` inducing points and each row of :math:`W` holds the :math:`4^d` weights of the (Keys) cubic interpolation of a sample on the grid.
+
+          - :math:`K_{uu}` is block-Toeplitz for any stationary kernel of ``limbo/kernel/``: it is never stored, and its products are done with FFTs of its circulant embedding, in :math:`O(g^d \log g^d)`
+          - :math:`\alpha = (W K_{uu} W^T + \sigma_n^2 I)^{-1} (y - m)` is computed with conjugate gradients (each iteration is :math:`O(4^d n + g^d \log g^d)`, and the previous solution is the initial guess when a sample is added)
+          - the predictive variance uses a Lanczos decomposition of the same matrix (LOVE, Pleiss et al., 2018): with :math:`k` iterations, :math:`(W K_{uu} W^T + \sigma_n^2 I)^{-1} \approx Q T^{-1} Q^T`, which slightly over-estimates the variance
+          - :math:`\mu` is :math:`O(4^d)` and :math:`\sigma^2` is :math:`O(4^d k)`, whatever the number of samples
+
+          The grid covers :math:`[0, 1]^d` (the bounds of the optimizers of BOptimizer): inputs outside of it are clamped to its boundary; the number of dimensions is limited to 4 (the stencils have :math:`4^d` points). The interface is the one of GP (compute(), add_sample(), query(), ...), so that it can be used by the Bayesian optimizers, but the likelihood is not computed: the hyper-parameters are not optimized (they are the ones of the kernel function, e.g. set with ``kernel_function().set_h_params()`` before compute()).
+
+          Parameters:
+            - ``int grid_size`` (number of grid points per dimension, 0 for automatic)
+            - ``double cg_tolerance`` (relative tolerance of the conjugate gradients)
+            - ``int cg_max_iterations``
+            - ``int lanczos_iterations`` (rank of the approximation of the predictive variance)
+          \endrst
+        */
+        template <typename Params, typename KernelFunction = kernel::SquaredExpARD<Params>, typename MeanFunction = mean::Data<Params>>
+        class KISSGP {
+        public:
+            /// useful because the model might be created before knowing anything about the process
+            KISSGP() : _dim_in(-1), _dim_out(-1), _nb_samples(0), _cg_iterations(0) {}
+
+            /// useful because the model might be created before having samples
+            KISSGP(int dim_in, int dim_out)
+                : _dim_in(dim_in), _dim_out(dim_out), _kernel_function(dim_in), _mean_function(dim_out), _nb_samples(0), _cg_iterations(0)
+            {
+                _make_grid();
+            }
+
+            /// Compute the model from samples and observations. This call needs to be explicit!
+            void compute(const std::vector<Eigen::VectorXd>& samples,
+                const std::vector<Eigen::VectorXd>& observations, bool compute_kernel = true)
+            {
+                assert(samples.size() != 0);
+                assert(observations.size() != 0);
+                assert(samples.size() == observations.size());
+
+                _set_dims(samples[0].size(), observations[0].size());
+
+                _nb_samples = samples.size();
+                _samples.resize(_dim_in, _nb_samples);
+                _observations.resize(_nb_samples, _dim_out);
+                _interp_base.resize(_nb_samples);
+                _interp_weights.resize(4 * _dim_in, _nb_samples);
+                for (int i = 0; i < _nb_samples; ++i) {
+                    _samples.col(i) = samples[i];
+                    _observations.row(i) = observations[i];
+                    _interpolation(_samples.col(i), _interp_base(i), _interp_weights.col(i));
+                }
+                _mean_observation = observations_matrix().colwise().mean();
+                _alpha.resize(0, 0);
+
+                if (compute_kernel)
+                    recompute();
+            }
+
+            /// the hyper-parameters are not optimized (there is no likelihood): this only warns
+            /// (e.g. when BOptimizer is used with a positive hp_period)
+            void optimize_hyperparams()
+            {
+                std::cerr << "[KISSGP]: the hyper-parameters cannot be optimized (set them in the kernel function)" << std::endl;
+            }
+
+            /// add a sample and recompute the model (the previous solution is the initial guess of the conjugate gradients)
+            void add_sample(const Eigen::VectorXd& sample, const Eigen::VectorXd& observation)
+            {
+                if (_nb_samples == 0)
+                    _set_dims(sample.size(), observation.size());
+                else {
+                    assert(sample.size() == _dim_in);
+                    assert(observation.size() == _dim_out);
+                }
+
+                // amortized growth of the storage
+                if (_nb_samples == _samples.cols()) {
+                    int capacity = std::max(2 * _nb_samples, 1);
+                    _samples.conservativeResize(_dim_in, capacity);
+                    _observations.conservativeResize(capacity, _dim_out);
+                    _interp_base.conservativeResize(capacity);
+                    _interp_weights.conservativeResize(4 * _dim_in, capacity);
+                }
+                _samples.col(_nb_samples) = sample;
+                _observations.row(_nb_samples) = observation.transpose();
+                _interpolation(sample, _interp_base(_nb_samples), _interp_weights.col(_nb_samples));
+                _nb_samples++;
+
+                // running mean of the observations
+                _mean_observation = (_nb_samples == 1) ? observation : Eigen::VectorXd(_mean_observation + (observation - _mean_observation) / _nb_samples);
+
+                recompute(true, _spectrum.size() == 0);
+            }
+
+            /**
+             \\rst
+             return :math:`\mu`, :math:`\sigma^2` (un-normalized). If there is no sample, return the value according to the mean function and the prior variance.
+             \\endrst
+            */
+            std::tuple<Eigen::VectorXd, double> query(const Eigen::VectorXd& v) const
+            {
+                if (_nb_samples == 0)
+                    return std::make_tuple(_mean_function(v, *this), _kernel_function(v, v) + _kernel_function.noise());
+
+                int base;
+                Eigen::VectorXd w(4 * _dim_in);
+                _interpolation(v, base, w);
+                return std::make_tuple(_mu(v, base, w), _sigma(v, base, w) + _kernel_function.noise());
+            }
+
+            /**
+             \\rst
+             return :math:`\mu` (un-normalized). If there is no sample, return the value according to the mean function.
+             \\endrst
+            */
+            Eigen::VectorXd mu(const Eigen::VectorXd& v) const
+            {
+                if (_nb_samples == 0)
+                    return _mean_function(v, *this);
+
+                int base;
+                Eigen::VectorXd w(4 * _dim_in);
+                _interpolation(v, base, w);
+                return _mu(v, base, w);
+            }
+
+            /**
+             \\rst
+             return :math:`\sigma^2` (un-normalized). If there is no sample, return the prior variance.
+             \\endrst
+            */
+            double sigma(const Eigen::VectorXd& v) const
+            {
+                if (_nb_samples == 0)
+                    return _kernel_function(v, v) + _kernel_function.noise();
+
+                int base;
+                Eigen::VectorXd w(4 * _dim_in);
+                _interpolation(v, base, w);
+                return _sigma(v, base, w) + _kernel_function.noise();
+            }
+
+            /// return the number of grid points per dimension
+            int grid_size() const { return _grid_size; }
+
+            /// return the number of iterations of the last conjugate gradients
+            int nb_cg_iterations() const { return _cg_iterations; }
+
+            /// return the number of dimensions of the input
+            int dim_in() const
+            {
+                assert(_dim_in != -1); // need to compute first!
+                return _dim_in;
+            }
+
+            /// return the number of dimensions of the output
+            int dim_out() const
+            {
+                assert(_dim_out != -1); // need to compute first!
+                return _dim_out;
+            }
+
+            const KernelFunction& kernel_function() const { return _kernel_function; }
+
+            KernelFunction& kernel_function() { return _kernel_function; }
+
+            const MeanFunction& mean_function() const { return _mean_function; }
+
+            MeanFunction& mean_function() { return _mean_function; }
+
+            /// return the maximum observation (only call this if the output of the model is of dimension 1)
+            Eigen::VectorXd max_observation() const
+            {
+                if (_dim_out > 1)
+                    std::cout << "WARNING max_observation with multi dimensional "
+                                 "observations doesn't make sense"
+                              << std::endl;
+                return tools::make_vector(observations_matrix().maxCoeff());
+            }
+
+            /// return the mean observation (only call this if the output of the model is of dimension 1)
+            Eigen::VectorXd mean_observation() const
+            {
+                assert(_dim_out > 0);
+                return _nb_samples > 0 ? _mean_observation
+                                       : Eigen::VectorXd::Zero(_dim_out);
+            }
+
+            /// return the number of samples used to compute the model
+            int nb_samples() const { return _nb_samples; }
+
+            /// recompute the model: conjugate gradients for alpha and Lanczos decomposition for the variance
+            /// (if update_full_kernel is false, the hyper-parameters of the kernel have not changed)
+            void recompute(bool update_obs_mean = true, bool update_full_kernel = true)
+            {
+                assert(_nb_samples > 0);
+
+                if (update_full_kernel || _spectrum.size() == 0)
+                    _compute_spectrum();
+
+                auto op = [this](const Eigen::MatrixXd& V, Eigen::MatrixXd& AV) { _product(V, AV); };
+
+                // the previous solution (completed with zeros) is the initial guess
+                int previous = (_alpha.cols() == _dim_out) ? std::min(int(_alpha.rows()), _nb_samples) : 0;
+                _alpha.conservativeResize(_nb_samples, _dim_out);
+                _alpha.bottomRows(_nb_samples - previous).setZero();
+                _cg_iterations = tools::conjugate_gradient(op, _residuals(), _alpha, Params::model_kiss_gp::cg_tolerance(), Params::model_kiss_gp::cg_max_iterations());
+                _grid_alpha = _grid_kernel_product(_interpolation_transpose_product(_alpha));
+
+                // LOVE: (W K_uu W^T + noise * I)^{-1} ~ Q * T^{-1} * Q^T, from the smooth vector W * K_uu * 1
+                Eigen::MatrixXd Q;
+                Eigen::VectorXd diag, sub_diag;
+                Eigen::VectorXd q0 = _interpolation_product(_grid_kernel_product(Eigen::MatrixXd::Ones(_grid_points(), 1)));
+                int k = tools::lanczos(op, q0, Params::model_kiss_gp::lanczos_iterations(), Q, diag, sub_diag);
+                Eigen::MatrixXd T = diag.asDiagonal();
+                T.diagonal(-1) = sub_diag;
+                T.diagonal(1) = sub_diag;
+                // T is positive definite in exact arithmetic, but the Lanczos vectors lose their orthogonality:
+                // an increasing jitter is added to its diagonal until the decomposition succeeds
+                Eigen::LLT<Eigen::MatrixXd> llt(T);
+                double scale = T.diagonal().cwiseAbs().maxCoeff();
+                for (double jitter = 1e-10 * scale; llt.info() != Eigen::Success && jitter < scale; jitter *= 10) {
+                    Eigen::MatrixXd Tj = T;
+                    Tj.diagonal().array() += jitter;
+                    llt.compute(Tj);
+                }
+                if (llt.info() != Eigen::Success) {
+                    // the variance is then the prior variance
+                    std::cerr << "[KISSGP]: the Lanczos decomposition failed (the variance is not updated)" << std::endl;
+                    _grid_var = Eigen::MatrixXd::Zero(_grid_points(), k);
+                    return;
+                }
+                // grid variance factor: K_uu * W^T * Q * L_T^{-T} (one row per grid point)
+                Eigen::MatrixXd R = _grid_kernel_product(_interpolation_transpose_product(Q)).transpose();
+                llt.matrixL().solveInPlace(R);
+                _grid_var = R.transpose();
+                assert(_grid_var.cols() == k);
+            }
+
+            /// return the list of samples
+            std::vector<Eigen::VectorXd> samples() const
+            {
+                std::vector<Eigen::VectorXd> samples(_nb_samples);
+                for (int i = 0; i < _nb_samples; i++)
+                    samples[i] = _samples.col(i);
+                return samples;
+            }
+
+            /// return the samples (in matrix form)
+            /// (DxN), where D is the dimension of the input and N the number of points
+            Eigen::MatrixXd::ConstColsBlockXpr samples_matrix() const
+            {
+                return _samples.leftCols(_nb_samples);
+            }
+
+            /// return the list of observations
+            std::vector<Eigen::VectorXd> observations() const
+            {
+                std::vector<Eigen::VectorXd> observations(_nb_samples);
+                for (int i = 0; i < _nb_samples; i++)
+                    observations[i] = _observations.row(i);
+                return observations;
+            }
+
+            /// return the observations (in matrix form)
+            /// (NxD), where N is the number of points and D is the dimension output
+            Eigen::MatrixXd::ConstRowsBlockXpr observations_matrix() const
+            {
+                return _observations.topRows(_nb_samples);
+            }
+
+        protected:
+            int _dim_in;
+            int _dim_out;
+
+            KernelFunction _kernel_function;
+            MeanFunction _mean_function;
+
+            // one sample per column (and one observation per row), with a spare capacity
+            Eigen::MatrixXd _samples;
+            Eigen::MatrixXd _observations;
+            int _nb_samples;
+            Eigen::VectorXd _mean_observation;
+
+            // grid: g points per dimension, at (i - 1) * h (i = 0, ..., g - 1), so that [0, 1] is covered
+            // by the points 1 to g - 2 (the cubic interpolation needs one more point on each side)
+            int _grid_size;
+            double _h;
+            // number of points per dimension of the circulant embedding of the grid
+            int _fft_length;
+            // index of the grid points in the circulant embedding
+            std::vector<int> _embedding_index;
+            // offsets of the 4^d grid points of the interpolation stencil (from its first corner)
+            std::vector<int> _stencil_offsets;
+            // DFT of the first column of the circulant embedding of K_uu (real: the kernel is even)
+            Eigen::ArrayXd _spectrum;
+            std::vector<Eigen::FFT<double>> _ffts;
+
+            // first corner of the stencil and 4 weights per dimension, for each sample
+            Eigen::VectorXi _interp_base;
+            Eigen::MatrixXd _interp_weights;
+
+            // alpha, K_uu * W^T * alpha and the variance factor (on the grid)
+            Eigen::MatrixXd _alpha;
+            Eigen::MatrixXd _grid_alpha;
+            Eigen::MatrixXd _grid_var;
+
+            int _cg_iterations;
+
+            void _set_dims(int dim_in, int dim_out)
+            {
+                if (_dim_in != dim_in) {
+                    _dim_in = dim_in;
+                    _kernel_function = KernelFunction(_dim_in); // the cost of building a functor should be relatively low
+                    _make_grid();
+                }
+                if (_dim_out != dim_out) {
+                    _dim_out = dim_out;
+                    _mean_function = MeanFunction(_dim_out); // the cost of building a functor should be relatively low
+                }
+            }
+
+            int _grid_points() const { return _embedding_index.size(); }
+
+            int _embedding_points() const { return _spectrum.size(); }
+
+            void _make_grid()
+            {
+                // the stencils have 4^d points and the grid g^d points (at least 5 per dimension)
+                assert(_dim_in >= 1 && _dim_in <= 4);
+
+                // the circulant embedding needs at least 2g - 1 points per dimension; its length has no
+                // prime factor larger than 5 so that the FFTs are fast
+                _grid_size = Params::model_kiss_gp::grid_size();
+                if (_grid_size <= 0) {
+                    _grid_size = std::min(128, int(std::pow(double(1 << 18), 1. / _dim_in) + 1e-6) / 2);
+                    while (_grid_size > 5 && std::pow(double(_fft_size(2 * _grid_size)), _dim_in) > double(1 << 18))
+                        _grid_size--;
+                }
+                _grid_size = std::max(_grid_size, 5);
+                _fft_length = _fft_size(2 * _grid_size);
+                _h = 1. / (_grid_size - 3);
+
+                int g = _grid_size, nb_points = 1;
+                for (int a = 0; a < _dim_in; ++a)
+                    nb_points *= g;
+                _embedding_index.resize(nb_points);
+                for (int i = 0; i < nb_points; ++i) {
+                    int index = 0;
+                    for (int a = 0, rest = i, stride = 1; a < _dim_in; ++a, rest /= g, stride *= _fft_length)
+                        index += (rest % g) * stride;
+                    _embedding_index[i] = index;
+                }
+
+                _stencil_offsets.resize(1 << (2 * _dim_in));
+                for (size_t c = 0; c < _stencil_offsets.size(); ++c) {
+                    _stencil_offsets[c] = 0;
+                    for (int a = 0, stride = 1; a < _dim_in; ++a, stride *= g)
+                        _stencil_offsets[c] += ((c >> (2 * a)) & 3) * stride;
+                }
+
+                _spectrum.resize(0);
+                _ffts.resize(64);
+            }
+
+            // smallest integer >= n without prime factor larger than 5
+            static int _fft_size(int n)
+            {
+                for (;; ++n) {
+                    int r = n;
+                    for (int p : {2, 3, 5})
+                        while (r % p == 0)
+                            r /= p;
+                    if (r == 1)
+                        return n;
+                }
+            }
+
+            // cubic convolution kernel of Keys (1981), with a = -1/2
+            static double _cubic(double s)
+            {
+                s = std::abs(s);
+                if (s <= 1)
+                    return (1.5 * s - 2.5) * s * s + 1;
+                if (s < 2)
+                    return ((-0.5 * s + 2.5) * s - 4) * s + 2;
+                return 0;
+            }
+
+            template <typename V, typename W>
+            void _interpolation(const V& x, int& base, W&& w) const
+            {
+                base = 0;
+                for (int a = 0, stride = 1; a < _dim_in; ++a, stride *= _grid_size) {
+                    double t = std::min(std::max(double(x(a)), 0.), 1.) / _h + 1;
+                    int i = std::min(int(std::floor(t)), _grid_size - 3);
+                    double f = t - i;
+                    w(4 * a) = _cubic(f + 1);
+                    w(4 * a + 1) = _cubic(f);
+                    w(4 * a + 2) = _cubic(1 - f);
+                    w(4 * a + 3) = _cubic(2 - f);
+                    base += (i - 1) * stride;
+                }
+            }
+
+            // call f(grid index, weight) for the 4^d grid points of the stencil
+            template <typename F>
+            void _for_stencil(int base, const double* w, const F& f) const
+            {
+                for (size_t c = 0; c < _stencil_offsets.size(); ++c) {
+                    double weight = 1;
+                    for (int a = 0; a < _dim_in; ++a)
+                        weight *= w[4 * a + ((c >> (2 * a)) & 3)];
+                    f(base + _stencil_offsets[c], weight);
+                }
+            }
+
+            // W * U (U: one row per grid point), in parallel over blocks of samples
+            Eigen::MatrixXd _interpolation_product(const Eigen::MatrixXd& U) const
+            {
+                Eigen::MatrixXd V = Eigen::MatrixXd::Zero(_nb_samples, U.cols());
+                int block_size = 256, nb_blocks = (_nb_samples + block_size - 1) / block_size;
+                tools::par::loop(0, nb_blocks, [&](size_t b) {
+                    int end = std::min(_nb_samples, int(b + 1) * block_size);
+                    for (int i = b * block_size; i < end; ++i)
+                        _for_stencil(_interp_base(i), _interp_weights.col(i).data(), [&](int j, double weight) { V.row(i) += weight * U.row(j); });
+                });
+                return V;
+            }
+
+            // W^T * V (V: one row per sample)
+            Eigen::MatrixXd _interpolation_transpose_product(const Eigen::MatrixXd& V) const
+            {
+                Eigen::MatrixXd U = Eigen::MatrixXd::Zero(_grid_points(), V.cols());
+                for (int i = 0; i < _nb_samples; ++i)
+                    _for_stencil(_interp_base(i), _interp_weights.col(i).data(), [&](int j, double weight) { U.row(j) += weight * V.row(i); });
+                return U;
+            }
+
+            // in-place DFT of the circulant embedding (L points per dimension), one dimension at a time;
+            // if padded, x is zero outside of the grid and only its values on the grid are needed, so that
+            // the lines that are still zero (forward) or that are not needed (inverse) are skipped.
+            // The lines are split in chunks, each with its own FFT object, so that the plans are reused.
+            void _fft(std::vector<std::complex<double>>& x, bool inverse, bool padded = true)
+            {
+                int L = _fft_length;
+                std::vector<int> stride(_dim_in, 1), extent(_dim_in);
+                for (int a = 1; a < _dim_in; ++a)
+                    stride[a] = stride[a - 1] * L;
+
+                for (int a = 0; a < _dim_in; ++a) {
+                    int nb_lines = 1;
+                    for (int b = 0; b < _dim_in; ++b) {
+                        bool restricted = padded && (inverse ? b < a : b > a);
+                        extent[b] = (b == a) ? 1 : (restricted ? _grid_size : L);
+                        nb_lines *= extent[b];
+                    }
+                    int nb_chunks = std::min(nb_lines, int(_ffts.size()));
+                    tools::par::loop(0, nb_chunks, [&](size_t c) {
+                        Eigen::FFT<double>& fft = _ffts[c];
+                        std::vector<std::complex<double>> in(L), out(L);
+                        for (int line = (c * nb_lines) / nb_chunks; line < int(((c + 1) * nb_lines) / nb_chunks); ++line) {
+                            int start = 0;
+                            for (int b = 0, rest = line; b < _dim_in; rest /= extent[b], ++b)
+                                start += (rest % extent[b]) * stride[b];
+                            for (int t = 0; t < L; ++t)
+                                in[t] = x[start + t * stride[a]];
+                            if (inverse)
+                                fft.inv(out.data(), in.data(), L);
+                            else
+                                fft.fwd(out.data(), in.data(), L);
+                            for (int t = 0; t < L; ++t)
+                                x[start + t * stride[a]] = out[t];
+                        }
+                    });
+                }
+            }
+
+            // kernel at all the lags of the circulant embedding (lag j for j <= L / 2, j - L otherwise)
+            void _compute_spectrum()
+            {
+                int L = _fft_length, nb_points = 1;
+                for (int a = 0; a < _dim_in; ++a)
+                    nb_points *= L;
+                _spectrum.resize(nb_points);
+
+                std::vector<std::complex<double>> c(nb_points);
+                Eigen::VectorXd zero = Eigen::VectorXd::Zero(_dim_in);
+                tools::par::loop(0, nb_points, [&](size_t e) {
+                    Eigen::VectorXd lag(_dim_in);
+                    for (int a = 0, rest = e; a < _dim_in; ++a, rest /= L) {
+                        int j = rest % L;
+                        lag(a) = ((2 * j <= L) ? j : j - L) * _h;
+                    }
+                    c[e] = _kernel_function(zero, lag);
+                });
+                _fft(c, false, false);
+                for (int e = 0; e < nb_points; ++e)
+                    _spectrum(e) = c[e].real();
+            }
+
+            // K_uu * U, with the FFT of the circulant embedding of each column
+            Eigen::MatrixXd _grid_kernel_product(const Eigen::MatrixXd& U)
+            {
+                Eigen::MatrixXd KU(U.rows(), U.cols());
+                std::vector<std::complex<double>> x(_embedding_points());
+                for (int j = 0; j < U.cols(); ++j) {
+                    std::fill(x.begin(), x.end(), std::complex<double>(0., 0.));
+                    for (int i = 0; i < _grid_points(); ++i)
+                        x[_embedding_index[i]] = U(i, j);
+                    _fft(x, false);
+                    for (int e = 0; e < _embedding_points(); ++e)
+                        x[e] *= _spectrum(e);
+                    _fft(x, true);
+                    for (int i = 0; i < _grid_points(); ++i)
+                        KU(i, j) = x[_embedding_index[i]].real();
+                }
+                return KU;
+            }
+
+            // (W * K_uu * W^T + noise * I) * V
+            void _product(const Eigen::MatrixXd& V, Eigen::MatrixXd& AV)
+            {
+                AV = _interpolation_product(_grid_kernel_product(_interpolation_transpose_product(V)));
+                AV += (_kernel_function.noise() + 1e-8) * V;
+            }
+
+            // observations - mean (one row per sample)
+            Eigen::MatrixXd _residuals() const
+            {
+                Eigen::MatrixXd r = observations_matrix();
+                if (mean::is_constant<MeanFunction>::value)
+                    r.rowwise() -= _mean_function(_samples.col(0), *this).transpose();
+                else
+                    for (int i = 0; i < _nb_samples; i++)
+                        r.row(i) -= _mean_function(_samples.col(i), *this).transpose();
+                return r;
+            }
+
+            Eigen::VectorXd _mu(const Eigen::VectorXd& v, int base, const Eigen::VectorXd& w) const
+            {
+                Eigen::VectorXd mu = _mean_function(v, *this);
+                _for_stencil(base, w.data(), [&](int j, double weight) { mu += weight * _grid_alpha.row(j).transpose(); });
+                return mu;
+            }
+
+            double _sigma(const Eigen::VectorXd& v, int base, const Eigen::VectorXd& w) const
+            {
+                Eigen::VectorXd z = Eigen::VectorXd::Zero(_grid_var.cols());
+                _for_stencil(base, w.data(), [&](int j, double weight) { z += weight * _grid_var.row(j).transpose(); });
+                double res = _kernel_function(v, v) - z.squaredNorm();
+                return (res <= std::numeric_limits<double>::epsilon()) ? 0 : res;
+            }
+        };
+    } // namespace model
+} // namespace limbo
+
+#endif
@@ -0,0 +1,601 @@
+//| Copyright Inria May 2015
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Jean-Baptiste Mouret (jean-baptiste.mouret@inria.fr)
+//|   - Antoine Cully (antoinecully@gmail.com)
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Federico Allocati (fede.allocati@gmail.com)
+//|   - Vaios Papaspyros (b.papaspyros@gmail.com)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is a computer library whose purpose is to optimize continuous,
+//| black-box functions. It mainly implements Gaussian processes and Bayesian
+//| optimization.
+//| Main repository: http://github.com/resibots/limbo
+//| Documentation: http://www.resibots.eu/limbo
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+
+#ifndef LIMBO_MODEL_LOCAL_GP_HPP
+#define LIMBO_MODEL_LOCAL_GP_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <limbo/kernel/squared_exp_ard.hpp>
+#include <limbo/mean/data.hpp>
+#include <limbo/model/gp.hpp>
+#include <limbo/model/gp/no_lf_opt.hpp>
+#include <limbo/tools/macros.hpp>
+#include <limbo/tools/math.hpp>
+#include <limbo/tools/parallel.hpp>
+
+namespace limbo {
+    namespace defaults {
+        struct model_local_gp {
+            /// maximum number of samples of an expert (a leaf is split in two when it has more)
+            BO_PARAM(int, leaf_size, 256);
+            /// number of experts (the nearest leaves) blended in a prediction
+            BO_PARAM(int, nb_experts, 4);
+        };
+    } // namespace defaults
+
+    namespace model {
+        namespace local_gp {
+            ///@ingroup model
+            /// generalized product of experts (Cao and Fleet, 2014): the precisions of the experts are
+            /// weighted by their (normalized) reduction of entropy beta_k = log(prior variance / variance) / 2,
+            /// so that a single expert is returned as is
+            struct GPoE {
+                static constexpr bool prior_correction() { return false; }
+            };
+
+            ///@ingroup model
+            /// robust Bayesian committee machine (Deisenroth and Ng, 2015): the weights beta_k are not
+            /// normalized, and the prior (mean_function() of the model, variance of the nearest expert) is
+            /// added (1 - sum_k beta_k) times, so that the prediction goes back to the prior far from the samples
+            struct RBCM {
+                static constexpr bool prior_correction() { return true; }
+            };
+        } // namespace local_gp
+
+        /**
+          @ingroup model
+          \rst
+          A mixture of local Gaussian processes: the input space is partitioned by a kd-tree whose leaves hold at most ``leaf_size`` samples, and each leaf has its own exact GP (an *expert*, of type ``GP<Params, KernelFunction, MeanFunction, HyperParamsOptimizer>``).
+
+          - training is :math:`O(nb^2)` (with :math:`b` = ``leaf_size``) instead of :math:`O(n^3)`, and the experts are fitted in parallel (``tools::par::loop``)
+          - add_sample() only updates the expert of the leaf of the sample (incremental Cholesky, :math:`O(b^2)`); a leaf that has more than ``leaf_size`` samples is split in two at the median of its widest dimension, and both halves inherit the hyper-parameters of the expert
+          - a prediction blends the ``nb_experts`` nearest leaves (the distance to a leaf is the distance to the bounding box of its samples), with ``local_gp::GPoE`` (the default) or ``local_gp::RBCM``
+          - optimize_hyperparams() optimizes the hyper-parameters of each expert on its own samples (in parallel), so that they can differ from one region to the other
+
+          kernel_function() and mean_function() are the prototypes given to the experts of compute(). The interface is the one of GP (compute(), add_sample(), query(), ...), so that it can be used by the Bayesian optimizers.
+
+          Parameters:
+            - ``int leaf_size`` (maximum number of samples of an expert)
+            - ``int nb_experts`` (number of experts blended in a prediction)
+          \endrst
+        */
+        template <typename Params, typename KernelFunction = kernel::SquaredExpARD<Params>, typename MeanFunction = mean::Data<Params>, typename HyperParamsOptimizer = gp::NoLFOpt<Params>, typename Blending = local_gp::GPoE>
+        class LocalGP {
+        public:
+            /// type of the experts
+            using GP_t = GP<Params, KernelFunction, MeanFunction, HyperParamsOptimizer>;
+
+            /// useful because the model might be created before knowing anything about the process
+            LocalGP() : _dim_in(-1), _dim_out(-1), _nb_samples(0), _log_lik(0) {}
+
+            /// useful because the model might be created before having samples
+            LocalGP(int dim_in, int dim_out)
+                : _dim_in(dim_in), _dim_out(dim_out), _kernel_function(dim_in), _mean_function(dim_out), _nb_samples(0), _log_lik(0) {}
+
+            /// Compute the model from samples and observations (build the tree and fit the experts). This call needs to be explicit!
+            void compute(const std::vector<Eigen::VectorXd>& samples,
+                const std::vector<Eigen::VectorXd>& observations, bool compute_kernel = true)
+            {
+                assert(samples.size() != 0);
+                assert(observations.size() != 0);
+                assert(samples.size() == observations.size());
+
+                _set_dims(samples[0].size(), observations[0].size());
+
+                _nb_samples = samples.size();
+                _samples.resize(_dim_in, _nb_samples);
+                _observations.resize(_nb_samples, _dim_out);
+                for (int i = 0; i < _nb_samples; ++i) {
+                    _samples.col(i) = samples[i];
+                    _observations.row(i) = observations[i];
+                }
+                _mean_observation = observations_matrix().colwise().mean();
+
+                // the tree is built first, then all the experts are fitted in parallel
+                _nodes.clear();
+                _experts.clear();
+                std::vector<std::vector<int>> leaves;
+                std::vector<int> indices(_nb_samples);
+                std::iota(indices.begin(), indices.end(), 0);
+                _build(indices, leaves);
+
+                _experts.resize(leaves.size(), _new_expert(_kernel_function, _mean_function));
+                if (compute_kernel)
+                    tools::par::loop(0, leaves.size(), [&](size_t e) {
+                        Eigen::MatrixXd X(leaves[e].size(), _dim_in), Y(leaves[e].size(), _dim_out);
+                        for (size_t i = 0; i < leaves[e].size(); ++i) {
+                            X.row(i) = _samples.col(leaves[e][i]).transpose();
+                            Y.row(i) = _observations.row(leaves[e][i]);
+                        }
+                        _experts[e].add_samples(X, Y);
+                    });
+            }
+
+            /// Do not forget to call this if you use hyper-parameters optimization!!
+            /// (the hyper-parameters of each expert are optimized on its own samples, in parallel)
+            void optimize_hyperparams()
+            {
+                tools::par::loop(0, _experts.size(), [&](size_t e) {
+                    if (_experts[e].nb_samples() > 0)
+                        _experts[e].optimize_hyperparams();
+                });
+            }
+
+            /// add a sample to the expert of its leaf (in O(b^2)), and split the leaf if it has more than leaf_size() samples
+            void add_sample(const Eigen::VectorXd& sample, const Eigen::VectorXd& observation)
+            {
+                if (_nb_samples == 0)
+                    _set_dims(sample.size(), observation.size());
+                else {
+                    assert(sample.size() == _dim_in);
+                    assert(observation.size() == _dim_out);
+                }
+
+                // amortized growth of the storage
+                if (_nb_samples == _samples.cols()) {
+                    _samples.conservativeResize(_dim_in, std::max(2 * _nb_samples, 1));
+                    _observations.conservativeResize(std::max(2 * _nb_samples, 1), _dim_out);
+                }
+                _samples.col(_nb_samples) = sample;
+                _observations.row(_nb_samples) = observation.transpose();
+                _nb_samples++;
+
+                // running mean of the observations
+                _mean_observation = (_nb_samples == 1) ? observation : Eigen::VectorXd(_mean_observation + (observation - _mean_observation) / _nb_samples);
+
+                if (_nodes.empty()) {
+                    _nodes.push_back(_leaf(sample, sample, 0));
+                    _experts.assign(1, _new_expert(_kernel_function, _mean_function));
+                }
+
+                // go down to the leaf, extending the bounding boxes
+                int node = 0;
+                while (true) {
+                    _nodes[node].lower = _nodes[node].lower.cwiseMin(sample);
+                    _nodes[node].upper = _nodes[node].upper.cwiseMax(sample);
+                    if (_nodes[node].expert >= 0)
+                        break;
+                    node = _nodes[node].children[sample(_nodes[node].dim) < _nodes[node].split ? 0 : 1];
+                }
+
+                GP_t& expert = _experts[_nodes[node].expert];
+                expert.add_sample(sample, observation);
+                if (expert.nb_samples() > leaf_size())
+                    _split(node);
+            }
+
+            /**
+             \rst
+             return :math:`\mu`, :math:`\sigma^2` (un-normalized), blended from the nearest experts. If there is no sample, return the value according to the mean function and the prior variance.
+             \endrst
+            */
+            std::tuple<Eigen::VectorXd, double> query(const Eigen::VectorXd& v) const
+            {
+                if (_nb_samples == 0)
+                    return std::make_tuple(_mean_function(v, *this), _kernel_function(v, v) + _kernel_function.noise());
+
+                std::vector<std::pair<double, int>> nearest;
+                _nearest_experts(v, 0, nearest);
+                if (nearest.empty()) // the experts have not been fitted (compute(..., false))
+                    return std::make_tuple(_mean_function(v, *this), _kernel_function(v, v) + _kernel_function.noise());
+
+                // the nearest expert is returned as is (a single expert, or v on one of its samples)
+                Eigen::VectorXd mu;
+                double sigma;
+                std::tie(mu, sigma) = _experts[nearest[0].second].query(v);
+                if (nearest.size() == 1)
+                    return std::make_tuple(mu, sigma);
+
+                // precision-weighted sum of the experts, with the weights beta_k
+                const GP_t& first = _experts[nearest[0].second];
+                double prior = first.kernel_function()(v, v) + first.kernel_function().noise();
+                Eigen::VectorXd weighted_mu = Eigen::VectorXd::Zero(_dim_out);
+                double precision = 0, sum_beta = 0;
+                std::vector<double> beta(nearest.size());
+                std::vector<std::tuple<Eigen::VectorXd, double>> predictions(nearest.size());
+                for (size_t k = 0; k < nearest.size(); ++k) {
+                    const GP_t& expert = _experts[nearest[k].second];
+                    predictions[k] = (k == 0) ? std::make_tuple(mu, sigma) : expert.query(v);
+                    double prior_k = expert.kernel_function()(v, v) + expert.kernel_function().noise();
+                    beta[k] = std::max(0.5 * std::log(prior_k / std::get<1>(predictions[k])), 0.);
+                    sum_beta += beta[k];
+                }
+                for (size_t k = 0; k < nearest.size(); ++k) {
+                    // (far from all the experts, they are equally weighted)
+                    double b = Blending::prior_correction() ? beta[k] : ((sum_beta > 0) ? beta[k] / sum_beta : 1. / nearest.size());
+                    precision += b / std::get<1>(predictions[k]);
+                    weighted_mu += b / std::get<1>(predictions[k]) * std::get<0>(predictions[k]);
+                }
+                if (Blending::prior_correction()) {
+                    precision += (1 - sum_beta) / prior;
+                    weighted_mu += (1 - sum_beta) / prior * _mean_function(v, *this);
+                }
+
+                return std::make_tuple(Eigen::VectorXd(weighted_mu / precision), 1. / precision);
+            }
+
+            /**
+             \rst
+             return :math:`\mu` (un-normalized). If there is no sample, return the value according to the mean function.
+             \endrst
+            */
+            Eigen::VectorXd mu(const Eigen::VectorXd& v) const
+            {
+                return std::get<0>(query(v));
+            }
+
+            /**
+             \rst
+             return :math:`\sigma^2` (un-normalized). If there is no sample, return the prior variance.
+             \endrst
+            */
+            double sigma(const Eigen::VectorXd& v) const
+            {
+                return std::get<1>(query(v));
+            }
+
+            /// return :math:`\mu` (MxD) and :math:`\sigma^2` (M) (un-normalized) for the M rows of ``X`` (in parallel over the points)
+            std::tuple<Eigen::MatrixXd, Eigen::VectorXd> query_batch(const Eigen::MatrixXd& X) const
+            {
+                Eigen::MatrixXd mu(X.rows(), _dim_out);
+                Eigen::VectorXd sigma(X.rows());
+                tools::par::loop(0, X.rows(), [&](size_t i) {
+                    Eigen::VectorXd m;
+                    std::tie(m, sigma(i)) = query(X.row(i).transpose());
+                    mu.row(i) = m.transpose();
+                });
+                return std::make_tuple(mu, sigma);
+            }
+
+            /// return :math:`\mu` (MxD, un-normalized) for the M rows of X
+            Eigen::MatrixXd mu_batch(const Eigen::MatrixXd& X) const
+            {
+                return std::get<0>(query_batch(X));
+            }
+
+            /// return :math:`\sigma^2` (M, un-normalized) for the M rows of X
+            Eigen::VectorXd sigma_batch(const Eigen::MatrixXd& X) const
+            {
+                return std::get<1>(query_batch(X));
+            }
+
+            /// return the maximum number of samples of an expert
+            int leaf_size() const { return Params::model_local_gp::leaf_size(); }
+
+            /// return the experts (one per leaf of the tree)
+            const std::vector<GP_t>& experts() const { return _experts; }
+
+            /// return the number of dimensions of the input
+            int dim_in() const
+            {
+                assert(_dim_in != -1); // need to compute first!
+                return _dim_in;
+            }
+
+            /// return the number of dimensions of the output
+            int dim_out() const
+            {
+                assert(_dim_out != -1); // need to compute first!
+                return _dim_out;
+            }
+
+            const KernelFunction& kernel_function() const { return _kernel_function; }
+
+            KernelFunction& kernel_function() { return _kernel_function; }
+
+            const MeanFunction& mean_function() const { return _mean_function; }
+
+            MeanFunction& mean_function() { return _mean_function; }
+
+            /// return the maximum observation (only call this if the output of the model is of dimension 1)
+            Eigen::VectorXd max_observation() const
+            {
+                if (_dim_out > 1)
+                    std::cout << "WARNING max_observation with multi dimensional "
+                                 "observations doesn't make sense"
+                              << std::endl;
+                return tools::make_vector(observations_matrix().maxCoeff());
+            }
+
+            /// return the mean observation (only call this if the output of the model is of dimension 1)
+            Eigen::VectorXd mean_observation() const
+            {
+                assert(_dim_out > 0);
+                return _nb_samples > 0 ? _mean_observation
+                                       : Eigen::VectorXd::Zero(_dim_out);
+            }
+
+            /// return the number of samples used to compute the model
+            int nb_samples() const { return _nb_samples; }
+
+            /// recompute all the experts (in parallel)
+            void recompute(bool update_obs_mean = true, bool update_full_kernel = true)
+            {
+                assert(_nb_samples > 0);
+                tools::par::loop(0, _experts.size(), [&](size_t e) {
+                    if (_experts[e].nb_samples() > 0)
+                        _experts[e].recompute(update_obs_mean, update_full_kernel);
+                });
+            }
+
+            /// compute and return the log likelihood (sum of the log likelihoods of the experts, which are independent)
+            double compute_log_lik()
+            {
+                _log_lik = 0;
+                for (auto& expert : _experts)
+                    if (expert.nb_samples() > 0)
+                        _log_lik += expert.compute_log_lik();
+                return _log_lik;
+            }
+
+            /// return the likelihood (do not compute it -- return last computed)
+            double get_log_lik() const { return _log_lik; }
+
+            /// set the log likelihood (e.g. computed from outside)
+            void set_log_lik(double log_lik) { _log_lik = log_lik; }
+
+            /// return the list of samples
+            std::vector<Eigen::VectorXd> samples() const
+            {
+                std::vector<Eigen::VectorXd> samples(_nb_samples);
+                for (int i = 0; i < _nb_samples; i++)
+                    samples[i] = _samples.col(i);
+                return samples;
+            }
+
+            /// return the samples (in matrix form)
+            /// (DxN), where D is the dimension of the input and N the number of points
+            Eigen::MatrixXd::ConstColsBlockXpr samples_matrix() const
+            {
+                return _samples.leftCols(_nb_samples);
+            }
+
+            /// return the list of observations
+            std::vector<Eigen::VectorXd> observations() const
+            {
+                std::vector<Eigen::VectorXd> observations(_nb_samples);
+                for (int i = 0; i < _nb_samples; i++)
+                    observations[i] = _observations.row(i);
+                return observations;
+            }
+
+            /// return the observations (in matrix form)
+            /// (NxD), where N is the number of points and D is the dimension output
+            Eigen::MatrixXd::ConstRowsBlockXpr observations_matrix() const
+            {
+                return _observations.topRows(_nb_samples);
+            }
+
+        protected:
+            // node of the kd-tree: inner nodes send x to children[x(dim) < split ? 0 : 1],
+            // leaves (expert >= 0) have an expert; lower and upper bound the samples below the node
+            struct Node {
+                int dim;
+                double split;
+                int children[2];
+                int expert;
+                Eigen::VectorXd lower, upper;
+            };
+
+            int _dim_in;
+            int _dim_out;
+
+            KernelFunction _kernel_function;
+            MeanFunction _mean_function;
+
+            // one sample per column (and one observation per row), with a spare capacity
+            Eigen::MatrixXd _samples;
+            Eigen::MatrixXd _observations;
+            int _nb_samples;
+            Eigen::VectorXd _mean_observation;
+
+            // the root is _nodes[0]
+            std::vector<Node> _nodes;
+            std::vector<GP_t> _experts;
+
+            double _log_lik;
+
+            void _set_dims(int dim_in, int dim_out)
+            {
+                if (_dim_in != dim_in) {
+                    _dim_in = dim_in;
+                    _kernel_function = KernelFunction(_dim_in); // the cost of building a functor should be relatively low
+                }
+                if (_dim_out != dim_out) {
+                    _dim_out = dim_out;
+                    _mean_function = MeanFunction(_dim_out); // the cost of building a functor should be relatively low
+                }
+            }
+
+            GP_t _new_expert(const KernelFunction& kernel_function, const MeanFunction& mean_function) const
+            {
+                GP_t expert(_dim_in, _dim_out);
+                expert.kernel_function() = kernel_function;
+                expert.mean_function() = mean_function;
+                return expert;
+            }
+
+            static Node _leaf(const Eigen::VectorXd& lower, const Eigen::VectorXd& upper, int expert)
+            {
+                Node node;
+                node.dim = -1;
+                node.split = 0;
+                node.children[0] = node.children[1] = -1;
+                node.expert = expert;
+                node.lower = lower;
+                node.upper = upper;
+                return node;
+            }
+
+            // split the columns of X (given by indices) at the median of their widest dimension:
+            // on return, the first half of indices goes to the first child
+            static void _median_split(const Eigen::MatrixXd& X, std::vector<int>& indices, int& dim, double& split)
+            {
+                Eigen::VectorXd lower = X.col(indices[0]), upper = lower;
+                for (int i : indices) {
+                    lower = lower.cwiseMin(X.col(i));
+                    upper = upper.cwiseMax(X.col(i));
+                }
+                (upper - lower).maxCoeff(&dim);
+                size_t half = indices.size() / 2;
+                std::nth_element(indices.begin(), indices.begin() + half, indices.end(), [&](int a, int b) { return X(dim, a) < X(dim, b); });
+                split = X(dim, indices[half]);
+            }
+
+            // build the sub-tree of the samples `indices` (recursively) and return its root;
+            // the samples of each new leaf are appended to `leaves`
+            int _build(std::vector<int>& indices, std::vector<std::vector<int>>& leaves)
+            {
+                Eigen::VectorXd lower = _samples.col(indices[0]), upper = lower;
+                for (int i : indices) {
+                    lower = lower.cwiseMin(_samples.col(i));
+                    upper = upper.cwiseMax(_samples.col(i));
+                }
+
+                int node = _nodes.size();
+                _nodes.push_back(_leaf(lower, upper, -1));
+                if (int(indices.size()) <= leaf_size()) {
+                    _nodes[node].expert = leaves.size();
+                    leaves.push_back(indices);
+                    return node;
+                }
+
+                int dim;
+                double split;
+                _median_split(_samples, indices, dim, split);
+                std::vector<int> left(indices.begin(), indices.begin() + indices.size() / 2), right(indices.begin() + indices.size() / 2, indices.end());
+                int l = _build(left, leaves);
+                int r = _build(right, leaves);
+                _nodes[node].dim = dim;
+                _nodes[node].split = split;
+                _nodes[node].children[0] = l;
+                _nodes[node].children[1] = r;
+                return node;
+            }
+
+            // split a leaf that has too many samples: its expert keeps the first half and a new expert gets the
+            // second half (both with the hyper-parameters of the expert of the leaf), fitted in parallel
+            void _split(int node)
+            {
+                int e = _nodes[node].expert;
+                Eigen::MatrixXd X = _experts[e].samples_matrix();
+                Eigen::MatrixXd Y = _experts[e].observations_matrix();
+
+                std::vector<int> indices(X.cols());
+                std::iota(indices.begin(), indices.end(), 0);
+                int dim;
+                double split;
+                _median_split(X, indices, dim, split);
+
+                std::vector<Eigen::MatrixXd> Xs(2), Ys(2);
+                for (int c = 0; c < 2; ++c) {
+                    size_t begin = (c == 0) ? 0 : indices.size() / 2, end = (c == 0) ? indices.size() / 2 : indices.size();
+                    Xs[c].resize(end - begin, _dim_in);
+                    Ys[c].resize(end - begin, _dim_out);
+                    for (size_t i = begin; i < end; ++i) {
+                        Xs[c].row(i - begin) = X.col(indices[i]).transpose();
+                        Ys[c].row(i - begin) = Y.row(indices[i]);
+                    }
+                    int child = _nodes.size();
+                    _nodes.push_back(_leaf(Xs[c].colwise().minCoeff().transpose(), Xs[c].colwise().maxCoeff().transpose(), (c == 0) ? e : int(_experts.size())));
+                    _nodes[node].children[c] = child;
+                }
+                _nodes[node].dim = dim;
+                _nodes[node].split = split;
+                _nodes[node].expert = -1;
+
+                _experts.push_back(_new_expert(_experts[e].kernel_function(), _experts[e].mean_function()));
+                _experts[e] = _new_expert(_experts[e].kernel_function(), _experts[e].mean_function());
+                int experts[2] = {e, int(_experts.size()) - 1};
+                tools::par::loop(0, 2, [&](size_t c) {
+                    _experts[experts[c]].add_samples(Xs[c], Ys[c]);
+                });
+            }
+
+            // squared distance between v and the bounding box of a node
+            double _box_sq_dist(const Eigen::VectorXd& v, const Node& node) const
+            {
+                return ((node.lower - v).cwiseMax(0.) + (v - node.upper).cwiseMax(0.)).squaredNorm();
+            }
+
+            // the nb_experts nearest leaves (squared distance, expert), sorted by distance (branch and bound)
+            void _nearest_experts(const Eigen::VectorXd& v, int node, std::vector<std::pair<double, int>>& nearest) const
+            {
+                const Node& n = _nodes[node];
+                double d = _box_sq_dist(v, n);
+                int k = Params::model_local_gp::nb_experts();
+                if (int(nearest.size()) == k && d >= nearest.back().first)
+                    return;
+
+                if (n.expert >= 0) {
+                    if (_experts[n.expert].nb_samples() == 0)
+                        return;
+                    nearest.insert(std::upper_bound(nearest.begin(), nearest.end(), std::make_pair(d, n.expert)), std::make_pair(d, n.expert));
+                    if (int(nearest.size()) > k)
+                        nearest.pop_back();
+                    return;
+                }
+
+                int first = (v(n.dim) < n.split) ? 0 : 1;
+                _nearest_experts(v, n.children[first], nearest);
+                _nearest_experts(v, n.children[1 - first], nearest);
+            }
+        };
+    } // namespace model
+} // namespace limbo
+
+#endif
@@ -46,7 +46,10 @@
 #ifndef LIMBO_MODEL_MULTI_GP_HPP
 #define LIMBO_MODEL_MULTI_GP_HPP
 
+#include <algorithm>
+
 #include <limbo/mean/null_function.hpp>
+#include <limbo/model/multi_gp/sharing.hpp>
 
 namespace limbo {
     namespace model {
@@ -57,17 +60,20 @@ namespace limbo {
         /// - a kernel function (the same type for all GPs, but can have different parameters)
         /// - a mean function (the same type and parameters for all GPs)
         /// - [optional] an optimizer for the hyper-parameters
-        template <typename Params, template <typename, typename, typename, typename> class GPClass, typename KernelFunction, typename MeanFunction, class HyperParamsOptimizer = limbo::model::gp::NoLFOpt<Params>>
+        /// - [optional] a sharing policy (see multi_gp::Independent, multi_gp::SharedIfIdentical, multi_gp::Shared):
+        ///   when the outputs share a GP, the kernel matrix is factorized once for all the outputs, and a query
+        ///   computes a single kernel vector and a single triangular solve
+        template <typename Params, template <typename...> class GPClass, typename KernelFunction, typename MeanFunction, class HyperParamsOptimizer = limbo::model::gp::NoLFOpt<Params>, class Sharing = multi_gp::Independent>
         class MultiGP {
         public:
             using GP_t = GPClass<Params, KernelFunction, limbo::mean::NullFunction<Params>, limbo::model::gp::NoLFOpt<Params>>;
 
             /// useful because the model might be created before knowing anything about the process
-            MultiGP() : _dim_in(-1), _dim_out(-1) {}
+            MultiGP() : _dim_in(-1), _dim_out(-1), _sharing(false) {}
 
             /// useful because the model might be created before having samples
             MultiGP(int dim_in, int dim_out)
-                : _dim_in(dim_in), _dim_out(dim_out), _mean_function(dim_out)
+                : _dim_in(dim_in), _dim_out(dim_out), _mean_function(dim_out), _sharing(false)
             {
                 // initialize dim_in models with 1 output
                 _gp_models.resize(_dim_out);
@@ -112,6 +118,20 @@ namespace limbo {
                     _mean_observation.array() += _observations[j].array();
                 _mean_observation.array() /= static_cast<double>(_observations.size());
 
+                _sharing = Sharing::share() && (Sharing::force() || _identical_kernels());
+                if (_sharing) {
+                    // a single GP with all the outputs; the GPs of the outputs only keep their kernel
+                    std::vector<Eigen::VectorXd> shared_obs(observations.size());
+                    for (size_t j = 0; j < observations.size(); j++)
+                        shared_obs[j] = observations[j] - _mean_function(samples[j], *this);
+                    _shared_gp = _kernel_gp(0, _dim_out);
+                    _shared_gp.compute(samples, shared_obs, compute_kernel);
+                    for (int i = 0; i < _dim_out; i++)
+                        _gp_models[i] = _kernel_gp(i, 1);
+                    return;
+                }
+                _shared_gp = GP_t();
+
                 for (size_t j = 0; j < observations.size(); j++) {
                     Eigen::VectorXd mean_vector = _mean_function(samples[j], *this);
                     assert(mean_vector.size() == _dim_out);
@@ -129,7 +149,19 @@ namespace limbo {
             /// Do not forget to call this if you use hyper-parameters optimization!!
             void optimize_hyperparams()
             {
+                if (!_sharing) {
+                    _hp_optimize(*this);
+                    return;
+                }
+                // the optimizer works on the GPs of the outputs: they get their data back,
+                // then compute() checks whether the outputs can still share a GP
+                std::vector<Eigen::VectorXd> samples = _shared_gp.samples();
+                limbo::tools::par::loop(0, _dim_out, [&](size_t i) {
+                    _gp_models[i] = _output_gp(i, false);
+                });
+                _sharing = false;
                 _hp_optimize(*this);
+                compute(samples, _observations);
             }
 
             const MeanFunction& mean_function() const { return _mean_function; }
@@ -158,6 +190,11 @@ namespace limbo {
                     assert(observation.size() == _dim_out);
                 }
 
+                if (_observations.empty()) {
+                    _sharing = Sharing::share() && (Sharing::force() || _identical_kernels());
+                    _shared_gp = _sharing ? _kernel_gp(0, _dim_out) : GP_t();
+                }
+
                 _observations.push_back(observation);
 
                 // recompute mean observation
@@ -169,6 +206,11 @@ namespace limbo {
                 Eigen::VectorXd mean_vector = _mean_function(sample, *this);
                 assert(mean_vector.size() == _dim_out);
 
+                if (_sharing) {
+                    _shared_gp.add_sample(sample, observation - mean_vector);
+                    return;
+                }
+
                 limbo::tools::par::loop(0, _dim_out, [&](size_t i) {
                     _gp_models[i].add_sample(sample, limbo::tools::make_vector(observation[i] - mean_vector[i]));
                 });
@@ -176,24 +218,16 @@ namespace limbo {
 
             /**
              \\rst
-             return :math:`\mu`, :math:`\sigma^2` (un-normalized; this will return a vector --- one for each GP). Using this method instead of separate calls to mu() and sigma() is more efficient because some computations are shared between mu() and sigma().
+             return :math:`\mu`, :math:`\sigma^2` (un-normalized; this will return a vector --- one for each GP). Using this method instead of separate calls to mu() and sigma() is more efficient because some computations are shared between mu() and sigma(). When the outputs share a GP (see the Sharing policy), the kernel vector and the triangular solve are computed once for all the outputs.
+
+             The outputs are predicted one after the other: a parallel loop for a single point would only create tiny tasks, nested in the parallel loops of the callers (e.g. the optimizers of the acquisition function). Use query_batch() to predict many points at once.
              \\endrst
             */
             std::tuple<Eigen::VectorXd, Eigen::VectorXd> query(const Eigen::VectorXd& v) const
             {
                 Eigen::VectorXd mu(_dim_out);
                 Eigen::VectorXd sigma(_dim_out);
-
-                // query the mean function
-                Eigen::VectorXd mean_vector = _mean_function(v, *this);
-
-                // parallel query of the GPs
-                limbo::tools::par::loop(0, _dim_out, [&](size_t i) {
-                    Eigen::VectorXd tmp;
-                    std::tie(tmp, sigma(i)) = _gp_models[i].query(v);
-                    mu(i) = tmp(0) + mean_vector(i);
-                });
-
+                _query(v, mu, sigma);
                 return std::make_tuple(mu, sigma);
             }
 
@@ -204,12 +238,18 @@ namespace limbo {
             */
             Eigen::VectorXd mu(const Eigen::VectorXd& v) const
             {
-                Eigen::VectorXd mu(_dim_out);
-                Eigen::VectorXd mean_vector = _mean_function(v, *this);
+                Eigen::VectorXd mu = _mean_function(v, *this);
 
-                limbo::tools::par::loop(0, _dim_out, [&](size_t i) {
-                    mu(i) = _gp_models[i].mu(v)[0] + mean_vector(i);
-                });
+                if (_sharing) {
+                    mu += _shared_gp.mu(v);
+                    return mu;
+                }
+
+                Eigen::VectorXd m(1);
+                for (int i = 0; i < _dim_out; i++) {
+                    _gp_models[i].mu(v, m);
+                    mu(i) += m(0);
+                }
 
                 return mu;
             }
@@ -221,10 +261,89 @@ namespace limbo {
             */
             Eigen::VectorXd sigma(const Eigen::VectorXd& v) const
             {
-                Eigen::VectorXd sigma(_dim_out);
+                if (_sharing)
+                    return Eigen::VectorXd::Constant(_dim_out, _shared_gp.sigma(v));
 
-                limbo::tools::par::loop(0, _dim_out, [&](size_t i) {
+                Eigen::VectorXd sigma(_dim_out);
+                for (int i = 0; i < _dim_out; i++)
                     sigma(i) = _gp_models[i].sigma(v);
+
+                return sigma;
+            }
+
+            /**
+             \\rst
+             return :math:`\mu`, :math:`\sigma^2` (un-normalized) for a batch of points (one point per row of ``X``). Both are returned as (MxD) matrices (M points, D output dimensions). Each GP uses its batched query, which is much faster than calling query() for each point; the parallel loop is over the outputs and the blocks of points.
+             \\endrst
+            */
+            std::tuple<Eigen::MatrixXd, Eigen::MatrixXd> query_batch(const Eigen::MatrixXd& X) const
+            {
+                Eigen::MatrixXd mu = _mean_batch(X);
+                Eigen::MatrixXd sigma(X.rows(), _dim_out);
+
+                if (_sharing) {
+                    _batch_loop(X.rows(), 1, [&](int, int begin, int rows) {
+                        Eigen::MatrixXd tmp_mu;
+                        Eigen::VectorXd tmp_sigma;
+                        std::tie(tmp_mu, tmp_sigma) = _shared_gp.query_batch(X.middleRows(begin, rows));
+                        mu.middleRows(begin, rows) += tmp_mu;
+                        sigma.middleRows(begin, rows) = tmp_sigma.replicate(1, _dim_out);
+                    });
+                    return std::make_tuple(mu, sigma);
+                }
+
+                _batch_loop(X.rows(), _dim_out, [&](int i, int begin, int rows) {
+                    Eigen::MatrixXd tmp_mu;
+                    Eigen::VectorXd tmp_sigma;
+                    std::tie(tmp_mu, tmp_sigma) = _gp_models[i].query_batch(X.middleRows(begin, rows));
+                    mu.col(i).segment(begin, rows) += tmp_mu.col(0);
+                    sigma.col(i).segment(begin, rows) = tmp_sigma;
+                });
+
+                return std::make_tuple(mu, sigma);
+            }
+
+            /**
+             \\rst
+             return :math:`\mu` (un-normalized) for a batch of points (one point per row of ``X``) as a (MxD) matrix.
+             \\endrst
+            */
+            Eigen::MatrixXd mu_batch(const Eigen::MatrixXd& X) const
+            {
+                Eigen::MatrixXd mu = _mean_batch(X);
+
+                if (_sharing) {
+                    _batch_loop(X.rows(), 1, [&](int, int begin, int rows) {
+                        mu.middleRows(begin, rows) += _shared_gp.mu_batch(X.middleRows(begin, rows));
+                    });
+                    return mu;
+                }
+
+                _batch_loop(X.rows(), _dim_out, [&](int i, int begin, int rows) {
+                    mu.col(i).segment(begin, rows) += _gp_models[i].mu_batch(X.middleRows(begin, rows)).col(0);
+                });
+
+                return mu;
+            }
+
+            /**
+             \\rst
+             return :math:`\sigma^2` (un-normalized) for a batch of points (one point per row of ``X``) as a (MxD) matrix; one column for each GP.
+             \\endrst
+            */
+            Eigen::MatrixXd sigma_batch(const Eigen::MatrixXd& X) const
+            {
+                Eigen::MatrixXd sigma(X.rows(), _dim_out);
+
+                if (_sharing) {
+                    _batch_loop(X.rows(), 1, [&](int, int begin, int rows) {
+                        sigma.middleRows(begin, rows) = _shared_gp.sigma_batch(X.middleRows(begin, rows)).replicate(1, _dim_out);
+                    });
+                    return sigma;
+                }
+
+                _batch_loop(X.rows(), _dim_out, [&](int i, int begin, int rows) {
+                    sigma.col(i).segment(begin, rows) = _gp_models[i].sigma_batch(X.middleRows(begin, rows));
                 });
 
                 return sigma;
@@ -258,7 +377,14 @@ namespace limbo {
                     return;
 
                 if (update_obs_mean) // if the mean is updated, we need to fully re-compute
-                    return compute(_gp_models[0].samples(), _observations, update_full_kernel);
+                    return compute(samples(), _observations, update_full_kernel);
+                else if (_sharing) {
+                    // the hyper-parameters are read from the GPs of the outputs
+                    if (!Sharing::force() && !_identical_kernels())
+                        return compute(samples(), _observations, update_full_kernel);
+                    _shared_gp.kernel_function() = _gp_models[0].kernel_function();
+                    _shared_gp.recompute(false, update_full_kernel);
+                }
                 else
                     limbo::tools::par::loop(0, _dim_out, [&](size_t i) {
                         _gp_models[i].recompute(false, update_full_kernel);
@@ -266,10 +392,10 @@ namespace limbo {
             }
 
             /// return the list of samples
-            const std::vector<Eigen::VectorXd>& samples() const
+            std::vector<Eigen::VectorXd> samples() const
             {
                 assert(_gp_models.size());
-                return _gp_models[0].samples();
+                return _sharing ? _shared_gp.samples() : _gp_models[0].samples();
             }
 
             /// return the list of observations
@@ -299,7 +425,11 @@ namespace limbo {
                                                 : Eigen::VectorXd::Zero(_dim_out);
             }
 
+            /// true if the outputs currently share a single GP (see the Sharing policy)
+            bool shared() const { return _sharing; }
+
             /// return the list of GPs
+            /// (when the outputs share a GP, the GPs of the outputs only hold the kernel of each output)
             std::vector<GP_t> gp_models() const
             {
                 return _gp_models;
@@ -333,8 +463,12 @@ namespace limbo {
                     archive.save(_mean_function.h_params(), "mean_params");
                 }
 
+                // (when the outputs share a GP, the GP of each output is rebuilt, so that the archive does not depend on the sharing policy)
                 for (int i = 0; i < _dim_out; i++) {
-                    _gp_models[i].template save<A>(archive.directory() + "/gp_" + std::to_string(i));
+                    if (_sharing)
+                        _output_gp(i, true).template save<A>(archive.directory() + "/gp_" + std::to_string(i));
+                    else
+                        _gp_models[i].template save<A>(archive.directory() + "/gp_" + std::to_string(i));
                 }
             }
 
@@ -379,6 +513,7 @@ namespace limbo {
                 }
 
                 _gp_models.resize(_dim_out);
+                _sharing = false;
 
                 for (int i = 0; i < _dim_out; i++) {
                     // do not recompute the individual GPs on their own
@@ -396,6 +531,81 @@ namespace limbo {
             MeanFunction _mean_function;
             std::vector<Eigen::VectorXd> _observations;
             Eigen::VectorXd _mean_observation;
+            // when _sharing is true, _shared_gp has all the outputs (minus the mean function)
+            bool _sharing;
+            GP_t _shared_gp;
+
+            bool _identical_kernels() const
+            {
+                for (int i = 1; i < _dim_out; i++) {
+                    const KernelFunction& k = _gp_models[i].kernel_function();
+                    if (k.h_params() != _gp_models[0].kernel_function().h_params() || k.noise() != _gp_models[0].kernel_function().noise())
+                        return false;
+                }
+                return true;
+            }
+
+            // a GP without data, with the kernel of output i
+            GP_t _kernel_gp(int i, int dim_out) const
+            {
+                GP_t gp(_dim_in, dim_out);
+                gp.kernel_function() = _gp_models[i].kernel_function();
+                return gp;
+            }
+
+            // the GP of output i, built from the data of the shared GP
+            GP_t _output_gp(int i, bool compute_kernel) const
+            {
+                std::vector<Eigen::VectorXd> obs(_observations.size());
+                for (size_t j = 0; j < obs.size(); j++)
+                    obs[j] = limbo::tools::make_vector(_shared_gp.observations_matrix()(j, i));
+                GP_t gp = _kernel_gp(i, 1);
+                gp.compute(_shared_gp.samples(), obs, compute_kernel);
+                return gp;
+            }
+
+            // calls f(model, first row, number of rows) in parallel, for each of the nb_models GPs and
+            // each block of (at most) 128 points: each task is a multi-RHS solve, large enough to be worth a task
+            template <typename F>
+            void _batch_loop(int nb_points, int nb_models, const F& f) const
+            {
+                const int block_size = 128;
+                int nb_blocks = (nb_points + block_size - 1) / block_size;
+                limbo::tools::par::loop(0, nb_models * nb_blocks, [&](size_t t) {
+                    int begin = (t % nb_blocks) * block_size;
+                    f(t / nb_blocks, begin, std::min(block_size, nb_points - begin));
+                });
+            }
+
+            // mu and sigma must have dim_out() rows
+            void _query(const Eigen::VectorXd& v, Eigen::Ref<Eigen::VectorXd> mu, Eigen::Ref<Eigen::VectorXd> sigma) const
+            {
+                // query the mean function
+                mu = _mean_function(v, *this);
+
+                if (_sharing) {
+                    Eigen::VectorXd m(_dim_out);
+                    double s;
+                    _shared_gp.query(v, m, s);
+                    mu += m;
+                    sigma.setConstant(s);
+                    return;
+                }
+
+                Eigen::VectorXd m(1);
+                for (int i = 0; i < _dim_out; i++) {
+                    _gp_models[i].query(v, m, sigma(i));
+                    mu(i) += m(0);
+                }
+            }
+
+            Eigen::MatrixXd _mean_batch(const Eigen::MatrixXd& X) const
+            {
+                Eigen::MatrixXd mu(X.rows(), _dim_out);
+                for (int i = 0; i < X.rows(); i++)
+                    mu.row(i) = _mean_function(X.row(i).transpose(), *this);
+                return mu;
+            }
         };
     } // namespace model
 } // namespace limbo
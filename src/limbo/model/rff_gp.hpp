@@ -0,0 +1,621 @@
+//| Copyright Inria May 2015
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Jean-Baptiste Mouret (jean-baptiste.mouret@inria.fr)
+//|   - Antoine Cully (antoinecully@gmail.com)
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Federico Allocati (fede.allocati@gmail.com)
+//|   - Vaios Papaspyros (b.papaspyros@gmail.com)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is a computer library whose purpose is to optimize continuous,
+//| black-box functions. It mainly implements Gaussian processes and Bayesian
+//| optimization.
+//| Main repository: http://github.com/resibots/limbo
+//| Documentation: http://www.resibots.eu/limbo
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef LIMBO_MODEL_RFF_GP_HPP
+#define LIMBO_MODEL_RFF_GP_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+#include <Eigen/Cholesky>
+#include <Eigen/Core>
+
+#include <limbo/kernel/squared_exp_ard.hpp>
+#include <limbo/mean/data.hpp>
+#include <limbo/model/gp/no_lf_opt.hpp>
+#include <limbo/tools/macros.hpp>
+#include <limbo/tools/random_generator.hpp>
+
+namespace limbo {
+    namespace defaults {
+        struct model_rff_gp {
+            /// @ingroup model_defaults
+            /// number of random features (it should be even: half of them are cosines, half are sines)
+            BO_PARAM(int, features, 256);
+            /// seed of the random frequencies (-1: random seed)
+            BO_PARAM(int, seed, -1);
+        };
+    } // namespace defaults
+
+    namespace model {
+        /**
+          @ingroup model
+          \rst
+          A Gaussian process approximated with random Fourier features (Rahimi and Recht, 2007): a stationary kernel is replaced by the inner product of m features :math:`\phi(x) = \sqrt{\sigma^2 / h}\,[\cos(\Omega^T x); \sin(\Omega^T x)]`, where the :math:`h = m / 2` columns of :math:`\Omega` are sampled from the spectral density of the kernel (given by ``spectral_frequencies()``, available for all the kernels of ``limbo/kernel/``), and a Bayesian linear regression is done in the feature space:
+
+          - training is :math:`O(nm^2)` (the samples are processed by blocks, so that the :math:`n \times m` feature matrix is never stored), adding a sample is :math:`O(m^2)` (rank-1 update of the Cholesky factor of :math:`\Phi^T\Phi + \sigma_n^2 I`)
+          - :math:`\mu` is :math:`O(m)` and :math:`\sigma^2` is :math:`O(m^2)`, whatever the number of samples
+          - functions can be sampled exactly (in the feature space) with sample_weights() and sample_value(), e.g. for Thompson sampling
+
+          The interface is the one of GP (compute(), add_sample(), query(), optimize_hyperparams(), ...), so that it can be used by the Bayesian optimizers. The hyper-parameters of the kernel can be optimized with gp::KernelLFOpt: the standard normal draws that define the frequencies are kept fixed, so that the likelihood is a smooth function of the hyper-parameters.
+
+          Parameters:
+            - ``int features`` (number of random features)
+            - ``int seed`` (seed of the frequencies, -1 for a random seed)
+          \endrst
+        */
+        template <typename Params, typename KernelFunction = kernel::SquaredExpARD<Params>, typename MeanFunction = mean::Data<Params>, typename HyperParamsOptimizer = gp::NoLFOpt<Params>>
+        class RFFGP {
+        public:
+            /// useful because the model might be created before knowing anything about the process
+            RFFGP() : _dim_in(-1), _dim_out(-1), _nb_samples(0), _log_lik(0) {}
+
+            /// useful because the model might be created before having samples
+            RFFGP(int dim_in, int dim_out)
+                : _dim_in(dim_in), _dim_out(dim_out), _kernel_function(dim_in), _mean_function(dim_out), _nb_samples(0), _log_lik(0)
+            {
+                _draw_frequencies();
+            }
+
+            /// Compute the model from samples and observations. This call needs to be explicit!
+            void compute(const std::vector<Eigen::VectorXd>& samples,
+                const std::vector<Eigen::VectorXd>& observations, bool compute_kernel = true)
+            {
+                assert(samples.size() != 0);
+                assert(observations.size() != 0);
+                assert(samples.size() == observations.size());
+
+                _set_dims(samples[0].size(), observations[0].size());
+
+                _nb_samples = samples.size();
+                _samples.resize(_dim_in, _nb_samples);
+                _observations.resize(_nb_samples, _dim_out);
+                for (int i = 0; i < _nb_samples; ++i) {
+                    _samples.col(i) = samples[i];
+                    _observations.row(i) = observations[i];
+                }
+                _mean_observation = observations_matrix().colwise().mean();
+
+                if (compute_kernel)
+                    recompute();
+            }
+
+            /// Do not forget to call this if you use hyper-parameters optimization!!
+            void optimize_hyperparams()
+            {
+                _hp_optimize(*this);
+            }
+
+            /// add a sample and update the model with a rank-1 update of the Cholesky factor, in O(m^2)
+            void add_sample(const Eigen::VectorXd& sample, const Eigen::VectorXd& observation)
+            {
+                if (_nb_samples == 0)
+                    _set_dims(sample.size(), observation.size());
+                else {
+                    assert(sample.size() == _dim_in);
+                    assert(observation.size() == _dim_out);
+                }
+
+                // amortized growth of the storage
+                if (_nb_samples == _samples.cols()) {
+                    _samples.conservativeResize(_dim_in, std::max(2 * _nb_samples, 1));
+                    _observations.conservativeResize(std::max(2 * _nb_samples, 1), _dim_out);
+                }
+                _samples.col(_nb_samples) = sample;
+                _observations.row(_nb_samples) = observation.transpose();
+                _nb_samples++;
+
+                // running mean of the observations
+                _mean_observation = (_nb_samples == 1) ? observation : Eigen::VectorXd(_mean_observation + (observation - _mean_observation) / _nb_samples);
+
+                if (_nb_samples == 1 || _phi_obs.rows() != nb_features()) {
+                    recompute();
+                    return;
+                }
+
+                Eigen::VectorXd phi = features(sample);
+                _llt.rankUpdate(phi);
+                _phi_obs.noalias() += phi * observation.transpose();
+                _phi_ones += phi;
+                if (!mean::is_constant<MeanFunction>::value)
+                    _phi_mean.noalias() += phi * _mean_function(sample, *this).transpose();
+                _compute_weights();
+            }
+
+            /**
+             \\rst
+             return :math:`\mu`, :math:`\sigma^2` (un-normalized). If there is no sample, return the value according to the mean function and the prior variance.
+             \\endrst
+            */
+            std::tuple<Eigen::VectorXd, double> query(const Eigen::VectorXd& v) const
+            {
+                if (_nb_samples == 0)
+                    return std::make_tuple(_mean_function(v, *this), _kernel_function(v, v) + _kernel_function.noise());
+
+                Eigen::VectorXd phi = features(v);
+                return std::make_tuple(_mu(v, phi), _sigma(phi) + _kernel_function.noise());
+            }
+
+            /**
+             \\rst
+             return :math:`\mu` (un-normalized). If there is no sample, return the value according to the mean function.
+             \\endrst
+            */
+            Eigen::VectorXd mu(const Eigen::VectorXd& v) const
+            {
+                if (_nb_samples == 0)
+                    return _mean_function(v, *this);
+                return _mu(v, features(v));
+            }
+
+            /**
+             \\rst
+             return :math:`\sigma^2` (un-normalized). If there is no sample, return the prior variance.
+             \\endrst
+            */
+            double sigma(const Eigen::VectorXd& v) const
+            {
+                if (_nb_samples == 0)
+                    return _kernel_function(v, v) + _kernel_function.noise();
+                return _sigma(features(v)) + _kernel_function.noise();
+            }
+
+            /// return the m random features of v
+            Eigen::VectorXd features(const Eigen::VectorXd& v) const
+            {
+                Eigen::MatrixXd phi;
+                _features_block(_omega, _scale, v, phi);
+                return phi.transpose();
+            }
+
+            /// return the number of random features
+            int nb_features() const { return 2 * (Params::model_rff_gp::features() / 2); }
+
+            /// return the (m x D) mean of the weights of the features (D: output dimension)
+            const Eigen::MatrixXd& weights() const { return _weights; }
+
+            /**
+             \\rst
+             return a sample of the (m x D) weights of the features from their posterior: together with sample_value(), it defines a function sampled from the model, which can be evaluated anywhere in :math:`O(m)` (e.g. for Thompson sampling). ``rng.rand()`` should return samples of :math:`\mathcal{N}(0, 1)` (e.g. a ``tools::rgen_gauss_t(0, 1)``).
+             \\endrst
+            */
+            template <typename Rng>
+            Eigen::MatrixXd sample_weights(Rng& rng) const
+            {
+                Eigen::MatrixXd Z(nb_features(), _dim_out);
+                for (int j = 0; j < Z.cols(); j++)
+                    for (int i = 0; i < Z.rows(); i++)
+                        Z(i, j) = rng.rand();
+
+                if (_nb_samples == 0)
+                    return Z;
+
+                // the covariance of the weights is noise * (Phi^T * Phi + noise * I)^{-1}
+                _llt.matrixU().solveInPlace(Z);
+                return _weights + std::sqrt(_noise()) * Z;
+            }
+
+            /// return the value at v (un-normalized) of the function defined by the weights (see sample_weights())
+            Eigen::VectorXd sample_value(const Eigen::VectorXd& v, const Eigen::MatrixXd& weights) const
+            {
+                return _mu(v, features(v), weights);
+            }
+
+            /// return the number of dimensions of the input
+            int dim_in() const
+            {
+                assert(_dim_in != -1); // need to compute first!
+                return _dim_in;
+            }
+
+            /// return the number of dimensions of the output
+            int dim_out() const
+            {
+                assert(_dim_out != -1); // need to compute first!
+                return _dim_out;
+            }
+
+            const KernelFunction& kernel_function() const { return _kernel_function; }
+
+            KernelFunction& kernel_function() { return _kernel_function; }
+
+            const MeanFunction& mean_function() const { return _mean_function; }
+
+            MeanFunction& mean_function() { return _mean_function; }
+
+            /// return the maximum observation (only call this if the output of the model is of dimension 1)
+            Eigen::VectorXd max_observation() const
+            {
+                if (_dim_out > 1)
+                    std::cout << "WARNING max_observation with multi dimensional "
+                                 "observations doesn't make sense"
+                              << std::endl;
+                return tools::make_vector(observations_matrix().maxCoeff());
+            }
+
+            /// return the mean observation (only call this if the output of the model is of dimension 1)
+            Eigen::VectorXd mean_observation() const
+            {
+                assert(_dim_out > 0);
+                return _nb_samples > 0 ? _mean_observation
+                                       : Eigen::VectorXd::Zero(_dim_out);
+            }
+
+            /// return the number of samples used to compute the model
+            int nb_samples() const { return _nb_samples; }
+
+            /// recompute the model, in O(nm^2); the frequencies follow the hyper-parameters of the kernel
+            /// (if update_full_kernel is false, only the mean has changed and only the weights are recomputed)
+            void recompute(bool update_obs_mean = true, bool update_full_kernel = true)
+            {
+                assert(_nb_samples > 0);
+
+                if (update_full_kernel || _phi_obs.rows() != nb_features()) {
+                    _omega = _kernel_function.spectral_frequencies(_Z, _E);
+                    _scale = _feature_scale(_kernel_function);
+
+                    Eigen::MatrixXd A;
+                    _feature_products(_omega, _scale, A, _phi_obs, _phi_ones, _phi_mean);
+                    A.diagonal().array() += _noise();
+                    _llt.compute(A);
+                }
+                else if (update_obs_mean && !mean::is_constant<MeanFunction>::value) {
+                    // the mean function has changed: recompute Phi^T * M
+                    _phi_mean.setZero();
+                    Eigen::MatrixXd phi;
+                    for (int start = 0; start < _nb_samples; start += _block_size()) {
+                        int rows = std::min(_block_size(), _nb_samples - start);
+                        _features_block(_omega, _scale, _samples.middleCols(start, rows), phi);
+                        _phi_mean.noalias() += phi.transpose() * _mean_block(start, rows);
+                    }
+                }
+
+                _compute_weights();
+            }
+
+            /// compute and return the log likelihood (in O(nm^2))
+            double compute_log_lik()
+            {
+                LikelihoodWorkspace ws;
+                _log_lik = compute_log_lik(_kernel_function, ws);
+                return _log_lik;
+            }
+
+            /// buffers used to evaluate the log likelihood for other hyper-parameters
+            /// without copying (or modifying) the model (see gp::KernelLFOpt)
+            struct LikelihoodWorkspace {
+                /// frequencies of the kernel function and scale of the features
+                Eigen::MatrixXd omega;
+                double scale;
+                /// Cholesky factor of Phi^T * Phi + noise * I
+                Eigen::LLT<Eigen::MatrixXd> llt;
+                /// mean of the weights
+                Eigen::MatrixXd alpha;
+                /// features of a block of samples
+                Eigen::MatrixXd phi;
+            };
+
+            /// compute and return the log likelihood of the current samples with the kernel function `kernel_function`
+            /// (and the current mean); the factorization is stored in `ws` and the model is left untouched
+            double compute_log_lik(const KernelFunction& kernel_function, LikelihoodWorkspace& ws) const
+            {
+                int n = _nb_samples, m = nb_features();
+                double noise = kernel_function.noise() + 1e-8;
+
+                ws.omega = kernel_function.spectral_frequencies(_Z, _E);
+                ws.scale = _feature_scale(kernel_function);
+
+                Eigen::MatrixXd A, phi_obs, phi_mean;
+                Eigen::VectorXd phi_ones;
+                _feature_products(ws.omega, ws.scale, A, phi_obs, phi_ones, phi_mean);
+                A.diagonal().array() += noise;
+                ws.llt.compute(A);
+                Eigen::MatrixXd b = _phi_residuals(phi_obs, phi_ones, phi_mean);
+                ws.alpha = ws.llt.solve(b);
+                double b_alpha = (b.array() * ws.alpha.array()).sum();
+
+                // with C = Phi * Phi^T + noise * I: r^T C^{-1} r = (r^T r - b^T A^{-1} b) / noise
+                // and log|C| = log|A| + (n - m) log(noise) (only once for all the outputs, like GP)
+                double r_sq = 0;
+                for (int start = 0; start < n; start += _block_size()) {
+                    int rows = std::min(_block_size(), n - start);
+                    r_sq += _residual_block(start, rows).squaredNorm();
+                }
+                double a = (r_sq - b_alpha) / noise;
+                long double logdet = 2 * ws.llt.matrixLLT().diagonal().array().log().sum() + (n - m) * std::log(noise);
+
+                return -0.5 * a - 0.5 * logdet - 0.5 * n * std::log(2 * M_PI);
+            }
+
+            /// compute and return the gradient of the log likelihood wrt to the parameters of `kernel_function`
+            /// (call compute_log_lik(kernel_function, ws) first)
+            Eigen::VectorXd compute_kernel_grad_log_lik(const KernelFunction& kernel_function, LikelihoodWorkspace& ws) const
+            {
+                int n = _nb_samples, h = ws.omega.cols(), m = 2 * h;
+                double noise = kernel_function.noise() + 1e-8;
+                Eigen::MatrixXd A_inv = ws.llt.solve(Eigen::MatrixXd::Identity(m, m));
+
+                // G = E * alpha^T / noise - Phi * A^{-1} is the derivative of the log likelihood wrt the features
+                // (E: residuals of the regression); by blocks of rows, we accumulate sum(G .* Phi) for the scale
+                // of the features and P = X * H for the frequencies, with H the derivative wrt Omega^T * X
+                double g_scale = 0, e_sq = 0;
+                Eigen::MatrixXd P = Eigen::MatrixXd::Zero(_dim_in, h);
+                Eigen::MatrixXd E, G, H;
+                for (int start = 0; start < n; start += _block_size()) {
+                    int rows = std::min(_block_size(), n - start);
+                    _features_block(ws.omega, ws.scale, _samples.middleCols(start, rows), ws.phi);
+                    E = _residual_block(start, rows);
+                    E.noalias() -= ws.phi * ws.alpha;
+                    e_sq += E.squaredNorm();
+                    G.noalias() = E * ws.alpha.transpose() / noise;
+                    G.noalias() -= ws.phi * A_inv;
+                    g_scale += (G.array() * ws.phi.array()).sum();
+                    // d cos / d(omega^T x) = -sin and d sin / d(omega^T x) = cos
+                    H = ws.phi.leftCols(h).cwiseProduct(G.rightCols(h)) - ws.phi.rightCols(h).cwiseProduct(G.leftCols(h));
+                    P.noalias() += _samples.middleCols(start, rows) * H;
+                }
+
+                // chain rule through the frequencies and the scale (which are cheap to evaluate: central differences)
+                Eigen::VectorXd grad(kernel_function.h_params_size());
+                Eigen::VectorXd theta = kernel_function.h_params();
+                int nb_params = grad.size() - (Params::kernel::optimize_noise() ? 1 : 0);
+                double eps = 1e-6;
+                for (int p = 0; p < nb_params; p++) {
+                    KernelFunction k_p = kernel_function, k_m = kernel_function;
+                    Eigen::VectorXd theta_p = theta, theta_m = theta;
+                    theta_p(p) += eps;
+                    theta_m(p) -= eps;
+                    k_p.set_h_params(theta_p);
+                    k_m.set_h_params(theta_m);
+                    Eigen::MatrixXd d_omega = (k_p.spectral_frequencies(_Z, _E) - k_m.spectral_frequencies(_Z, _E)) / (2 * eps);
+                    double d_log_scale = (std::log(_feature_scale(k_p)) - std::log(_feature_scale(k_m))) / (2 * eps);
+                    grad(p) = d_log_scale * g_scale + (d_omega.array() * P.array()).sum();
+                }
+
+                // noise = exp(2 * p): d log lik / dp = (|E|^2 / noise^2 - tr(C^{-1})) * noise
+                if (Params::kernel::optimize_noise())
+                    grad(nb_params) = (e_sq / (noise * noise) - (n - m) / noise - A_inv.trace()) * kernel_function.noise();
+
+                return grad;
+            }
+
+            /// return the likelihood (do not compute it -- return last computed)
+            double get_log_lik() const { return _log_lik; }
+
+            /// set the log likelihood (e.g. computed from outside)
+            void set_log_lik(double log_lik) { _log_lik = log_lik; }
+
+            /// return the list of samples
+            std::vector<Eigen::VectorXd> samples() const
+            {
+                std::vector<Eigen::VectorXd> samples(_nb_samples);
+                for (int i = 0; i < _nb_samples; i++)
+                    samples[i] = _samples.col(i);
+                return samples;
+            }
+
+            /// return the samples (in matrix form)
+            /// (DxN), where D is the dimension of the input and N the number of points
+            Eigen::MatrixXd::ConstColsBlockXpr samples_matrix() const
+            {
+                return _samples.leftCols(_nb_samples);
+            }
+
+            /// return the list of observations
+            std::vector<Eigen::VectorXd> observations() const
+            {
+                std::vector<Eigen::VectorXd> observations(_nb_samples);
+                for (int i = 0; i < _nb_samples; i++)
+                    observations[i] = _observations.row(i);
+                return observations;
+            }
+
+            /// return the observations (in matrix form)
+            /// (NxD), where N is the number of points and D is the dimension output
+            Eigen::MatrixXd::ConstRowsBlockXpr observations_matrix() const
+            {
+                return _observations.topRows(_nb_samples);
+            }
+
+        protected:
+            int _dim_in;
+            int _dim_out;
+
+            KernelFunction _kernel_function;
+            MeanFunction _mean_function;
+
+            // one sample per column (and one observation per row), with a spare capacity
+            Eigen::MatrixXd _samples;
+            Eigen::MatrixXd _observations;
+            int _nb_samples;
+            Eigen::VectorXd _mean_observation;
+
+            // standard normal draws that define the frequencies (kept when the hyper-parameters change)
+            Eigen::MatrixXd _Z, _E;
+            Eigen::MatrixXd _omega;
+            double _scale;
+
+            // Cholesky factor of Phi^T * Phi + noise * I, Phi^T * observations, Phi^T * 1
+            // and Phi^T * mean (only for mean functions that are not constant)
+            Eigen::LLT<Eigen::MatrixXd> _llt;
+            Eigen::MatrixXd _phi_obs;
+            Eigen::VectorXd _phi_ones;
+            Eigen::MatrixXd _phi_mean;
+            Eigen::MatrixXd _weights;
+
+            double _log_lik;
+
+            HyperParamsOptimizer _hp_optimize;
+
+            static int _block_size() { return 1024; }
+
+            double _noise() const { return _kernel_function.noise() + 1e-8; }
+
+            void _set_dims(int dim_in, int dim_out)
+            {
+                if (_dim_in != dim_in) {
+                    _dim_in = dim_in;
+                    _kernel_function = KernelFunction(_dim_in); // the cost of building a functor should be relatively low
+                    _draw_frequencies();
+                }
+                if (_dim_out != dim_out) {
+                    _dim_out = dim_out;
+                    _mean_function = MeanFunction(_dim_out); // the cost of building a functor should be relatively low
+                }
+            }
+
+            void _draw_frequencies()
+            {
+                // the Matern kernels need 5 more normal draws per frequency (see spectral_frequencies())
+                int h = nb_features() / 2;
+                tools::rgen_gauss_t rgen(0., 1., Params::model_rff_gp::seed());
+                _Z.resize(_dim_in, h);
+                _E.resize(5, h);
+                for (int j = 0; j < h; j++) {
+                    for (int i = 0; i < _dim_in; i++)
+                        _Z(i, j) = rgen.rand();
+                    for (int i = 0; i < 5; i++)
+                        _E(i, j) = rgen.rand();
+                }
+                _omega = _kernel_function.spectral_frequencies(_Z, _E);
+                _scale = _feature_scale(_kernel_function);
+            }
+
+            // the features are scaled so that phi(x)^T phi(x) = k(x, x)
+            double _feature_scale(const KernelFunction& kernel_function) const
+            {
+                Eigen::VectorXd x = Eigen::VectorXd::Zero(_dim_in);
+                return std::sqrt(kernel_function(x, x) / (nb_features() / 2));
+            }
+
+            // features (one row per column of X)
+            template <typename M>
+            static void _features_block(const Eigen::MatrixXd& omega, double scale, const M& X, Eigen::MatrixXd& phi)
+            {
+                int h = omega.cols();
+                phi.resize(X.cols(), 2 * h);
+                phi.leftCols(h).noalias() = X.transpose() * omega;
+                phi.rightCols(h) = scale * phi.leftCols(h).array().sin();
+                phi.leftCols(h) = scale * phi.leftCols(h).array().cos();
+            }
+
+            // Phi^T * Phi (lower triangle only), Phi^T * observations, Phi^T * 1 and Phi^T * mean, by blocks of samples
+            void _feature_products(const Eigen::MatrixXd& omega, double scale, Eigen::MatrixXd& A, Eigen::MatrixXd& phi_obs, Eigen::VectorXd& phi_ones, Eigen::MatrixXd& phi_mean) const
+            {
+                int m = 2 * omega.cols();
+                A.setZero(m, m);
+                phi_obs.setZero(m, _dim_out);
+                phi_ones.setZero(m);
+                phi_mean.setZero(m, _dim_out);
+
+                Eigen::MatrixXd phi;
+                for (int start = 0; start < _nb_samples; start += _block_size()) {
+                    int rows = std::min(_block_size(), _nb_samples - start);
+                    _features_block(omega, scale, _samples.middleCols(start, rows), phi);
+                    A.selfadjointView<Eigen::Lower>().rankUpdate(phi.transpose());
+                    phi_obs.noalias() += phi.transpose() * _observations.middleRows(start, rows);
+                    phi_ones.noalias() += phi.colwise().sum().transpose();
+                    if (!mean::is_constant<MeanFunction>::value)
+                        phi_mean.noalias() += phi.transpose() * _mean_block(start, rows);
+                }
+            }
+
+            // mean function at the samples [start, start + rows) (one row per sample)
+            Eigen::MatrixXd _mean_block(int start, int rows) const
+            {
+                Eigen::MatrixXd mean(rows, _dim_out);
+                if (mean::is_constant<MeanFunction>::value)
+                    mean = _mean_function(_samples.col(0), *this).transpose().replicate(rows, 1);
+                else
+                    for (int i = 0; i < rows; i++)
+                        mean.row(i) = _mean_function(_samples.col(start + i), *this);
+                return mean;
+            }
+
+            Eigen::MatrixXd _residual_block(int start, int rows) const
+            {
+                return _observations.middleRows(start, rows) - _mean_block(start, rows);
+            }
+
+            // Phi^T * (observations - mean)
+            Eigen::MatrixXd _phi_residuals(const Eigen::MatrixXd& phi_obs, const Eigen::VectorXd& phi_ones, const Eigen::MatrixXd& phi_mean) const
+            {
+                if (mean::is_constant<MeanFunction>::value)
+                    return phi_obs - phi_ones * _mean_function(_samples.col(0), *this).transpose();
+                return phi_obs - phi_mean;
+            }
+
+            void _compute_weights()
+            {
+                _weights = _llt.solve(_phi_residuals(_phi_obs, _phi_ones, _phi_mean));
+            }
+
+            Eigen::VectorXd _mu(const Eigen::VectorXd& v, const Eigen::VectorXd& phi) const
+            {
+                return _mu(v, phi, _weights);
+            }
+
+            Eigen::VectorXd _mu(const Eigen::VectorXd& v, const Eigen::VectorXd& phi, const Eigen::MatrixXd& weights) const
+            {
+                return weights.transpose() * phi + _mean_function(v, *this);
+            }
+
+            double _sigma(const Eigen::VectorXd& phi) const
+            {
+                // noise * phi^T * (Phi^T * Phi + noise * I)^{-1} * phi
+                Eigen::VectorXd z = _llt.matrixL().solve(phi);
+                double res = _noise() * z.squaredNorm();
+                return (res <= std::numeric_limits<double>::epsilon()) ? 0 : res;
+            }
+        };
+    } // namespace model
+} // namespace limbo
+
+#endif
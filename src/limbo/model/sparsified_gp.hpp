@@ -106,14 +106,14 @@ namespace limbo {
                 base_gp_t::add_sample(sample, observation);
                 /// if we surpassed the maximum points, re-sparsify
                 /// and recompute
-                if (this->_samples.size() > Params::model_sparse_gp::max_points()) {
+                if (this->_nb_samples > Params::model_sparse_gp::max_points()) {
                     /// get observations in appropriate format
                     std::vector<Eigen::VectorXd> observations;
-                    for (size_t i = 0; i < this->_samples.size(); i++) {
+                    for (int i = 0; i < this->_nb_samples; i++) {
                         observations.push_back(this->_observations.row(i));
                     }
 
-                    compute(this->_samples, observations, true);
+                    compute(this->samples(), observations, true);
                 }
             }
 
@@ -47,10 +47,12 @@
 #define LIMBO_TOOLS_HPP
 
 ///@defgroup tools
+#include <limbo/tools/krylov.hpp>
 #include <limbo/tools/macros.hpp>
 #include <limbo/tools/math.hpp>
 #include <limbo/tools/parallel.hpp>
 #include <limbo/tools/random_generator.hpp>
 #include <limbo/tools/sys.hpp>
+#include <limbo/tools/tiled_cholesky.hpp>
 
 #endif
@@ -0,0 +1,202 @@
+//| Copyright Inria May 2015
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Jean-Baptiste Mouret (jean-baptiste.mouret@inria.fr)
+//|   - Antoine Cully (antoinecully@gmail.com)
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Federico Allocati (fede.allocati@gmail.com)
+//|   - Vaios Papaspyros (b.papaspyros@gmail.com)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is a computer library whose purpose is to optimize continuous,
+//| black-box functions. It mainly implements Gaussian processes and Bayesian
+//| optimization.
+//| Main repository: http://github.com/resibots/limbo
+//| Documentation: http://www.resibots.eu/limbo
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+
+#ifndef LIMBO_TOOLS_KRYLOV_HPP
+#define LIMBO_TOOLS_KRYLOV_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace limbo {
+    namespace tools {
+        /// @ingroup tools
+        /// coefficients of the conjugate gradients of one column (see preconditioned_conjugate_gradient()):
+        /// they give the tridiagonal matrix of the Lanczos decomposition of P^{-1} * A, started from the
+        /// initial (preconditioned) residual (Gardner et al., 2018)
+        struct CGCoefficients {
+            std::vector<double> alpha, beta;
+
+            /// diagonal and sub-diagonal of the tridiagonal matrix (of size alpha.size())
+            void tridiagonal(Eigen::VectorXd& diag, Eigen::VectorXd& sub_diag) const
+            {
+                int k = alpha.size();
+                diag.resize(k);
+                sub_diag.resize(std::max(k - 1, 0));
+                for (int j = 0; j < k; ++j) {
+                    diag(j) = 1. / alpha[j] + ((j > 0) ? beta[j - 1] / alpha[j - 1] : 0.);
+                    if (j < k - 1)
+                        sub_diag(j) = std::sqrt(beta[j]) / alpha[j];
+                }
+            }
+        };
+
+        /// @ingroup tools
+        /// preconditioned conjugate gradients for A * X = B, with A symmetric positive definite and only known
+        /// through its products: op(V, AV) should set AV = A * V (for a matrix V with as many columns as B),
+        /// and precond(R, Z) should set Z = P^{-1} * R, with P a symmetric positive definite approximation of A.
+        /// Each column has its own recurrence, but the products are done for all the columns at once.
+        /// X is the initial guess (e.g. the previous solution) and is replaced by the solution.
+        /// Stop when |B - A * X| <= tol * |B| for every column, or after max_iter iterations;
+        /// return the number of iterations. If coefficients is not null, it receives the coefficients of
+        /// each column (X should then start from zero for them to be a Lanczos decomposition).
+        template <typename Op, typename Precond>
+        inline int preconditioned_conjugate_gradient(const Op& op, const Precond& precond, const Eigen::MatrixXd& B, Eigen::MatrixXd& X,
+            double tol = 1e-8, int max_iter = 1000, std::vector<CGCoefficients>* coefficients = nullptr)
+        {
+            if (X.rows() != B.rows() || X.cols() != B.cols())
+                X = Eigen::MatrixXd::Zero(B.rows(), B.cols());
+            int m = B.cols();
+            if (coefficients)
+                coefficients->assign(m, CGCoefficients());
+
+            Eigen::MatrixXd R(B.rows(), m), Z(B.rows(), m), AP(B.rows(), m);
+            op(X, R);
+            R = B - R;
+            precond(R, Z);
+            Eigen::MatrixXd P = Z;
+            Eigen::ArrayXd rr = R.colwise().squaredNorm().transpose();
+            Eigen::ArrayXd rz = R.cwiseProduct(Z).colwise().sum().transpose();
+            Eigen::ArrayXd threshold = tol * tol * B.colwise().squaredNorm().transpose().array();
+
+            int it = 0;
+            std::vector<char> active(m);
+            for (; it < max_iter && (rr > threshold).any(); ++it) {
+                op(P, AP);
+                for (int j = 0; j < m; ++j) {
+                    active[j] = rr(j) > threshold(j);
+                    if (!active[j])
+                        continue;
+                    double pap = P.col(j).dot(AP.col(j));
+                    if (pap <= 0 || rz(j) <= 0) { // A or P is not positive definite (numerically)
+                        active[j] = false;
+                        rr(j) = 0;
+                        continue;
+                    }
+                    double a = rz(j) / pap;
+                    X.col(j) += a * P.col(j);
+                    R.col(j) -= a * AP.col(j);
+                    rr(j) = R.col(j).squaredNorm();
+                    if (coefficients)
+                        (*coefficients)[j].alpha.push_back(a);
+                }
+                precond(R, Z);
+                for (int j = 0; j < m; ++j) {
+                    if (!active[j])
+                        continue;
+                    double rz_new = R.col(j).dot(Z.col(j));
+                    double b = rz_new / rz(j);
+                    P.col(j) = Z.col(j) + b * P.col(j);
+                    rz(j) = rz_new;
+                    if (coefficients)
+                        (*coefficients)[j].beta.push_back(b);
+                }
+            }
+            return it;
+        }
+
+        /// @ingroup tools
+        /// conjugate gradients for A * X = B, without preconditioner (see preconditioned_conjugate_gradient())
+        template <typename Op>
+        inline int conjugate_gradient(const Op& op, const Eigen::MatrixXd& B, Eigen::MatrixXd& X, double tol = 1e-8, int max_iter = 1000)
+        {
+            auto identity = [](const Eigen::MatrixXd& R, Eigen::MatrixXd& Z) { Z = R; };
+            return preconditioned_conjugate_gradient(op, identity, B, X, tol, max_iter);
+        }
+
+        /// @ingroup tools
+        /// k steps of the Lanczos tridiagonalization of a symmetric matrix A (known through its products,
+        /// like in conjugate_gradient()), from the vector q0 and with full re-orthogonalization:
+        /// A * Q = Q * T + (residual in the last column), with Q (n x k) orthonormal and T tridiagonal
+        /// (diagonal alpha, sub-diagonal beta). Return the number of steps done (less than k if the
+        /// Krylov space is exhausted); Q, alpha and beta are resized to it.
+        template <typename Op>
+        inline int lanczos(const Op& op, const Eigen::VectorXd& q0, int k, Eigen::MatrixXd& Q, Eigen::VectorXd& alpha, Eigen::VectorXd& beta)
+        {
+            int n = q0.size();
+            k = std::min(k, n);
+            Q.resize(n, k);
+            alpha.resize(k);
+            beta.resize(std::max(k - 1, 0));
+
+            double norm = q0.norm();
+            if (norm == 0) {
+                Q.resize(n, 0);
+                alpha.resize(0);
+                beta.resize(0);
+                return 0;
+            }
+            Q.col(0) = q0 / norm;
+
+            Eigen::MatrixXd v(n, 1);
+            int steps = 0;
+            for (int j = 0; j < k; ++j) {
+                op(Q.col(j), v);
+                alpha(j) = Q.col(j).dot(v.col(0));
+                steps = j + 1;
+                if (j == k - 1)
+                    break;
+                // (twice is enough) Gram-Schmidt against all the previous vectors
+                for (int pass = 0; pass < 2; ++pass)
+                    v.col(0).noalias() -= Q.leftCols(j + 1) * (Q.leftCols(j + 1).transpose() * v.col(0));
+                double b = v.col(0).norm();
+                if (b <= 1e-12 * std::abs(alpha(j)))
+                    break;
+                beta(j) = b;
+                Q.col(j + 1) = v.col(0) / b;
+            }
+
+            Q.conservativeResize(n, steps);
+            alpha.conservativeResize(steps);
+            beta.conservativeResize(std::max(steps - 1, 0));
+            return steps;
+        }
+    } // namespace tools
+} // namespace limbo
+
+#endif
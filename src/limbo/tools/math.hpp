@@ -56,6 +56,8 @@
 #include <stdlib.h>
 #include <utility>
 
+#include <Eigen/Core>
+
 namespace limbo {
     namespace tools {
 
@@ -68,6 +70,18 @@ namespace limbo {
             return res;
         }
 
+        /// @ingroup tools
+        /// squared euclidean distances (N1xN2) between the columns of X1 (DxN1) and the columns of X2 (DxN2)
+        /// computed with ||a||^2 + ||b||^2 - 2a^T b (i.e. with a single matrix-matrix product)
+        inline Eigen::MatrixXd sq_dist(const Eigen::Ref<const Eigen::MatrixXd>& X1, const Eigen::Ref<const Eigen::MatrixXd>& X2)
+        {
+            Eigen::MatrixXd D = -2. * X1.transpose() * X2;
+            D.colwise() += X1.colwise().squaredNorm().transpose();
+            D.rowwise() += X2.colwise().squaredNorm();
+            // remove negative values due to rounding errors
+            return D.cwiseMax(0.);
+        }
+
         template <typename T>
         inline constexpr int signum(T x, std::false_type is_signed)
         {
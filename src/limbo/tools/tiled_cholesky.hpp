@@ -0,0 +1,140 @@
+//| Copyright Inria May 2015
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Jean-Baptiste Mouret (jean-baptiste.mouret@inria.fr)
+//|   - Antoine Cully (antoinecully@gmail.com)
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Federico Allocati (fede.allocati@gmail.com)
+//|   - Vaios Papaspyros (b.papaspyros@gmail.com)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is a computer library whose purpose is to optimize continuous,
+//| black-box functions. It mainly implements Gaussian processes and Bayesian
+//| optimization.
+//| Main repository: http://github.com/resibots/limbo
+//| Documentation: http://www.resibots.eu/limbo
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef LIMBO_TOOLS_TILED_CHOLESKY_HPP
+#define LIMBO_TOOLS_TILED_CHOLESKY_HPP
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Cholesky>
+#include <Eigen/Core>
+
+#include <limbo/tools/parallel.hpp>
+
+namespace limbo {
+    namespace tools {
+        /// @ingroup tools
+        /// in-place Cholesky decomposition A = L * L^T (right-looking, by tiles of size b):
+        /// the lower triangle of A is replaced by L (the strictly upper triangle is not used).
+        /// For each diagonal tile, the tiles below it are solved in parallel, then all the tiles
+        /// of the trailing matrix are updated in parallel (with tools::par).
+        /// Return false if A is not positive definite.
+        inline bool tiled_llt(Eigen::Ref<Eigen::MatrixXd> A, int b = 256)
+        {
+            int n = A.rows();
+            int nt = (n + b - 1) / b;
+            bool success = true;
+            std::vector<std::pair<int, int>> tiles;
+            for (int k = 0; k < nt; ++k) {
+                int k0 = k * b, kb = std::min(b, n - k0);
+                auto Akk = A.block(k0, k0, kb, kb);
+                Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>> llt(Akk);
+                if (llt.info() != Eigen::Success)
+                    success = false;
+
+                // L_ik = A_ik * L_kk^{-T}
+                par::loop(k + 1, nt, [&](size_t i) {
+                    int i0 = i * b, ib = std::min(b, n - i0);
+                    Akk.template triangularView<Eigen::Lower>().transpose().template solveInPlace<Eigen::OnTheRight>(A.block(i0, k0, ib, kb));
+                });
+
+                // A_ij -= L_ik * L_jk^T (lower tiles of the trailing matrix)
+                tiles.clear();
+                for (int j = k + 1; j < nt; ++j)
+                    for (int i = j; i < nt; ++i)
+                        tiles.push_back(std::make_pair(i, j));
+                par::loop(0, tiles.size(), [&](size_t t) {
+                    int i0 = tiles[t].first * b, ib = std::min(b, n - i0);
+                    int j0 = tiles[t].second * b, jb = std::min(b, n - j0);
+                    if (i0 == j0)
+                        A.block(i0, i0, ib, ib).template selfadjointView<Eigen::Lower>().rankUpdate(A.block(i0, k0, ib, kb), -1.);
+                    else
+                        A.block(i0, j0, ib, jb).noalias() -= A.block(i0, k0, ib, kb) * A.block(j0, k0, jb, kb).transpose();
+                });
+            }
+            return success;
+        }
+
+        /// @ingroup tools
+        /// solve L * X = B in place (L lower triangular), by tiles of size b:
+        /// once a tile of rows of X is known, the tiles below it are updated in parallel
+        template <typename MatrixL, typename MatrixB>
+        inline void tiled_lower_solve(const MatrixL& L, MatrixB& B, int b = 256)
+        {
+            int n = L.rows();
+            int nt = (n + b - 1) / b;
+            for (int k = 0; k < nt; ++k) {
+                int k0 = k * b, kb = std::min(b, n - k0);
+                L.block(k0, k0, kb, kb).template triangularView<Eigen::Lower>().solveInPlace(B.middleRows(k0, kb));
+                par::loop(k + 1, nt, [&](size_t i) {
+                    int i0 = i * b, ib = std::min(b, n - i0);
+                    B.middleRows(i0, ib).noalias() -= L.block(i0, k0, ib, kb) * B.middleRows(k0, kb);
+                });
+            }
+        }
+
+        /// @ingroup tools
+        /// solve L^T * X = B in place (L lower triangular), by tiles of size b
+        /// (from the last tile of rows; the tiles above are updated in parallel)
+        template <typename MatrixL, typename MatrixB>
+        inline void tiled_upper_solve(const MatrixL& L, MatrixB& B, int b = 256)
+        {
+            int n = L.rows();
+            int nt = (n + b - 1) / b;
+            for (int k = nt - 1; k >= 0; --k) {
+                int k0 = k * b, kb = std::min(b, n - k0);
+                L.block(k0, k0, kb, kb).template triangularView<Eigen::Lower>().adjoint().solveInPlace(B.middleRows(k0, kb));
+                par::loop(0, k, [&](size_t i) {
+                    int i0 = i * b, ib = std::min(b, n - i0);
+                    B.middleRows(i0, ib).noalias() -= L.block(k0, i0, kb, ib).transpose() * B.middleRows(k0, kb);
+                });
+            }
+        }
+    } // namespace tools
+} // namespace limbo
+
+#endif
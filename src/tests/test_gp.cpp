@@ -47,6 +47,8 @@
 #define BOOST_TEST_MODULE test_gp
 #define protected public
 
+#include <thread>
+
 #include <boost/test/unit_test.hpp>
 
 #include <limbo/acqui/ucb.hpp>
@@ -56,13 +58,20 @@
 #include <limbo/kernel/squared_exp_ard.hpp>
 #include <limbo/mean/constant.hpp>
 #include <limbo/mean/function_ard.hpp>
+#include <limbo/mean/null_function.hpp>
+#include <limbo/model/coregionalized_gp.hpp>
+#include <limbo/model/coregionalized_gp/lf_opt.hpp>
 #include <limbo/model/gp.hpp>
 #include <limbo/model/gp/kernel_lf_opt.hpp>
 #include <limbo/model/gp/kernel_loo_opt.hpp>
 #include <limbo/model/gp/kernel_mean_lf_opt.hpp>
 #include <limbo/model/gp/mean_lf_opt.hpp>
+#include <limbo/model/inducing_gp.hpp>
+#include <limbo/model/kiss_gp.hpp>
+#include <limbo/model/local_gp.hpp>
 #include <limbo/model/multi_gp.hpp>
 #include <limbo/model/multi_gp/parallel_lf_opt.hpp>
+#include <limbo/model/rff_gp.hpp>
 #include <limbo/model/sparsified_gp.hpp>
 #include <limbo/opt/grid_search.hpp>
 #include <limbo/tools/macros.hpp>
@@ -91,6 +100,22 @@ std::tuple<double, Eigen::VectorXd, Eigen::VectorXd> check_grad(const F& f, cons
     return std::make_tuple((analytic_result - finite_diff_result).norm(), analytic_result, finite_diff_result);
 }
 
+// check_grad() of the log likelihood of `model` wrt its kernel hyper-parameters, at p (computed in a LikelihoodWorkspace)
+template <typename Model>
+std::tuple<double, Eigen::VectorXd, Eigen::VectorXd> check_model_lik_grad(const Model& model, const Eigen::VectorXd& p, double e = 1e-4)
+{
+    auto lik = [&model](const Eigen::VectorXd& x, bool compute_grad) -> opt::eval_t {
+        auto k = model.kernel_function();
+        k.set_h_params(x);
+        typename Model::LikelihoodWorkspace ws;
+        double l = model.compute_log_lik(k, ws);
+        if (!compute_grad)
+            return opt::no_grad(l);
+        return opt::eval_t{l, model.compute_kernel_grad_log_lik(k, ws)};
+    };
+    return check_grad(lik, p, e);
+}
+
 Eigen::VectorXd make_v1(double x)
 {
     return tools::make_vector(x);
@@ -103,6 +128,13 @@ Eigen::VectorXd make_v2(double x1, double x2)
     return v2;
 }
 
+Eigen::VectorXd make_v3(double x1, double x2, double x3)
+{
+    Eigen::VectorXd v3(3);
+    v3 << x1, x2, x3;
+    return v3;
+}
+
 struct Params {
     struct kernel : public defaults::kernel {
     };
@@ -510,6 +542,729 @@ BOOST_AUTO_TEST_CASE(test_gp)
     }
 }
 
+BOOST_AUTO_TEST_CASE(test_gp_query_batch)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::SquaredExpARD<Params>;
+    using Mean_t = mean::Constant<Params>;
+    using GP_t = model::GP<Params, KF_t, Mean_t>;
+    using MultiGP_t = model::MultiGP<Params, model::GP, KF_t, Mean_t>;
+
+    GP_t gp(3, 2);
+    MultiGP_t multi_gp(3, 2);
+
+    Eigen::MatrixXd X = Eigen::MatrixXd::Random(50, 3);
+
+    // without samples, we should get the prior
+    Eigen::MatrixXd mu_batch;
+    Eigen::VectorXd sigma_batch;
+    std::tie(mu_batch, sigma_batch) = gp.query_batch(X);
+    for (int i = 0; i < X.rows(); i++) {
+        Eigen::VectorXd mu;
+        double sigma;
+        std::tie(mu, sigma) = gp.query(X.row(i));
+        BOOST_CHECK((mu_batch.row(i).transpose() - mu).norm() < 1e-8);
+        BOOST_CHECK(std::abs(sigma_batch(i) - sigma) < 1e-8);
+    }
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 20; i++) {
+        samples.push_back(tools::random_vector(3));
+        observations.push_back(make_v2(std::cos(samples[i](0)), std::sin(samples[i](1))));
+    }
+
+    gp.compute(samples, observations);
+    multi_gp.compute(samples, observations);
+
+    std::tie(mu_batch, sigma_batch) = gp.query_batch(X);
+    BOOST_CHECK(mu_batch.isApprox(gp.mu_batch(X)));
+    BOOST_CHECK(sigma_batch.isApprox(gp.sigma_batch(X)));
+
+    Eigen::MatrixXd multi_mu_batch, multi_sigma_batch;
+    std::tie(multi_mu_batch, multi_sigma_batch) = multi_gp.query_batch(X);
+    BOOST_CHECK(multi_mu_batch.isApprox(multi_gp.mu_batch(X)));
+    BOOST_CHECK(multi_sigma_batch.isApprox(multi_gp.sigma_batch(X)));
+
+    for (int i = 0; i < X.rows(); i++) {
+        Eigen::VectorXd mu;
+        double sigma;
+        std::tie(mu, sigma) = gp.query(X.row(i));
+        BOOST_CHECK((mu_batch.row(i).transpose() - mu).norm() < 1e-8);
+        BOOST_CHECK(std::abs(sigma_batch(i) - sigma) < 1e-8);
+
+        Eigen::VectorXd multi_mu, multi_sigma;
+        std::tie(multi_mu, multi_sigma) = multi_gp.query(X.row(i));
+        BOOST_CHECK((multi_mu_batch.row(i).transpose() - multi_mu).norm() < 1e-8);
+        BOOST_CHECK((multi_sigma_batch.row(i).transpose() - multi_sigma).norm() < 1e-8);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_gp_samples_storage)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::MaternFiveHalves<Params>;
+    using Mean_t = mean::Constant<Params>;
+    using GP_t = model::GP<Params, KF_t, Mean_t>;
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 37; i++) {
+        samples.push_back(tools::random_vector(3));
+        observations.push_back(make_v1(std::cos(samples[i](0))));
+    }
+
+    GP_t gp, gp2;
+    gp.compute(samples, observations);
+    for (size_t i = 0; i < samples.size(); i++)
+        gp2.add_sample(samples[i], observations[i]);
+
+    BOOST_CHECK(gp.nb_samples() == 37);
+    BOOST_CHECK(gp2.nb_samples() == 37);
+    BOOST_CHECK(gp2.samples_matrix().cols() == 37);
+    BOOST_CHECK(gp2._samples.cols() >= 37);
+
+    std::vector<Eigen::VectorXd> samples2 = gp2.samples();
+    BOOST_CHECK(samples2.size() == samples.size());
+    for (size_t i = 0; i < samples.size(); i++) {
+        BOOST_CHECK(samples2[i] == samples[i]);
+        BOOST_CHECK(gp.samples_matrix().col(i) == samples[i]);
+    }
+
+    BOOST_CHECK(gp.matrixL().isApprox(gp2.matrixL(), 1e-8));
+}
+
+BOOST_AUTO_TEST_CASE(test_gp_likelihood_workspace)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::SquaredExpARD<Params>;
+    using Mean_t = mean::FunctionARD<Params, mean::Constant<Params>>;
+    using GP_t = model::GP<Params, KF_t, Mean_t>;
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 30; i++) {
+        samples.push_back(tools::random_vector(3));
+        Eigen::VectorXd ob(2);
+        ob << std::cos(samples[i](0)), std::sin(samples[i](1));
+        observations.push_back(ob);
+    }
+
+    GP_t gp(3, 2);
+    gp.compute(samples, observations);
+    Eigen::MatrixXd L = gp.matrixL();
+
+    GP_t::LikelihoodWorkspace ws;
+    for (int k = 0; k < 5; k++) {
+        KF_t kernel_function = gp.kernel_function();
+        Mean_t mean_function = gp.mean_function();
+        kernel_function.set_h_params(tools::random_vector(kernel_function.h_params_size()));
+        mean_function.set_h_params(tools::random_vector(mean_function.h_params_size()));
+
+        // reference: a modified copy of the GP
+        GP_t gp2(gp);
+        gp2.kernel_function() = kernel_function;
+        gp2.recompute(false);
+        BOOST_CHECK_CLOSE(gp.compute_log_lik(kernel_function, ws), gp2.compute_log_lik(), 1e-6);
+        BOOST_CHECK(gp.compute_kernel_grad_log_lik(kernel_function, ws).isApprox(gp2.compute_kernel_grad_log_lik(), 1e-6));
+
+        gp2.mean_function() = mean_function;
+        gp2.recompute(true);
+        BOOST_CHECK_CLOSE(gp.compute_log_lik(kernel_function, mean_function, ws), gp2.compute_log_lik(), 1e-6);
+        BOOST_CHECK(gp.compute_mean_grad_log_lik(mean_function, ws).isApprox(gp2.compute_mean_grad_log_lik(), 1e-6));
+        BOOST_CHECK(gp.compute_kernel_grad_log_lik(kernel_function, ws).isApprox(gp2.compute_kernel_grad_log_lik(), 1e-6));
+    }
+
+    // the GP itself is left untouched
+    BOOST_CHECK(gp.matrixL() == L);
+}
+
+BOOST_AUTO_TEST_CASE(test_gp_add_samples)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::SquaredExpARD<Params>;
+    using Mean_t = mean::Data<Params>;
+    using GP_t = model::GP<Params, KF_t, Mean_t>;
+
+    Eigen::MatrixXd X = Eigen::MatrixXd::Random(50, 3);
+    Eigen::MatrixXd Y(50, 2);
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < X.rows(); i++) {
+        Y.row(i) << std::cos(X(i, 0)), std::sin(X(i, 1)) * X(i, 2);
+        samples.push_back(X.row(i).transpose());
+        observations.push_back(Y.row(i).transpose());
+    }
+
+    GP_t gp;
+    gp.compute(samples, observations);
+
+    // first batch on an empty GP, then batches of different sizes
+    GP_t gp2;
+    gp2.add_samples(X.topRows(7), Y.topRows(7));
+    gp2.add_samples(X.middleRows(7, 1), Y.middleRows(7, 1));
+    gp2.add_samples(X.middleRows(8, 32), Y.middleRows(8, 32));
+    gp2.add_sample(X.row(40).transpose(), Y.row(40).transpose());
+    gp2.add_samples(X.bottomRows(9), Y.bottomRows(9));
+
+    BOOST_CHECK(gp2.nb_samples() == 50);
+    BOOST_CHECK(gp2.samples_matrix() == X.transpose());
+    BOOST_CHECK(gp2.matrixL().isApprox(gp.matrixL(), 1e-8));
+    BOOST_CHECK(gp2.alpha().isApprox(gp.alpha(), 1e-8));
+
+    Eigen::MatrixXd T = Eigen::MatrixXd::Random(10, 3);
+    BOOST_CHECK(gp2.mu_batch(T).isApprox(gp.mu_batch(T), 1e-8));
+}
+
+BOOST_AUTO_TEST_CASE(test_gp_remove_sample)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::MaternFiveHalves<Params>;
+    using Mean_t = mean::Data<Params>;
+    using GP_t = model::GP<Params, KF_t, Mean_t>;
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 30; i++) {
+        samples.push_back(tools::random_vector(2));
+        observations.push_back(make_v1(std::cos(samples[i](0)) + samples[i](1)));
+    }
+
+    GP_t gp;
+    gp.compute(samples, observations);
+
+    // remove samples in the middle, first and last
+    for (int i : {12, 0, 27}) {
+        gp.remove_sample(i);
+        samples.erase(samples.begin() + i);
+        observations.erase(observations.begin() + i);
+
+        GP_t gp2;
+        gp2.compute(samples, observations);
+        BOOST_CHECK(gp.nb_samples() == gp2.nb_samples());
+        BOOST_CHECK(gp.matrixL().isApprox(gp2.matrixL(), 1e-8));
+        BOOST_CHECK(gp.alpha().isApprox(gp2.alpha(), 1e-8));
+
+        Eigen::VectorXd v = tools::random_vector(2);
+        BOOST_CHECK(std::abs(gp.mu(v)(0) - gp2.mu(v)(0)) < 1e-8);
+        BOOST_CHECK(std::abs(gp.sigma(v) - gp2.sigma(v)) < 1e-8);
+    }
+
+    // sliding window
+    GP_t gp3;
+    gp3.set_max_window(10);
+    for (size_t i = 0; i < samples.size(); i++)
+        gp3.add_sample(samples[i], observations[i]);
+    BOOST_CHECK(gp3.nb_samples() == 10);
+
+    GP_t gp4;
+    gp4.compute(std::vector<Eigen::VectorXd>(samples.end() - 10, samples.end()), std::vector<Eigen::VectorXd>(observations.end() - 10, observations.end()));
+    BOOST_CHECK(gp3.samples_matrix().isApprox(gp4.samples_matrix()));
+    BOOST_CHECK(gp3.matrixL().isApprox(gp4.matrixL(), 1e-8));
+    BOOST_CHECK(gp3.alpha().isApprox(gp4.alpha(), 1e-8));
+
+    // remove everything
+    while (gp4.nb_samples() > 0)
+        gp4.remove_sample(gp4.nb_samples() - 1);
+    gp4.add_sample(samples[0], observations[0]);
+    BOOST_CHECK(gp4.nb_samples() == 1);
+    BOOST_CHECK(std::abs(gp4.mu(samples[0])(0) - observations[0](0)) < 1e-2);
+}
+
+BOOST_AUTO_TEST_CASE(test_gp_incremental_alpha)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::MaternFiveHalves<Params>;
+    using GPData_t = model::GP<Params, KF_t, mean::Data<Params>>;
+    using GPConstant_t = model::GP<Params, KF_t, mean::Constant<Params>>;
+    using GPEval_t = model::GP<Params, KF_t, mean::FunctionARD<Params, mean::Constant<Params>>>;
+
+    BOOST_CHECK(mean::is_constant<mean::Data<Params>>::value);
+    BOOST_CHECK(mean::is_constant<mean::Constant<Params>>::value);
+    BOOST_CHECK(mean::is_constant<mean::NullFunction<Params>>::value);
+    BOOST_CHECK((!mean::is_constant<mean::FunctionARD<Params, mean::Constant<Params>>>::value));
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 40; i++) {
+        samples.push_back(tools::random_vector(2));
+        observations.push_back(make_v1(std::cos(samples[i](0)) + samples[i](1)));
+    }
+
+    GPData_t gp_data;
+    GPConstant_t gp_constant;
+    GPEval_t gp_eval;
+    for (size_t i = 0; i < samples.size(); i++) {
+        gp_data.add_sample(samples[i], observations[i]);
+        gp_constant.add_sample(samples[i], observations[i]);
+        gp_eval.add_sample(samples[i], observations[i]);
+    }
+    gp_data.remove_sample(5);
+    gp_constant.remove_sample(5);
+    gp_eval.remove_sample(5);
+    samples.erase(samples.begin() + 5);
+    observations.erase(observations.begin() + 5);
+    gp_data.add_sample(samples[5], observations[5]);
+    gp_constant.add_sample(samples[5], observations[5]);
+    gp_eval.add_sample(samples[5], observations[5]);
+    samples.push_back(samples[5]);
+    observations.push_back(observations[5]);
+
+    GPData_t gp_data2;
+    gp_data2.compute(samples, observations);
+    BOOST_CHECK(gp_data.mean_observation().isApprox(gp_data2.mean_observation(), 1e-10));
+    BOOST_CHECK(gp_data.mean_vector().isApprox(gp_data2.mean_vector(), 1e-10));
+    BOOST_CHECK(gp_data.alpha().isApprox(gp_data2.alpha(), 1e-8));
+
+    GPConstant_t gp_constant2;
+    gp_constant2.compute(samples, observations);
+    BOOST_CHECK(gp_constant.alpha().isApprox(gp_constant2.alpha(), 1e-8));
+
+    GPEval_t gp_eval2;
+    gp_eval2.compute(samples, observations);
+    BOOST_CHECK(gp_eval.alpha().isApprox(gp_eval2.alpha(), 1e-8));
+
+    // a change of the mean does not need a new factorization
+    gp_constant.mean_function().set_h_params(tools::make_vector(-2.));
+    gp_constant.recompute(true, false);
+    gp_constant2.mean_function().set_h_params(tools::make_vector(-2.));
+    gp_constant2.recompute(true, true);
+    BOOST_CHECK(gp_constant.alpha().isApprox(gp_constant2.alpha(), 1e-8));
+}
+
+BOOST_AUTO_TEST_CASE(test_gp_mixed_precision)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::SquaredExpARD<Params>;
+    using Mean_t = mean::Data<Params>;
+    using GP_t = model::GP<Params, KF_t, Mean_t>;
+    using GPf_t = model::GP<Params, KF_t, Mean_t, model::gp::NoLFOpt<Params>, model::gp::MixedPrecision>;
+
+    BOOST_CHECK((std::is_same<GPf_t::matrix_t, Eigen::MatrixXf>::value));
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 200; i++) {
+        samples.push_back(tools::random_vector(3));
+        observations.push_back(make_v1(std::cos(3 * samples[i](0)) + samples[i](1) * samples[i](2)));
+    }
+
+    GP_t gp;
+    gp.compute(samples, observations);
+    GPf_t gpf;
+    gpf.compute(samples, observations);
+
+    // the factor is computed in double: it only differs by the rounding to float
+    BOOST_CHECK(gpf.matrixL().cast<double>().isApprox(gp.matrixL(), 1e-6));
+    // alpha is refined in double
+    BOOST_CHECK(gpf.alpha().isApprox(gp.alpha(), 1e-4));
+    BOOST_CHECK_CLOSE(gpf.compute_log_lik(), gp.compute_log_lik(), 1e-3);
+
+    Eigen::MatrixXd X = Eigen::MatrixXd::Random(50, 3).array().abs();
+    Eigen::MatrixXd mu, muf;
+    Eigen::VectorXd sigma, sigmaf;
+    std::tie(mu, sigma) = gp.query_batch(X);
+    std::tie(muf, sigmaf) = gpf.query_batch(X);
+    BOOST_CHECK((mu - muf).cwiseAbs().maxCoeff() < 1e-4);
+    BOOST_CHECK((sigma - sigmaf).cwiseAbs().maxCoeff() < 1e-4);
+
+    // incremental updates
+    for (int i = 0; i < 10; i++) {
+        Eigen::VectorXd s = tools::random_vector(3);
+        Eigen::VectorXd o = make_v1(std::cos(3 * s(0)) + s(1) * s(2));
+        gp.add_sample(s, o);
+        gpf.add_sample(s, o);
+    }
+    gp.remove_sample(17);
+    gpf.remove_sample(17);
+    BOOST_CHECK(gpf.alpha().isApprox(gp.alpha(), 1e-4));
+    for (int i = 0; i < X.rows(); i++) {
+        Eigen::VectorXd v = X.row(i).transpose();
+        BOOST_CHECK(std::abs(gp.mu(v)(0) - gpf.mu(v)(0)) < 1e-4);
+        BOOST_CHECK(std::abs(gp.sigma(v) - gpf.sigma(v)) < 1e-4);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_gp_compact)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::SquaredExpARD<Params>;
+    using Mean_t = mean::FunctionARD<Params, mean::Constant<Params>>;
+    using GP_t = model::GP<Params, KF_t, Mean_t>;
+    // small panels, so that the factor spans several panels
+    using GPc_t = model::GP<Params, KF_t, Mean_t, model::gp::NoLFOpt<Params>, model::gp::Compact<model::gp::DoublePrecision, 16>>;
+    using GPcf_t = model::GP<Params, KF_t, Mean_t, model::gp::NoLFOpt<Params>, model::gp::Compact<model::gp::MixedPrecision, 16>>;
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 70; i++) {
+        samples.push_back(tools::random_vector(3));
+        observations.push_back(make_v2(std::cos(3 * samples[i](0)), samples[i](1) * samples[i](2)));
+    }
+
+    GP_t gp;
+    gp.compute(samples, observations);
+    GPc_t gpc;
+    gpc.compute(samples, observations);
+    GPcf_t gpcf;
+    gpcf.compute(samples, observations);
+
+    BOOST_CHECK(gpc.matrixL().size() == 0);
+    BOOST_CHECK(gpc.alpha().isApprox(gp.alpha(), 1e-8));
+    BOOST_CHECK(gpcf.alpha().isApprox(gp.alpha(), 1e-4));
+    BOOST_CHECK_CLOSE(gpc.compute_log_lik(), gp.compute_log_lik(), 1e-6);
+    BOOST_CHECK_CLOSE(gpc.compute_log_loo_cv(), gp.compute_log_loo_cv(), 1e-6);
+    BOOST_CHECK(gpc.compute_kernel_grad_log_lik().isApprox(gp.compute_kernel_grad_log_lik(), 1e-6));
+    BOOST_CHECK(gpc.compute_mean_grad_log_lik().isApprox(gp.compute_mean_grad_log_lik(), 1e-6));
+    BOOST_CHECK(gpc.compute_kernel_grad_log_loo_cv().isApprox(gp.compute_kernel_grad_log_loo_cv(), 1e-6));
+    BOOST_CHECK(!gpc.inv_kernel_computed());
+
+    // the likelihood of other hyper-parameters (as in the optimizers) is computed without dense buffers
+    KF_t kf = gp.kernel_function();
+    kf.set_h_params(Eigen::VectorXd::Constant(kf.h_params_size(), -0.3));
+    GP_t::LikelihoodWorkspace ws;
+    GPc_t::LikelihoodWorkspace wsc;
+    BOOST_CHECK_CLOSE(gpc.compute_log_lik(kf, wsc), gp.compute_log_lik(kf, ws), 1e-6);
+    BOOST_CHECK(gpc.compute_kernel_grad_log_lik(kf, wsc).isApprox(gp.compute_kernel_grad_log_lik(kf, ws), 1e-6));
+    BOOST_CHECK(wsc.kernel.size() == 0);
+    BOOST_CHECK(wsc.panels.size() == 5);
+
+    Eigen::MatrixXd X = Eigen::MatrixXd::Random(20, 3);
+    Eigen::MatrixXd mu, muc;
+    Eigen::VectorXd sigma, sigmac;
+    std::tie(mu, sigma) = gp.query_batch(X);
+    std::tie(muc, sigmac) = gpc.query_batch(X);
+    BOOST_CHECK(muc.isApprox(mu, 1e-8));
+    BOOST_CHECK((sigma - sigmac).cwiseAbs().maxCoeff() < 1e-8);
+
+    // incremental updates across the panels
+    Eigen::MatrixXd S = Eigen::MatrixXd::Random(21, 3), O = Eigen::MatrixXd::Random(21, 2);
+    gp.add_samples(S.topRows(20), O.topRows(20));
+    gpc.add_samples(S.topRows(20), O.topRows(20));
+    gp.add_sample(S.row(20).transpose(), O.row(20).transpose());
+    gpc.add_sample(S.row(20).transpose(), O.row(20).transpose());
+    for (int i : {90, 3, 40, 47, 0}) {
+        gp.remove_sample(i);
+        gpc.remove_sample(i);
+    }
+    BOOST_CHECK(gpc.nb_samples() == 86);
+    BOOST_CHECK(gpc.alpha().isApprox(gp.alpha(), 1e-8));
+    BOOST_CHECK_CLOSE(gpc.compute_log_lik(), gp.compute_log_lik(), 1e-6);
+    std::tie(mu, sigma) = gp.query_batch(X);
+    std::tie(muc, sigmac) = gpc.query_batch(X);
+    BOOST_CHECK(muc.isApprox(mu, 1e-8));
+    BOOST_CHECK((sigma - sigmac).cwiseAbs().maxCoeff() < 1e-8);
+}
+
+BOOST_AUTO_TEST_CASE(test_gp_tiled)
+{
+    using namespace limbo;
+
+    // tiled Cholesky and triangular solves (the size is not a multiple of the tiles)
+    Eigen::MatrixXd A = Eigen::MatrixXd::Random(107, 107);
+    A = A * A.transpose() + 107 * Eigen::MatrixXd::Identity(107, 107);
+    Eigen::MatrixXd L = A;
+    BOOST_CHECK(tools::tiled_llt(L, 16));
+    Eigen::MatrixXd L2 = Eigen::LLT<Eigen::MatrixXd>(A).matrixL();
+    BOOST_CHECK(L.triangularView<Eigen::Lower>().toDenseMatrix().isApprox(L2, 1e-10));
+
+    Eigen::MatrixXd B = Eigen::MatrixXd::Random(107, 5), X = B;
+    tools::tiled_lower_solve(L2, X, 16);
+    BOOST_CHECK((L2 * X).isApprox(B, 1e-10));
+    X = B;
+    tools::tiled_upper_solve(L2, X, 16);
+    BOOST_CHECK((L2.transpose() * X).isApprox(B, 1e-10));
+    Eigen::MatrixXd N = A;
+    N(50, 50) = -1;
+    BOOST_CHECK(!tools::tiled_llt(N, 16));
+
+    using KF_t = kernel::MaternFiveHalves<Params>;
+    using Mean_t = mean::Data<Params>;
+    using GP_t = model::GP<Params, KF_t, Mean_t>;
+    using GPt_t = model::GP<Params, KF_t, Mean_t, model::gp::NoLFOpt<Params>, model::gp::Tiled<model::gp::DoublePrecision, 16>>;
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 100; i++) {
+        samples.push_back(tools::random_vector(2));
+        observations.push_back(make_v1(std::cos(3 * samples[i](0)) + samples[i](1)));
+    }
+
+    GP_t gp;
+    gp.compute(samples, observations);
+    GPt_t gpt;
+    gpt.compute(samples, observations);
+    BOOST_CHECK(gpt.matrixL().isApprox(gp.matrixL(), 1e-8));
+    BOOST_CHECK(gpt.alpha().isApprox(gp.alpha(), 1e-8));
+
+    Eigen::MatrixXd S = Eigen::MatrixXd::Random(40, 2);
+    Eigen::MatrixXd O = S.col(0).array().cos().matrix();
+    gp.add_samples(S, O);
+    gpt.add_samples(S, O);
+    BOOST_CHECK(gpt.matrixL().isApprox(gp.matrixL(), 1e-8));
+    BOOST_CHECK(gpt.alpha().isApprox(gp.alpha(), 1e-8));
+    Eigen::MatrixXd T = Eigen::MatrixXd::Random(30, 2);
+    BOOST_CHECK((gpt.sigma_batch(T) - gp.sigma_batch(T)).cwiseAbs().maxCoeff() < 1e-8);
+    // single-point queries (one right-hand side, without the tiles)
+    BOOST_CHECK(std::abs(gpt.sigma(T.row(0).transpose()) - gp.sigma(T.row(0).transpose())) < 1e-8);
+    BOOST_CHECK(gpt.mu(T.row(0).transpose()).isApprox(gp.mu(T.row(0).transpose()), 1e-8));
+}
+
+BOOST_AUTO_TEST_CASE(test_gp_conjugate_gradient)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::SquaredExpARD<Params>;
+    using Mean_t = mean::Data<Params>;
+    using GP_t = model::GP<Params, KF_t, Mean_t>;
+    // small blocks; as many Lanczos steps as samples, so that the variance is exact
+    using GPcg_t = model::GP<Params, KF_t, Mean_t, model::gp::NoLFOpt<Params>, model::gp::ConjugateGradient<48, 64, 200, 16>>;
+
+    // (a fixed dataset: the accuracy of the stochastic estimates below depends on it)
+    tools::rgen_double_t rgen(0., 1., 42);
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 150; i++) {
+        samples.push_back(make_v2(rgen.rand(), rgen.rand()));
+        observations.push_back(make_v1(std::cos(3 * samples[i](0)) + samples[i](1)));
+    }
+
+    GP_t gp;
+    gp.compute(samples, observations);
+    GPcg_t gpcg;
+    gpcg.compute(samples, observations);
+
+    BOOST_CHECK(gpcg.matrixL().size() == 0);
+    BOOST_CHECK(gpcg.alpha().isApprox(gp.alpha(), 1e-6));
+    Eigen::MatrixXd X = Eigen::MatrixXd::Random(20, 2);
+    Eigen::MatrixXd mu, mucg;
+    Eigen::VectorXd sigma, sigmacg;
+    std::tie(mu, sigma) = gp.query_batch(X);
+    std::tie(mucg, sigmacg) = gpcg.query_batch(X);
+    BOOST_CHECK(mucg.isApprox(mu, 1e-6));
+    BOOST_CHECK((sigma - sigmacg).cwiseAbs().maxCoeff() < 1e-6);
+    BOOST_CHECK(std::abs(gpcg.sigma(X.row(0).transpose()) - sigma(0)) < 1e-6);
+    BOOST_CHECK((gpcg.posterior_cov(X) - gp.posterior_cov(X)).cwiseAbs().maxCoeff() < 1e-6);
+    Eigen::MatrixXd dmu, dmucg;
+    Eigen::VectorXd dsigma, dsigmacg;
+    std::tie(std::ignore, std::ignore, dmu, dsigma) = gp.query_grad(X.row(1).transpose());
+    std::tie(std::ignore, std::ignore, dmucg, dsigmacg) = gpcg.query_grad(X.row(1).transpose());
+    BOOST_CHECK(dmucg.isApprox(dmu, 1e-5));
+    BOOST_CHECK((dsigmacg - dsigma).cwiseAbs().maxCoeff() < 1e-5);
+
+    // stochastic log-determinant and gradient (the estimate is deterministic)
+    double lik = gp.compute_log_lik();
+    BOOST_CHECK(gpcg.compute_log_lik() == gpcg.compute_log_lik());
+    BOOST_CHECK(std::abs(gpcg.compute_log_lik() - lik) < 0.01 * std::abs(lik));
+    Eigen::VectorXd grad = gp.compute_kernel_grad_log_lik();
+    BOOST_CHECK((gpcg.compute_kernel_grad_log_lik() - grad).norm() < 0.05 * grad.norm());
+    BOOST_CHECK_CLOSE(gpcg.compute_log_loo_cv(), gp.compute_log_loo_cv(), 1e-4);
+
+    GPcg_t::LikelihoodWorkspace ws;
+    KF_t kernel_function = gp.kernel_function();
+    kernel_function.set_h_params(Eigen::VectorXd::Constant(kernel_function.h_params_size(), -0.5));
+    GP_t gp2(gp);
+    gp2.kernel_function() = kernel_function;
+    gp2.recompute(false);
+    lik = gp2.compute_log_lik();
+    grad = gp2.compute_kernel_grad_log_lik();
+    BOOST_CHECK(std::abs(gpcg.compute_log_lik(kernel_function, ws) - lik) < 0.01 * std::abs(lik));
+    BOOST_CHECK((gpcg.compute_kernel_grad_log_lik(kernel_function, ws) - grad).norm() < 0.05 * grad.norm());
+
+    // the hyper-parameters are optimized without any n x n matrix
+    using GPcgopt_t = model::GP<Params, KF_t, Mean_t, model::gp::KernelLFOpt<Params>, model::gp::ConjugateGradient<16, 16, 64, 16>>;
+    GPcgopt_t gpopt;
+    gpopt.compute(samples, observations);
+    double lik_before = gpopt.compute_log_lik();
+    gpopt.optimize_hyperparams();
+    BOOST_CHECK(gpopt.get_log_lik() > lik_before);
+
+    // incremental updates (warm-started)
+    Eigen::MatrixXd S = Eigen::MatrixXd::Random(21, 2), O = Eigen::MatrixXd::Random(21, 1);
+    gp.add_samples(S.topRows(20), O.topRows(20));
+    gpcg.add_samples(S.topRows(20), O.topRows(20));
+    gp.add_sample(S.row(20).transpose(), O.row(20).transpose());
+    gpcg.add_sample(S.row(20).transpose(), O.row(20).transpose());
+    for (int i : {160, 3, 40}) {
+        gp.remove_sample(i);
+        gpcg.remove_sample(i);
+    }
+    BOOST_CHECK(gpcg.nb_samples() == 168);
+    BOOST_CHECK(gpcg.alpha().isApprox(gp.alpha(), 1e-6));
+    std::tie(mu, sigma) = gp.query_batch(X);
+    std::tie(mucg, sigmacg) = gpcg.query_batch(X);
+    BOOST_CHECK(mucg.isApprox(mu, 1e-6));
+    BOOST_CHECK((sigma - sigmacg).cwiseAbs().maxCoeff() < 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(test_gp_concurrent_queries)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::MaternFiveHalves<Params>;
+    using Mean_t = mean::Data<Params>;
+    using GP_t = model::GP<Params, KF_t, Mean_t>;
+    using GPm_t = model::GP<Params, KF_t, Mean_t, model::gp::NoLFOpt<Params>, model::gp::Compact<model::gp::MixedPrecision, 16>>;
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 60; i++) {
+        samples.push_back(tools::random_vector(2));
+        observations.push_back(make_v2(std::cos(3 * samples[i](0)), samples[i](1)));
+    }
+
+    GP_t gp;
+    gp.compute(samples, observations);
+    GPm_t gpm;
+    gpm.compute(samples, observations);
+
+    Eigen::MatrixXd T = Eigen::MatrixXd::Random(200, 2);
+    Eigen::MatrixXd mu_ref, mum_ref;
+    Eigen::VectorXd sigma_ref, sigmam_ref;
+    std::tie(mu_ref, sigma_ref) = gp.query_batch(T);
+    std::tie(mum_ref, sigmam_ref) = gpm.query_batch(T);
+
+    // several threads query the same GPs (through the caller-buffer versions and the usual ones)
+    int nb_threads = 8;
+    std::vector<int> errors(nb_threads, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nb_threads; t++) {
+        threads.emplace_back([&, t]() {
+            Eigen::VectorXd mu(2);
+            double sigma;
+            for (int r = 0; r < 20; r++) {
+                for (int i = 0; i < T.rows(); i++) {
+                    Eigen::VectorXd x = T.row(i).transpose();
+                    gp.query(x, mu, sigma);
+                    if ((mu - mu_ref.row(i).transpose()).norm() > 1e-8 || std::abs(sigma - sigma_ref(i)) > 1e-8)
+                        errors[t]++;
+                    gpm.mu(x, mu);
+                    if ((mu - mum_ref.row(i).transpose()).norm() > 1e-5 || std::abs(gpm.sigma(x) - sigmam_ref(i)) > 1e-5)
+                        errors[t]++;
+                }
+            }
+        });
+    }
+    for (auto& th : threads)
+        th.join();
+
+    for (int t = 0; t < nb_threads; t++)
+        BOOST_CHECK_EQUAL(errors[t], 0);
+
+    // the functions that return by value give the same results
+    Eigen::VectorXd mu(2);
+    double sigma;
+    gp.query(T.row(0).transpose(), mu, sigma);
+    BOOST_CHECK(gp.mu(T.row(0).transpose()).isApprox(mu));
+    BOOST_CHECK(std::abs(gp.sigma(T.row(0).transpose()) - sigma) < 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(test_gp_query_grad)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::SquaredExpARD<Params>;
+    using Mean_t = mean::Data<Params>;
+    using GP_t = model::GP<Params, KF_t, Mean_t>;
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 30; i++) {
+        samples.push_back(tools::random_vector(3));
+        observations.push_back(make_v2(std::cos(3 * samples[i](0)) + samples[i](2), samples[i](1)));
+    }
+
+    GP_t gp;
+    gp.compute(samples, observations);
+
+    double e = 1e-6;
+    for (int t = 0; t < 10; t++) {
+        Eigen::VectorXd x = tools::random_vector(3);
+        Eigen::VectorXd mu, dsigma;
+        Eigen::MatrixXd dmu;
+        double sigma;
+        std::tie(mu, sigma, dmu, dsigma) = gp.query_grad(x);
+
+        Eigen::VectorXd mu_q;
+        double sigma_q;
+        std::tie(mu_q, sigma_q) = gp.query(x);
+        BOOST_CHECK(mu.isApprox(mu_q));
+        BOOST_CHECK_CLOSE(sigma, sigma_q, 1e-8);
+        BOOST_REQUIRE(dmu.rows() == 2 && dmu.cols() == 3 && dsigma.size() == 3);
+
+        for (int j = 0; j < 3; j++) {
+            Eigen::VectorXd x_p = x, x_m = x;
+            x_p(j) += e;
+            x_m(j) -= e;
+            Eigen::VectorXd dmu_fd = (gp.mu(x_p) - gp.mu(x_m)) / (2 * e);
+            double dsigma_fd = (gp.sigma(x_p) - gp.sigma(x_m)) / (2 * e);
+            BOOST_CHECK((dmu.col(j) - dmu_fd).norm() < 1e-5);
+            BOOST_CHECK(std::abs(dsigma(j) - dsigma_fd) < 1e-5);
+        }
+    }
+
+    // no sample: the derivatives of the prior
+    GP_t gp_empty(3, 2);
+    Eigen::VectorXd mu, dsigma;
+    Eigen::MatrixXd dmu;
+    double sigma;
+    std::tie(mu, sigma, dmu, dsigma) = gp_empty.query_grad(tools::random_vector(3));
+    BOOST_CHECK(dmu.norm() < 1e-12);
+    BOOST_CHECK(dsigma.norm() < 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(test_gp_posterior_samples)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::MaternFiveHalves<Params>;
+    using Mean_t = mean::Data<Params>;
+    using GP_t = model::GP<Params, KF_t, Mean_t>;
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 20; i++) {
+        samples.push_back(tools::random_vector(2));
+        observations.push_back(make_v1(std::cos(3 * samples[i](0)) + samples[i](1)));
+    }
+
+    GP_t gp;
+    gp.compute(samples, observations);
+
+    // joint covariance: diagonal given by sigma_batch() and covariances by the usual formula
+    Eigen::MatrixXd T = Eigen::MatrixXd::Random(6, 2);
+    Eigen::MatrixXd C = gp.posterior_cov(T);
+    BOOST_CHECK((C.diagonal() - gp.sigma_batch(T)).cwiseAbs().maxCoeff() < 1e-10);
+    Eigen::VectorXd k0 = gp.kernel_function().kernel_matrix(gp.samples_matrix(), T.row(0).transpose());
+    Eigen::VectorXd k1 = gp.kernel_function().kernel_matrix(gp.samples_matrix(), T.row(1).transpose());
+    Eigen::MatrixXd K = gp.kernel_function().kernel_matrix(gp.samples_matrix(), gp.samples_matrix());
+    K.diagonal().array() += gp.kernel_function().noise() + 1e-8;
+    double c01 = gp.kernel_function()(T.row(0).transpose(), T.row(1).transpose()) - k0.dot(K.llt().solve(k1));
+    BOOST_CHECK_SMALL(C(0, 1) - c01, 1e-8);
+
+    // exact draws: empirical mean and covariance
+    tools::rgen_gauss_t rgen(0., 1., 42);
+    int n_draws = 20000;
+    std::vector<Eigen::MatrixXd> draws = gp.sample_posterior(T, n_draws, rgen);
+    BOOST_REQUIRE(draws.size() == size_t(n_draws));
+    Eigen::MatrixXd D(T.rows(), n_draws);
+    for (int i = 0; i < n_draws; i++)
+        D.col(i) = draws[i].col(0);
+    Eigen::VectorXd mean = D.rowwise().mean();
+    Eigen::MatrixXd centered = D.colwise() - mean;
+    Eigen::MatrixXd C_emp = centered * centered.transpose() / (n_draws - 1);
+    BOOST_CHECK((mean - gp.mu_batch(T).col(0)).cwiseAbs().maxCoeff() < 5 * std::sqrt(C.diagonal().maxCoeff() / n_draws));
+    BOOST_CHECK((C_emp - C).cwiseAbs().maxCoeff() < 0.05 * C.diagonal().maxCoeff());
+
+    // low-rank and pathwise draws for more points than the exact limit
+    Eigen::MatrixXd T2 = Eigen::MatrixXd::Random(400, 2);
+    n_draws = 4000;
+    draws = gp.sample_posterior(T2, n_draws, rgen, 100);
+    D.resize(T2.rows(), n_draws);
+    for (int i = 0; i < n_draws; i++)
+        D.col(i) = draws[i].col(0);
+    mean = D.rowwise().mean();
+    Eigen::VectorXd var = (D.colwise() - mean).rowwise().squaredNorm() / (n_draws - 1);
+    Eigen::VectorXd sigma = gp.sigma_batch(T2);
+    BOOST_CHECK((mean - gp.mu_batch(T2).col(0)).cwiseAbs().maxCoeff() < 5 * std::sqrt(sigma.maxCoeff() / n_draws));
+    BOOST_CHECK(((var - sigma).array() / sigma.array()).abs().maxCoeff() < 0.15);
+}
+
 BOOST_AUTO_TEST_CASE(test_gp_identical_samples)
 {
     using namespace limbo;
@@ -757,6 +1512,432 @@ BOOST_AUTO_TEST_CASE(test_gp_init_variance)
     BOOST_CHECK_CLOSE(sigma, 10.0, 1);
 }
 
+struct ParamsRFF : public Params {
+    struct kernel : public defaults::kernel {
+        BO_PARAM(bool, optimize_noise, true);
+    };
+
+    struct model_rff_gp : public defaults::model_rff_gp {
+        BO_PARAM(int, features, 1000);
+        BO_PARAM(int, seed, 1);
+    };
+};
+
+BOOST_AUTO_TEST_CASE(test_rff_gp)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::SquaredExpARD<ParamsRFF>;
+    using Mean_t = mean::Data<ParamsRFF>;
+    using GP_t = model::GP<ParamsRFF, KF_t, Mean_t>;
+    using RFF_t = model::RFFGP<ParamsRFF, KF_t, Mean_t>;
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 40; i++) {
+        samples.push_back(tools::random_vector(2));
+        observations.push_back(make_v1(std::cos(3 * samples[i](0)) + samples[i](1)));
+    }
+
+    GP_t gp;
+    gp.compute(samples, observations);
+    RFF_t rff;
+    rff.compute(samples, observations);
+    BOOST_CHECK(rff.nb_samples() == 40);
+    BOOST_CHECK(rff.nb_features() == 1000);
+
+    // close to the exact GP with many features
+    for (int t = 0; t < 20; t++) {
+        Eigen::VectorXd x = tools::random_vector(2);
+        Eigen::VectorXd mu, mu_gp;
+        double sigma, sigma_gp;
+        std::tie(mu, sigma) = rff.query(x);
+        std::tie(mu_gp, sigma_gp) = gp.query(x);
+        BOOST_CHECK(std::abs(mu(0) - mu_gp(0)) < 0.05);
+        BOOST_CHECK(std::abs(sigma - sigma_gp) < 0.05);
+        BOOST_CHECK(rff.mu(x).isApprox(mu));
+        BOOST_CHECK_CLOSE(rff.sigma(x), sigma, 1e-8);
+    }
+
+    // incremental updates give the same model as a full computation (same frequencies)
+    RFF_t rff_inc;
+    for (size_t i = 0; i < samples.size(); i++)
+        rff_inc.add_sample(samples[i], observations[i]);
+    Eigen::VectorXd x = tools::random_vector(2);
+    BOOST_CHECK((rff_inc.mu(x) - rff.mu(x)).norm() < 1e-8);
+    BOOST_CHECK(std::abs(rff_inc.sigma(x) - rff.sigma(x)) < 1e-8);
+
+    // sampled functions: their mean and variance are the ones of the model
+    tools::rgen_gauss_t rgen(0., 1., 42);
+    int n_draws = 2000;
+    Eigen::VectorXd values(n_draws);
+    for (int i = 0; i < n_draws; i++)
+        values(i) = rff.sample_value(x, rff.sample_weights(rgen))(0);
+    double var = (values.array() - values.mean()).square().sum() / (n_draws - 1);
+    double var_model = rff.sigma(x) - rff.kernel_function().noise();
+    BOOST_CHECK(std::abs(values.mean() - rff.mu(x)(0)) < 5 * std::sqrt(var_model / n_draws));
+    BOOST_CHECK(std::abs(var - var_model) < 0.2 * var_model);
+}
+
+struct ParamsRFFSmall : public ParamsRFF {
+    struct model_rff_gp : public defaults::model_rff_gp {
+        BO_PARAM(int, features, 100);
+        BO_PARAM(int, seed, 1);
+    };
+};
+
+BOOST_AUTO_TEST_CASE(test_rff_gp_lf_grad)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::MaternFiveHalves<ParamsRFFSmall>;
+    using KFard_t = kernel::SquaredExpARD<ParamsRFFSmall>;
+    using Mean_t = mean::Data<ParamsRFFSmall>;
+    using RFF_t = model::RFFGP<ParamsRFFSmall, KF_t, Mean_t>;
+    using RFFard_t = model::RFFGP<ParamsRFFSmall, KFard_t, Mean_t, model::gp::KernelLFOpt<ParamsRFFSmall>>;
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 50; i++) {
+        samples.push_back(tools::random_vector(2));
+        observations.push_back(make_v1(std::cos(3 * samples[i](0)) + samples[i](1)));
+    }
+
+    RFF_t rff;
+    rff.compute(samples, observations);
+    RFFard_t rff_ard;
+    rff_ard.compute(samples, observations);
+
+    for (int t = 0; t < 5; t++) {
+        double error;
+        Eigen::VectorXd analytic, finite_diff;
+        Eigen::VectorXd p = tools::random_vector(rff.kernel_function().h_params_size()).array() * 2. - 1.;
+        std::tie(error, analytic, finite_diff) = check_model_lik_grad(rff, p, 1e-5);
+        BOOST_CHECK(error < 1e-3 * std::max(1., finite_diff.norm()));
+
+        p = tools::random_vector(rff_ard.kernel_function().h_params_size()).array() * 2. - 1.;
+        std::tie(error, analytic, finite_diff) = check_model_lik_grad(rff_ard, p, 1e-5);
+        BOOST_CHECK(error < 1e-3 * std::max(1., finite_diff.norm()));
+    }
+
+    // the optimization of the hyper-parameters improves the likelihood
+    double lik_before = rff_ard.compute_log_lik();
+    rff_ard.optimize_hyperparams();
+    BOOST_CHECK(rff_ard.get_log_lik() > lik_before);
+}
+
+struct ParamsInducing : public Params {
+    struct kernel : public defaults::kernel {
+        BO_PARAM(bool, optimize_noise, true);
+    };
+
+    struct model_inducing_gp : public defaults::model_inducing_gp {
+        BO_PARAM(int, inducing_points, 30);
+    };
+};
+
+BOOST_AUTO_TEST_CASE(test_inducing_gp)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::SquaredExpARD<ParamsInducing>;
+    using Mean_t = mean::Data<ParamsInducing>;
+    using GP_t = model::GP<ParamsInducing, KF_t, Mean_t>;
+    using FITC_t = model::InducingGP<ParamsInducing, KF_t, Mean_t>;
+    using VFE_t = model::InducingGP<ParamsInducing, KF_t, Mean_t, model::gp::NoLFOpt<ParamsInducing>, model::inducing_gp::VFE>;
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 200; i++) {
+        samples.push_back(tools::random_vector(2));
+        observations.push_back(make_v1(std::cos(3 * samples[i](0)) + samples[i](1)));
+    }
+
+    // with fewer samples than inducing points, the model is an exact GP
+    GP_t gp;
+    FITC_t fitc;
+    VFE_t vfe;
+    for (int i = 0; i < 20; i++) {
+        gp.add_sample(samples[i], observations[i]);
+        fitc.add_sample(samples[i], observations[i]);
+        vfe.add_sample(samples[i], observations[i]);
+    }
+    BOOST_CHECK(fitc.inducing_points().cols() == 20);
+    BOOST_CHECK(std::abs(fitc.compute_log_lik() - gp.compute_log_lik()) < 1e-3);
+    BOOST_CHECK(std::abs(vfe.compute_log_lik() - gp.get_log_lik()) < 1e-3);
+    for (int t = 0; t < 10; t++) {
+        Eigen::VectorXd x = tools::random_vector(2);
+        BOOST_CHECK(std::abs(fitc.mu(x)(0) - gp.mu(x)(0)) < 1e-4);
+        BOOST_CHECK(std::abs(fitc.sigma(x) - gp.sigma(x)) < 1e-4);
+        BOOST_CHECK(std::abs(vfe.mu(x)(0) - gp.mu(x)(0)) < 1e-4);
+        BOOST_CHECK(std::abs(vfe.sigma(x) - gp.sigma(x)) < 1e-4);
+    }
+
+    // with more samples, the inducing points are fixed: the incremental updates are exact
+    for (int i = 20; i < 200; i++) {
+        gp.add_sample(samples[i], observations[i]);
+        fitc.add_sample(samples[i], observations[i]);
+        vfe.add_sample(samples[i], observations[i]);
+    }
+    BOOST_CHECK(fitc.nb_samples() == 200);
+    BOOST_CHECK(fitc.inducing_points().cols() == 30);
+    BOOST_CHECK(fitc.inducing_points().col(0) == samples[0]);
+    BOOST_CHECK(fitc.inducing_points().col(29) == samples[29]);
+    FITC_t fitc_full = fitc;
+    fitc_full.recompute();
+    VFE_t vfe_full = vfe;
+    vfe_full.recompute();
+    for (int t = 0; t < 10; t++) {
+        Eigen::VectorXd x = tools::random_vector(2);
+        BOOST_CHECK(std::abs(fitc.mu(x)(0) - fitc_full.mu(x)(0)) < 1e-8);
+        BOOST_CHECK(std::abs(fitc.sigma(x) - fitc_full.sigma(x)) < 1e-8);
+        BOOST_CHECK(std::abs(vfe.mu(x)(0) - vfe_full.mu(x)(0)) < 1e-8);
+        BOOST_CHECK(std::abs(vfe.sigma(x) - vfe_full.sigma(x)) < 1e-8);
+    }
+
+    // the selected inducing points give predictions close to the exact GP, and the VFE likelihood is a lower bound
+    fitc.update_inducing();
+    vfe.update_inducing();
+    BOOST_CHECK(fitc.inducing_points().cols() == 30);
+    BOOST_CHECK(vfe.compute_log_lik() < gp.compute_log_lik());
+    Eigen::MatrixXd X(50, 2);
+    for (int t = 0; t < X.rows(); t++)
+        X.row(t) = tools::random_vector(2).transpose();
+    Eigen::MatrixXd mu;
+    Eigen::VectorXd sigma;
+    std::tie(mu, sigma) = fitc.query_batch(X);
+    for (int t = 0; t < X.rows(); t++) {
+        Eigen::VectorXd x = X.row(t).transpose();
+        BOOST_CHECK(std::abs(mu(t, 0) - fitc.mu(x)(0)) < 1e-10);
+        BOOST_CHECK(std::abs(sigma(t) - fitc.sigma(x)) < 1e-10);
+        BOOST_CHECK(std::abs(mu(t, 0) - gp.mu(x)(0)) < 0.05);
+        BOOST_CHECK(std::abs(vfe.mu(x)(0) - gp.mu(x)(0)) < 0.05);
+        BOOST_CHECK(std::abs(vfe.sigma(x) - gp.sigma(x)) < 0.01);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_inducing_gp_lf_grad)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::MaternFiveHalves<ParamsInducing>;
+    using KFard_t = kernel::SquaredExpARD<ParamsInducing>;
+    using Mean_t = mean::Data<ParamsInducing>;
+    using FITC_t = model::InducingGP<ParamsInducing, KF_t, Mean_t>;
+    using VFE_t = model::InducingGP<ParamsInducing, KF_t, Mean_t, model::gp::NoLFOpt<ParamsInducing>, model::inducing_gp::VFE>;
+    using FITCard_t = model::InducingGP<ParamsInducing, KFard_t, Mean_t, model::gp::KernelLFOpt<ParamsInducing>>;
+    using VFEard_t = model::InducingGP<ParamsInducing, KFard_t, Mean_t, model::gp::KernelLFOpt<ParamsInducing>, model::inducing_gp::VFE>;
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 100; i++) {
+        samples.push_back(tools::random_vector(2));
+        observations.push_back(make_v1(std::cos(3 * samples[i](0)) + samples[i](1)));
+    }
+
+    FITC_t fitc;
+    fitc.compute(samples, observations);
+    VFE_t vfe;
+    vfe.compute(samples, observations);
+    FITCard_t fitc_ard;
+    fitc_ard.compute(samples, observations);
+    VFEard_t vfe_ard;
+    vfe_ard.compute(samples, observations);
+
+    for (int t = 0; t < 5; t++) {
+        double error;
+        Eigen::VectorXd analytic, finite_diff;
+        Eigen::VectorXd p = tools::random_vector(fitc.kernel_function().h_params_size()).array() * 2. - 1.;
+        std::tie(error, analytic, finite_diff) = check_model_lik_grad(fitc, p, 1e-5);
+        BOOST_CHECK(error < 1e-3 * std::max(1., finite_diff.norm()));
+        std::tie(error, analytic, finite_diff) = check_model_lik_grad(vfe, p, 1e-5);
+        BOOST_CHECK(error < 1e-3 * std::max(1., finite_diff.norm()));
+
+        p = tools::random_vector(fitc_ard.kernel_function().h_params_size()).array() * 2. - 1.;
+        std::tie(error, analytic, finite_diff) = check_model_lik_grad(fitc_ard, p, 1e-5);
+        BOOST_CHECK(error < 1e-3 * std::max(1., finite_diff.norm()));
+        std::tie(error, analytic, finite_diff) = check_model_lik_grad(vfe_ard, p, 1e-5);
+        BOOST_CHECK(error < 1e-3 * std::max(1., finite_diff.norm()));
+    }
+
+    // the optimization of the hyper-parameters improves the likelihood
+    double lik_before = fitc_ard.compute_log_lik();
+    fitc_ard.optimize_hyperparams();
+    BOOST_CHECK(fitc_ard.get_log_lik() > lik_before);
+    lik_before = vfe_ard.compute_log_lik();
+    vfe_ard.optimize_hyperparams();
+    BOOST_CHECK(vfe_ard.get_log_lik() > lik_before);
+}
+
+struct ParamsKISS : public Params {
+    struct model_kiss_gp : public defaults::model_kiss_gp {
+    };
+};
+
+BOOST_AUTO_TEST_CASE(test_kiss_gp)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::MaternFiveHalves<ParamsKISS>;
+    using Mean_t = mean::Data<ParamsKISS>;
+    using GP_t = model::GP<ParamsKISS, KF_t, Mean_t>;
+    using KISS_t = model::KISSGP<ParamsKISS, KF_t, Mean_t>;
+
+    // 1-D: the interpolation and the Lanczos decomposition are (almost) exact
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 300; i++) {
+        samples.push_back(tools::random_vector(1));
+        observations.push_back(make_v1(std::cos(10 * samples[i](0))));
+    }
+
+    GP_t gp;
+    gp.compute(samples, observations);
+    KISS_t kiss;
+    kiss.compute(samples, observations);
+    BOOST_CHECK(kiss.grid_size() == 128);
+    for (int t = 0; t < 50; t++) {
+        Eigen::VectorXd x = tools::random_vector(1);
+        Eigen::VectorXd mu;
+        double sigma;
+        std::tie(mu, sigma) = kiss.query(x);
+        BOOST_CHECK(std::abs(mu(0) - gp.mu(x)(0)) < 1e-4);
+        BOOST_CHECK(std::abs(sigma - gp.sigma(x)) < 1e-4);
+        BOOST_CHECK(mu == kiss.mu(x));
+        BOOST_CHECK(sigma == kiss.sigma(x));
+    }
+
+    // 2-D, with a kernel that is not separable (block-Toeplitz kernel matrix of the grid)
+    samples.clear();
+    observations.clear();
+    for (int i = 0; i < 200; i++) {
+        samples.push_back(tools::random_vector(2));
+        observations.push_back(make_v1(std::cos(3 * samples[i](0)) + samples[i](1)));
+    }
+    gp.compute(samples, observations);
+    kiss.compute(samples, observations);
+    BOOST_CHECK(kiss.grid_size() == 128);
+    for (int t = 0; t < 50; t++) {
+        Eigen::VectorXd x = tools::random_vector(2);
+        BOOST_CHECK(std::abs(kiss.mu(x)(0) - gp.mu(x)(0)) < 1e-3);
+        // the Lanczos approximation can only over-estimate the variance
+        BOOST_CHECK(kiss.sigma(x) > gp.sigma(x) - 1e-4);
+        BOOST_CHECK(kiss.sigma(x) < gp.sigma(x) + 1e-2);
+    }
+
+    // the previous solution is the initial guess of the conjugate gradients
+    int iterations = kiss.nb_cg_iterations();
+    Eigen::VectorXd x = tools::random_vector(2);
+    kiss.add_sample(x, make_v1(std::cos(3 * x(0)) + x(1)));
+    samples.push_back(x);
+    observations.push_back(make_v1(std::cos(3 * x(0)) + x(1)));
+    BOOST_CHECK(kiss.nb_samples() == 201);
+    BOOST_CHECK(kiss.nb_cg_iterations() < iterations);
+    KISS_t kiss_full;
+    kiss_full.compute(samples, observations);
+    for (int t = 0; t < 20; t++) {
+        Eigen::VectorXd x = tools::random_vector(2);
+        BOOST_CHECK(std::abs(kiss.mu(x)(0) - kiss_full.mu(x)(0)) < 1e-6);
+    }
+}
+
+struct ParamsLocal : public Params {
+    struct model_local_gp : public defaults::model_local_gp {
+        BO_PARAM(int, leaf_size, 50);
+        BO_PARAM(int, nb_experts, 3);
+    };
+};
+
+BOOST_AUTO_TEST_CASE(test_local_gp)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::MaternFiveHalves<ParamsLocal>;
+    using Mean_t = mean::Data<ParamsLocal>;
+    using GP_t = model::GP<ParamsLocal, KF_t, Mean_t>;
+    using Local_t = model::LocalGP<ParamsLocal, KF_t, Mean_t>;
+    using RBCM_t = model::LocalGP<ParamsLocal, KF_t, Mean_t, model::gp::NoLFOpt<ParamsLocal>, model::local_gp::RBCM>;
+
+    // a single leaf: the expert is the full GP
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 40; i++) {
+        samples.push_back(tools::random_vector(2));
+        observations.push_back(make_v1(std::cos(3 * samples[i](0)) + samples[i](1)));
+    }
+    GP_t gp;
+    gp.compute(samples, observations);
+    Local_t local;
+    local.compute(samples, observations);
+    BOOST_CHECK(local.experts().size() == 1);
+    for (int t = 0; t < 20; t++) {
+        Eigen::VectorXd x = tools::random_vector(2);
+        Eigen::VectorXd mu;
+        double sigma;
+        std::tie(mu, sigma) = local.query(x);
+        BOOST_CHECK(std::abs(mu(0) - gp.mu(x)(0)) < 1e-10);
+        BOOST_CHECK(std::abs(sigma - gp.sigma(x)) < 1e-10);
+    }
+
+    // several leaves, that are (almost) balanced
+    for (int i = 40; i < 400; i++) {
+        samples.push_back(tools::random_vector(2));
+        observations.push_back(make_v1(std::cos(3 * samples[i](0)) + samples[i](1)));
+    }
+    gp.compute(samples, observations);
+    local.compute(samples, observations);
+    BOOST_CHECK(local.nb_samples() == 400);
+    BOOST_CHECK(local.experts().size() == 8);
+    for (const auto& expert : local.experts())
+        BOOST_CHECK(expert.nb_samples() <= local.leaf_size() && expert.nb_samples() >= local.leaf_size() / 2);
+
+    // close to the full GP (the largest errors are at the boundaries of the leaves)
+    double error = 0;
+    for (int t = 0; t < 100; t++) {
+        Eigen::VectorXd x = tools::random_vector(2);
+        error += std::abs(local.mu(x)(0) - gp.mu(x)(0)) / 100;
+        BOOST_CHECK(std::abs(local.mu(x)(0) - gp.mu(x)(0)) < 0.2);
+        BOOST_CHECK(local.sigma(x) > 0);
+        BOOST_CHECK(std::abs(local.mu(samples[t])(0) - observations[t](0)) < 0.1);
+    }
+    BOOST_CHECK(error < 0.02);
+    Eigen::MatrixXd X = Eigen::MatrixXd::Random(10, 2).cwiseAbs();
+    Eigen::MatrixXd mu;
+    Eigen::VectorXd sigma;
+    std::tie(mu, sigma) = local.query_batch(X);
+    for (int i = 0; i < X.rows(); i++) {
+        BOOST_CHECK((mu.row(i).transpose() - local.mu(X.row(i).transpose())).norm() < 1e-12);
+        BOOST_CHECK(std::abs(sigma(i) - local.sigma(X.row(i).transpose())) < 1e-12);
+    }
+
+    // the robust BCM goes back to the prior far from the samples
+    RBCM_t rbcm;
+    rbcm.compute(samples, observations);
+    Eigen::VectorXd far = make_v2(10, 10);
+    BOOST_CHECK(std::abs(rbcm.sigma(far) - gp.sigma(far)) < 1e-6);
+    BOOST_CHECK(std::abs(rbcm.mu(far)(0) - gp.mu(far)(0)) < 1e-6);
+    error = 0;
+    for (int t = 0; t < 100; t++) {
+        Eigen::VectorXd x = tools::random_vector(2);
+        error += std::abs(rbcm.mu(x)(0) - gp.mu(x)(0)) / 100;
+    }
+    BOOST_CHECK(error < 0.03);
+
+    // add_sample only changes one expert, and splits the leaves that become too large
+    Local_t incremental;
+    for (size_t i = 0; i < samples.size(); i++)
+        incremental.add_sample(samples[i], observations[i]);
+    BOOST_CHECK(incremental.nb_samples() == 400);
+    BOOST_CHECK(incremental.experts().size() > 8);
+    int total = 0;
+    for (const auto& expert : incremental.experts()) {
+        BOOST_CHECK(expert.nb_samples() <= incremental.leaf_size());
+        total += expert.nb_samples();
+    }
+    BOOST_CHECK(total == 400);
+    BOOST_CHECK(std::abs(incremental.mean_observation()(0) - gp.mean_observation()(0)) < 1e-10);
+    error = 0;
+    for (int t = 0; t < 100; t++) {
+        Eigen::VectorXd x = tools::random_vector(2);
+        error += std::abs(incremental.mu(x)(0) - gp.mu(x)(0)) / 100;
+    }
+    BOOST_CHECK(error < 0.02);
+}
+
 BOOST_AUTO_TEST_CASE(test_sparse_gp)
 {
     using namespace limbo;
@@ -1154,3 +2335,258 @@ BOOST_AUTO_TEST_CASE(test_multi_gp_recompute)
     BOOST_CHECK(gp.gp_models()[0]._observations.row(0)[0] == (2. - gp.mean_function().h_params()[0]));
     BOOST_CHECK(gp.gp_models()[0]._observations.row(1)[0] == (10. - gp.mean_function().h_params()[0]));
 }
+
+// the batched and single-point queries of a shared MultiGP are the ones of independent GPs
+template <typename Multi, typename MultiGP>
+void check_multi_gp_queries(const Multi& multi, const MultiGP& gp)
+{
+    // (several blocks of points for the batched queries)
+    Eigen::MatrixXd X = Eigen::MatrixXd::Random(300, 2).cwiseAbs();
+    Eigen::MatrixXd mu_batch, sigma_batch;
+    std::tie(mu_batch, sigma_batch) = multi.query_batch(X);
+    BOOST_CHECK((mu_batch - gp.mu_batch(X)).norm() < 1e-8);
+    BOOST_CHECK((sigma_batch - gp.sigma_batch(X)).norm() < 1e-8);
+    BOOST_CHECK((multi.mu_batch(X) - mu_batch).norm() < 1e-10);
+    BOOST_CHECK((multi.sigma_batch(X) - sigma_batch).norm() < 1e-10);
+    for (int i = 0; i < X.rows(); i++) {
+        Eigen::VectorXd x = X.row(i).transpose();
+        Eigen::VectorXd mu, sigma;
+        std::tie(mu, sigma) = multi.query(x);
+        BOOST_CHECK((mu - gp.mu(x)).norm() < 1e-8);
+        BOOST_CHECK((sigma - gp.sigma(x)).norm() < 1e-8);
+        BOOST_CHECK((multi.mu(x) - mu).norm() < 1e-10);
+        BOOST_CHECK((multi.sigma(x) - sigma).norm() < 1e-10);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_multi_gp_shared)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::SquaredExpARD<Params>;
+    using Mean_t = mean::Data<Params>;
+    using MultiGP_t = model::MultiGP<Params, model::GP, KF_t, Mean_t>;
+    using SharedGP_t = model::MultiGP<Params, model::GP, KF_t, Mean_t, model::gp::NoLFOpt<Params>, model::multi_gp::SharedIfIdentical>;
+    using ForcedGP_t = model::MultiGP<Params, model::GP, KF_t, Mean_t, model::gp::NoLFOpt<Params>, model::multi_gp::Shared>;
+    using OptGP_t = model::MultiGP<Params, model::GP, KF_t, Mean_t, model::multi_gp::ParallelLFOpt<Params, model::gp::KernelLFOpt<Params>>, model::multi_gp::SharedIfIdentical>;
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 50; i++) {
+        samples.push_back(tools::random_vector(2));
+        observations.push_back(make_v3(std::cos(3 * samples[i](0)), samples[i](1), samples[i](0) * samples[i](1)));
+    }
+
+    MultiGP_t gp;
+    gp.compute(samples, observations);
+    SharedGP_t shared;
+    shared.compute(samples, observations);
+    BOOST_CHECK(!gp.shared());
+    BOOST_CHECK(shared.shared());
+    BOOST_CHECK(shared.samples().size() == 50);
+
+    check_multi_gp_queries(shared, gp);
+
+    // incremental updates of the shared factorization
+    for (int i = 0; i < 5; i++) {
+        Eigen::VectorXd x = tools::random_vector(2);
+        Eigen::VectorXd y = make_v3(std::cos(3 * x(0)), x(1), x(0) * x(1));
+        gp.add_sample(x, y);
+        shared.add_sample(x, y);
+    }
+    BOOST_CHECK(shared.nb_samples() == 55);
+    check_multi_gp_queries(shared, gp);
+
+    // (the mean function is evaluated when each sample is added)
+    SharedGP_t incremental;
+    MultiGP_t gp_incremental;
+    for (size_t i = 0; i < samples.size(); i++) {
+        incremental.add_sample(samples[i], observations[i]);
+        gp_incremental.add_sample(samples[i], observations[i]);
+    }
+    BOOST_CHECK(incremental.shared());
+    check_multi_gp_queries(incremental, gp_incremental);
+    gp.compute(samples, observations);
+
+    // different hyper-parameters: the outputs cannot share a GP anymore (unless it is forced)
+    ForcedGP_t forced;
+    forced.compute(samples, observations);
+    Eigen::VectorXd h_params = shared.gp_models()[1].kernel_function().h_params();
+    shared.compute(samples, observations);
+    shared.gp_models()[1].kernel_function().set_h_params(h_params.array() + 0.5);
+    shared.recompute(false);
+    BOOST_CHECK(!shared.shared());
+    forced.gp_models()[1].kernel_function().set_h_params(h_params.array() + 0.5);
+    forced.recompute(false);
+    BOOST_CHECK(forced.shared());
+    check_multi_gp_queries(forced, gp);
+    gp.gp_models()[1].kernel_function().set_h_params(h_params.array() + 0.5);
+    gp.recompute(false);
+    check_multi_gp_queries(shared, gp);
+
+    // the hyper-parameters of each output are optimized on its own data
+    OptGP_t opt;
+    opt.compute(samples, observations);
+    BOOST_CHECK(opt.shared());
+    opt.optimize_hyperparams();
+    BOOST_CHECK(!opt.shared());
+    BOOST_CHECK(opt.gp_models()[0].nb_samples() == 50);
+}
+
+struct ParamsCoregionalized : public Params {
+    struct kernel : public defaults::kernel {
+        BO_PARAM(double, noise, 0.01);
+        BO_PARAM(bool, optimize_noise, true);
+    };
+
+    struct model_coregionalized_gp : public defaults::model_coregionalized_gp {
+        BO_PARAM(int, rank, 2);
+    };
+};
+
+BOOST_AUTO_TEST_CASE(test_coregionalized_gp)
+{
+    using namespace limbo;
+
+    using KF_t = kernel::SquaredExpARD<ParamsCoregionalized>;
+    using Mean_t = mean::Data<ParamsCoregionalized>;
+    using GP_t = model::GP<ParamsCoregionalized, KF_t, Mean_t>;
+    using CoGP_t = model::CoregionalizedGP<ParamsCoregionalized, KF_t, Mean_t>;
+
+    std::vector<Eigen::VectorXd> observations, samples;
+    for (int i = 0; i < 30; i++) {
+        samples.push_back(tools::random_vector(2));
+        double f = std::cos(3 * samples[i](0)) + samples[i](1);
+        observations.push_back(make_v3(f, -2 * f + 0.1 * samples[i](0), samples[i](0) * samples[i](1)));
+    }
+
+    CoGP_t cogp;
+    cogp.compute(samples, observations);
+    BOOST_CHECK(cogp.dim_in() == 2);
+    BOOST_CHECK(cogp.dim_out() == 3);
+    BOOST_CHECK(cogp.coregionalization_params().size() == 3 * 2 + 3);
+
+    // with B = I, the outputs are independent GPs with the same kernel
+    Eigen::VectorXd params = Eigen::VectorXd::Zero(9);
+    cogp.set_coregionalization_params(params);
+    cogp.recompute(false);
+    BOOST_CHECK((cogp.coregionalization_matrix() - Eigen::MatrixXd::Identity(3, 3)).norm() < 1e-12);
+    GP_t gp;
+    gp.compute(samples, observations);
+    // (the log-likelihood of the multi-output GP counts the log-determinant once)
+    double lik_independent = 0;
+    for (int j = 0; j < 3; j++) {
+        std::vector<Eigen::VectorXd> obs_j;
+        for (auto& o : observations)
+            obs_j.push_back(make_v1(o(j)));
+        GP_t gp_j;
+        gp_j.compute(samples, obs_j);
+        lik_independent += gp_j.compute_log_lik();
+    }
+    BOOST_CHECK_CLOSE(cogp.compute_log_lik(), lik_independent, 1e-4);
+    Eigen::MatrixXd X = Eigen::MatrixXd::Random(20, 2);
+    for (int i = 0; i < X.rows(); i++) {
+        Eigen::VectorXd x = X.row(i).transpose();
+        Eigen::VectorXd mu, sigma;
+        std::tie(mu, sigma) = cogp.query(x);
+        BOOST_CHECK((mu - gp.mu(x)).norm() < 1e-6);
+        BOOST_CHECK((sigma.array() - gp.sigma(x)).matrix().norm() < 1e-6);
+    }
+
+    // for a general B, compare with the stacked (np x np) GP
+    params = Eigen::VectorXd::Random(9);
+    cogp.set_coregionalization_params(params);
+    cogp.recompute(false);
+    const Eigen::MatrixXd& B = cogp.coregionalization_matrix();
+    Eigen::MatrixXd S = cogp.samples_matrix();
+    Eigen::MatrixXd K = cogp.kernel_function().kernel_matrix(S, S);
+    int n = S.cols(), p = 3;
+    Eigen::MatrixXd Sigma(n * p, n * p);
+    for (int j = 0; j < p; j++)
+        for (int l = 0; l < p; l++)
+            Sigma.block(j * n, l * n, n, n) = B(j, l) * K;
+    Sigma.diagonal().array() += cogp.kernel_function().noise() + 1e-8;
+    Eigen::MatrixXd Y = cogp.observations_matrix();
+    Y.rowwise() -= cogp.mean_observation().transpose();
+    Eigen::VectorXd y = Eigen::Map<Eigen::VectorXd>(Y.data(), n * p);
+    Eigen::LLT<Eigen::MatrixXd> llt(Sigma);
+    Eigen::VectorXd alpha = llt.solve(y);
+    double lik = -0.5 * y.dot(alpha) - llt.matrixL().toDenseMatrix().diagonal().array().log().sum() - 0.5 * n * p * std::log(2 * M_PI);
+    BOOST_CHECK_CLOSE(cogp.compute_log_lik(), lik, 1e-6);
+
+    Eigen::MatrixXd mu_batch, sigma_batch;
+    std::tie(mu_batch, sigma_batch) = cogp.query_batch(X);
+    BOOST_CHECK((cogp.mu_batch(X) - mu_batch).norm() < 1e-10);
+    BOOST_CHECK((cogp.sigma_batch(X) - sigma_batch).norm() < 1e-10);
+    for (int i = 0; i < X.rows(); i++) {
+        Eigen::VectorXd x = X.row(i).transpose();
+        Eigen::MatrixXd k_star(n * p, p);
+        Eigen::VectorXd k = cogp.kernel_function().kernel_matrix(S, x);
+        for (int j = 0; j < p; j++)
+            for (int l = 0; l < p; l++)
+                k_star.block(j * n, l, n, 1) = B(j, l) * k;
+        Eigen::VectorXd mu = cogp.mean_observation() + k_star.transpose() * alpha;
+        Eigen::VectorXd sigma = (B.diagonal() * cogp.kernel_function()(x, x) - (k_star.transpose() * llt.solve(k_star)).diagonal()).array() + cogp.kernel_function().noise();
+
+        Eigen::VectorXd mu_q, sigma_q;
+        std::tie(mu_q, sigma_q) = cogp.query(x);
+        BOOST_CHECK((mu_q - mu).norm() < 1e-6);
+        BOOST_CHECK((sigma_q - sigma).norm() < 1e-6);
+        BOOST_CHECK((cogp.mu(x) - mu).norm() < 1e-6);
+        BOOST_CHECK((cogp.sigma(x) - sigma).norm() < 1e-6);
+        BOOST_CHECK((mu_batch.row(i).transpose() - mu).norm() < 1e-6);
+        BOOST_CHECK((sigma_batch.row(i).transpose() - sigma).norm() < 1e-6);
+    }
+
+    // the gradient of the likelihood wrt the kernel and the coregionalization parameters
+    auto f = [&](const Eigen::VectorXd& theta, bool compute_grad) -> opt::eval_t {
+        KF_t kf = cogp.kernel_function();
+        int nb_params = kf.h_params_size();
+        kf.set_h_params(theta.head(nb_params));
+        Eigen::VectorXd c = theta.tail(theta.size() - nb_params);
+        CoGP_t::LikelihoodWorkspace ws;
+        double lik = cogp.compute_log_lik(kf, c, ws);
+        if (!compute_grad)
+            return opt::no_grad(lik);
+        return {lik, cogp.compute_grad_log_lik(kf, c, ws)};
+    };
+    Eigen::VectorXd theta(cogp.kernel_function().h_params_size() + 9);
+    theta << cogp.kernel_function().h_params(), params;
+    Eigen::VectorXd analytic, finite_diff;
+    double error;
+    std::tie(error, analytic, finite_diff) = check_grad(f, theta, 1e-5);
+    BOOST_CHECK(error < 1e-4 * std::max(1., analytic.norm()));
+
+    // compute() without the kernel only stores the samples (like GP): the model is computed by recompute()
+    std::vector<Eigen::VectorXd> few_samples(samples.begin(), samples.begin() + 10), few_observations(observations.begin(), observations.begin() + 10);
+    CoGP_t lazy, direct;
+    lazy.compute(few_samples, few_observations, false);
+    BOOST_CHECK(lazy.nb_samples() == 10);
+    lazy.recompute(false, false);
+    direct.compute(few_samples, few_observations);
+    BOOST_CHECK_CLOSE(lazy.compute_log_lik(), direct.compute_log_lik(), 1e-8);
+    BOOST_CHECK((lazy.mu(X.row(0).transpose()) - direct.mu(X.row(0).transpose())).norm() < 1e-10);
+
+    // ... and the distances cached for the previous samples are not reused (same number of samples)
+    std::vector<Eigen::VectorXd> new_samples;
+    for (int i = 0; i < 30; i++)
+        new_samples.push_back(tools::random_vector(2));
+    cogp.compute(new_samples, observations, false);
+    cogp.recompute(false, false);
+    CoGP_t reference;
+    reference.compute(new_samples, observations);
+    reference.set_coregionalization_params(params);
+    reference.recompute(false);
+    BOOST_CHECK_CLOSE(cogp.compute_log_lik(), reference.compute_log_lik(), 1e-8);
+
+    // the optimization of the likelihood learns that the first two outputs are anti-correlated
+    using OptGP_t = model::CoregionalizedGP<ParamsCoregionalized, KF_t, Mean_t, model::coregionalized_gp::LFOpt<ParamsCoregionalized>>;
+    OptGP_t opt_gp;
+    for (size_t i = 0; i < samples.size(); i++)
+        opt_gp.add_sample(samples[i], observations[i]);
+    BOOST_CHECK(opt_gp.nb_samples() == 30);
+    double lik_before = opt_gp.compute_log_lik();
+    opt_gp.optimize_hyperparams();
+    BOOST_CHECK(opt_gp.compute_log_lik() > lik_before);
+    const Eigen::MatrixXd& B_opt = opt_gp.coregionalization_matrix();
+    BOOST_CHECK(B_opt(0, 1) / std::sqrt(B_opt(0, 0) * B_opt(1, 1)) < -0.9);
+}
@@ -101,6 +101,48 @@ struct ParamsNoise {
 
 BO_DECLARE_DYN_PARAM(int, Params::kernel_squared_exp_ard, k);
 
+// rational quadratic kernel (with alpha = 1), without cached versions: it uses the generic
+// gradient_trace_cached() and gradient_matrix_cached(), with its allocation-free gradient_in_place()
+template <typename Params>
+struct RationalQuadratic : public kernel::BaseKernel<Params, RationalQuadratic<Params>> {
+    RationalQuadratic(size_t dim = 1) { set_params(Eigen::VectorXd::Zero(2)); }
+
+    size_t params_size() const { return 2; }
+
+    Eigen::VectorXd params() const { return _h_params; }
+
+    void set_params(const Eigen::VectorXd& p)
+    {
+        _h_params = p;
+        _l = std::exp(p(0));
+        _sf2 = std::exp(2.0 * p(1));
+    }
+
+    double kernel(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2) const
+    {
+        return _sf2 / (1 + (x1 - x2).squaredNorm() / (2 * _l * _l));
+    }
+
+    Eigen::VectorXd gradient(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2) const
+    {
+        Eigen::VectorXd grad(params_size());
+        gradient_in_place(x1, x2, grad);
+        return grad;
+    }
+
+    void gradient_in_place(const Eigen::Ref<const Eigen::VectorXd>& x1, const Eigen::Ref<const Eigen::VectorXd>& x2, Eigen::Ref<Eigen::VectorXd> grad) const
+    {
+        double r = (x1 - x2).squaredNorm() / (2 * _l * _l);
+        double k = _sf2 / (1 + r);
+        grad(0) = 2 * r * k / (1 + r);
+        grad(1) = 2 * k;
+    }
+
+protected:
+    double _sf2, _l;
+    Eigen::VectorXd _h_params;
+};
+
 Eigen::VectorXd make_v2(double x1, double x2)
 {
     Eigen::VectorXd v2(2);
@@ -152,6 +194,11 @@ void check_kernel(size_t N, size_t K, double e = 1e-6)
         std::tie(error, analytic, finite_diff) = check_grad(kern, hp, x1, x2, e);
         // std::cout << error << ": " << analytic.transpose() << " vs " << finite_diff.transpose() << std::endl;
         BOOST_CHECK(error < 1e-5);
+
+        // the same gradient (with the noise of the diagonal), written in a buffer
+        Eigen::VectorXd g = Eigen::VectorXd::Constant(kern.h_params_size(), 42.);
+        kern.grad_in_place(x1, x1, 3, 3, g);
+        BOOST_CHECK((g - kern.grad(x1, x1, 3, 3)).norm() < 1e-12);
     }
 }
 
@@ -222,3 +269,246 @@ BOOST_AUTO_TEST_CASE(test_kernel_SE_ARD)
     se.set_h_params(hp);
     BOOST_CHECK(s1 == se(v1, v2));
 }
+
+template <typename Kernel>
+void check_kernel_matrix(size_t N, size_t K)
+{
+    Kernel kern(N);
+    Eigen::VectorXd hp = tools::random_vector(kern.h_params_size()).array() * 2. - 1.;
+    kern.set_h_params(hp);
+
+    Eigen::MatrixXd X1 = Eigen::MatrixXd::Random(N, K) * 5.;
+    Eigen::MatrixXd X2 = Eigen::MatrixXd::Random(N, K + 3) * 5.;
+    // identical points should give the maximum covariance
+    X2.col(0) = X1.col(0);
+
+    Eigen::MatrixXd k_matrix = kern.kernel_matrix(X1, X2);
+    Eigen::VectorXd k_diag = kern.kernel_diag(X1);
+    BOOST_CHECK(k_matrix.rows() == X1.cols());
+    BOOST_CHECK(k_matrix.cols() == X2.cols());
+
+    for (int i = 0; i < X1.cols(); i++) {
+        BOOST_CHECK(std::abs(k_diag(i) - kern(X1.col(i), X1.col(i))) < 1e-10);
+        for (int j = 0; j < X2.cols(); j++)
+            BOOST_CHECK(std::abs(k_matrix(i, j) - kern(X1.col(i), X2.col(j))) < 1e-8);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_kernel_matrix)
+{
+    Params::kernel_squared_exp_ard::set_k(0);
+    for (int i = 1; i <= 5; i++) {
+        check_kernel_matrix<kernel::Exp<Params>>(i, 20);
+        check_kernel_matrix<kernel::MaternThreeHalves<Params>>(i, 20);
+        check_kernel_matrix<kernel::MaternFiveHalves<Params>>(i, 20);
+        check_kernel_matrix<kernel::SquaredExpARD<Params>>(i, 20);
+    }
+
+    Params::kernel_squared_exp_ard::set_k(1);
+    for (int i = 1; i <= 5; i++)
+        check_kernel_matrix<kernel::SquaredExpARD<Params>>(i, 20);
+}
+
+template <typename Kernel>
+void check_cached_kernel(size_t N, size_t K)
+{
+    Kernel kern(N);
+    Eigen::VectorXd hp = tools::random_vector(kern.h_params_size()).array() * 2. - 1.;
+    kern.set_h_params(hp);
+
+    Eigen::MatrixXd X = Eigen::MatrixXd::Random(N, K) * 5.;
+    Eigen::MatrixXd W = Eigen::MatrixXd::Random(K, K);
+
+    kernel::DistanceCache cache;
+    cache.reset(X);
+    BOOST_CHECK(cache.size() == int(K));
+    BOOST_CHECK(cache.sq_dist().isApprox(tools::sq_dist(X, X), 1e-8));
+
+    Eigen::MatrixXd k_matrix = kern.cached_kernel_matrix(cache);
+    BOOST_CHECK(k_matrix.isApprox(kern.kernel_matrix(X, X), 1e-8));
+    // (in the memory of an existing matrix)
+    Eigen::MatrixXd k_buffer = Eigen::MatrixXd::Random(K, K);
+    kern.cached_kernel_matrix(cache, k_buffer);
+    BOOST_CHECK(k_buffer.isApprox(k_matrix, 1e-12));
+
+    Eigen::VectorXd grad = Eigen::VectorXd::Zero(kern.h_params_size());
+    for (int i = 0; i < X.cols(); i++)
+        for (int j = 0; j < X.cols(); j++)
+            grad += W(i, j) * kern.grad(X.col(i), X.col(j), i, j);
+    BOOST_CHECK(kern.cached_grad_trace(cache, W).isApprox(grad, 1e-8));
+
+    Eigen::MatrixXd dK;
+    for (size_t p = 0; p < kern.h_params_size(); p++) {
+        kern.cached_grad_matrix(cache, p, dK);
+        for (int i = 0; i < X.cols(); i++)
+            for (int j = 0; j < X.cols(); j++)
+                BOOST_CHECK(std::abs(dK(i, j) - kern.grad(X.col(i), X.col(j), i, j)(p)) < 1e-8);
+    }
+
+    // a copy of the cache rebuilds the same distances
+    kernel::DistanceCache cache2(cache);
+    BOOST_CHECK(kern.cached_kernel_matrix(cache2).isApprox(k_matrix, 1e-12));
+
+    // the samples are viewed, not copied; reset() drops the distances when they change
+    BOOST_CHECK(cache.samples().data() == X.data());
+    X.col(0) = Eigen::VectorXd::Random(N) * 5.;
+    cache.reset();
+    BOOST_CHECK(cache.sq_dist().isApprox(tools::sq_dist(X, X), 1e-8));
+    BOOST_CHECK(kern.cached_kernel_matrix(cache).isApprox(kern.kernel_matrix(X, X), 1e-8));
+}
+
+BOOST_AUTO_TEST_CASE(test_kernel_distance_cache)
+{
+    Params::kernel_squared_exp_ard::set_k(0);
+    for (int i = 1; i <= 5; i++) {
+        check_cached_kernel<kernel::Exp<Params>>(i, 20);
+        check_cached_kernel<kernel::MaternThreeHalves<Params>>(i, 20);
+        check_cached_kernel<kernel::MaternFiveHalves<Params>>(i, 20);
+        check_cached_kernel<kernel::SquaredExpARD<Params>>(i, 20);
+        check_cached_kernel<kernel::SquaredExpARD<ParamsNoise>>(i, 20);
+        // generic versions, from the gradient of each pair
+        check_kernel<RationalQuadratic<Params>>(i, 10);
+        check_cached_kernel<RationalQuadratic<Params>>(i, 20);
+        check_cached_kernel<RationalQuadratic<ParamsNoise>>(i, 20);
+    }
+    // (several blocks of rows)
+    check_cached_kernel<RationalQuadratic<ParamsNoise>>(3, 100);
+
+    Params::kernel_squared_exp_ard::set_k(1);
+    for (int i = 1; i <= 5; i++)
+        check_cached_kernel<kernel::SquaredExpARD<Params>>(i, 20);
+}
+
+template <typename Kernel>
+void check_grad_input(size_t N, size_t K, double e = 1e-6)
+{
+    Kernel kern(N);
+    for (size_t i = 0; i < K; i++) {
+        Eigen::VectorXd hp = tools::random_vector(kern.h_params_size()).array() * 2. - 1.;
+        kern.set_h_params(hp);
+
+        Eigen::VectorXd x1 = tools::random_vector(N).array() * 4. - 2.;
+        Eigen::VectorXd x2 = tools::random_vector(N).array() * 4. - 2.;
+
+        Eigen::VectorXd finite_diff(N);
+        for (size_t j = 0; j < N; j++) {
+            Eigen::VectorXd x_p = x1, x_m = x1;
+            x_p(j) += e;
+            x_m(j) -= e;
+            finite_diff(j) = (kern(x_p, x2) - kern(x_m, x2)) / (2.0 * e);
+        }
+
+        BOOST_CHECK((kern.grad_input(x1, x2) - finite_diff).norm() < 1e-5);
+        // stationary kernels: no variation of k(x, x)
+        BOOST_CHECK(kern.grad_input(x1, x1).norm() < 1e-12);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_kernel_grad_input)
+{
+    Params::kernel_squared_exp_ard::set_k(0);
+    for (int i = 1; i <= 5; i++) {
+        check_grad_input<kernel::Exp<Params>>(i, 20);
+        check_grad_input<kernel::MaternThreeHalves<Params>>(i, 20);
+        check_grad_input<kernel::MaternFiveHalves<Params>>(i, 20);
+        check_grad_input<kernel::SquaredExpARD<Params>>(i, 20);
+        check_grad_input<kernel::SquaredExpARD<ParamsNoise>>(i, 20);
+    }
+
+    Params::kernel_squared_exp_ard::set_k(1);
+    for (int i = 1; i <= 5; i++)
+        check_grad_input<kernel::SquaredExpARD<Params>>(i, 20);
+}
+
+template <typename Kernel>
+void check_spectral_frequencies(size_t N)
+{
+    Kernel kern(N);
+    Eigen::VectorXd hp = tools::random_vector(kern.h_params_size()).array() * 2. - 1.;
+    kern.set_h_params(hp);
+
+    // k(x1, x2) = k(x, x) * E[cos(omega^T (x1 - x2))]
+    int m = 200000;
+    tools::rgen_gauss_t rgen(0., 1., 42);
+    Eigen::MatrixXd Z(N, m), E(5, m);
+    for (int j = 0; j < m; j++) {
+        for (size_t i = 0; i < N; i++)
+            Z(i, j) = rgen.rand();
+        for (int i = 0; i < 5; i++)
+            E(i, j) = rgen.rand();
+    }
+    Eigen::MatrixXd omega = kern.spectral_frequencies(Z, E);
+
+    for (int t = 0; t < 5; t++) {
+        Eigen::VectorXd x1 = tools::random_vector(N), x2 = tools::random_vector(N);
+        double k = kern(x1, x1) * ((x1 - x2).transpose() * omega).array().cos().mean();
+        BOOST_CHECK_SMALL(k - kern(x1, x2), 0.01 * kern(x1, x1));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_kernel_spectral_frequencies)
+{
+    Params::kernel_squared_exp_ard::set_k(0);
+    for (int i = 1; i <= 3; i++) {
+        check_spectral_frequencies<kernel::Exp<Params>>(i);
+        check_spectral_frequencies<kernel::MaternThreeHalves<Params>>(i);
+        check_spectral_frequencies<kernel::MaternFiveHalves<Params>>(i);
+        check_spectral_frequencies<kernel::SquaredExpARD<Params>>(i);
+    }
+
+    Params::kernel_squared_exp_ard::set_k(1);
+    for (int i = 1; i <= 3; i++)
+        check_spectral_frequencies<kernel::SquaredExpARD<Params>>(i);
+}
+
+template <int D>
+struct ParamsFixed : public Params {
+    struct kernel : public Params::kernel {
+        BO_PARAM(int, dim_in, D);
+    };
+};
+
+// a Params::kernel that does not inherit from defaults::kernel (no dim_in)
+struct ParamsNoDim : public Params {
+    struct kernel {
+        BO_PARAM(double, noise, 0.0);
+        BO_PARAM(bool, optimize_noise, false);
+    };
+};
+
+template <typename Kernel, typename FixedKernel>
+void check_fixed_dim(size_t N)
+{
+    Kernel kern(N);
+    FixedKernel fixed(N);
+    Eigen::VectorXd hp = tools::random_vector(kern.h_params_size()).array() * 2. - 1.;
+    kern.set_h_params(hp);
+    fixed.set_h_params(hp);
+
+    for (int t = 0; t < 10; t++) {
+        Eigen::VectorXd x1 = tools::random_vector(N), x2 = tools::random_vector(N);
+        BOOST_CHECK_CLOSE(fixed(x1, x2), kern(x1, x2), 1e-10);
+        BOOST_CHECK((fixed.grad(x1, x2) - kern.grad(x1, x2)).norm() < 1e-12);
+        BOOST_CHECK((fixed.grad_input(x1, x2) - kern.grad_input(x1, x2)).norm() < 1e-12);
+    }
+    Eigen::MatrixXd X = Eigen::MatrixXd::Random(N, 5);
+    BOOST_CHECK((fixed.kernel_matrix(X, X) - kern.kernel_matrix(X, X)).norm() < 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(test_kernel_fixed_dim)
+{
+    Params::kernel_squared_exp_ard::set_k(0);
+    check_fixed_dim<kernel::Exp<Params>, kernel::Exp<ParamsFixed<2>>>(2);
+    check_fixed_dim<kernel::MaternThreeHalves<Params>, kernel::MaternThreeHalves<ParamsFixed<3>>>(3);
+    check_fixed_dim<kernel::MaternFiveHalves<Params>, kernel::MaternFiveHalves<ParamsFixed<6>>>(6);
+    check_fixed_dim<kernel::SquaredExpARD<Params>, kernel::SquaredExpARD<ParamsFixed<6>>>(6);
+
+    Params::kernel_squared_exp_ard::set_k(1);
+    check_fixed_dim<kernel::SquaredExpARD<Params>, kernel::SquaredExpARD<ParamsFixed<2>>>(2);
+
+    // without dim_in in Params::kernel, the dimension is dynamic
+    BOOST_CHECK(kernel::fixed_dim_in<ParamsNoDim>::value == Eigen::Dynamic);
+    BOOST_CHECK(kernel::fixed_dim_in<ParamsFixed<3>>::value == 3);
+    check_fixed_dim<kernel::SquaredExpARD<ParamsNoDim>, kernel::SquaredExpARD<ParamsFixed<4>>>(4);
+    check_fixed_dim<kernel::MaternFiveHalves<ParamsNoDim>, kernel::MaternFiveHalves<ParamsFixed<4>>>(4);
+}
@@ -53,6 +53,7 @@
 
 #include <limbo/kernel/exp.hpp>
 #include <limbo/mean/constant.hpp>
+#include <limbo/mean/data.hpp>
 #include <limbo/mean/function_ard.hpp>
 #include <limbo/mean/null_function.hpp>
 #include <limbo/model/gp.hpp>
@@ -186,6 +187,11 @@ BOOST_AUTO_TEST_CASE(test_text_archive)
     using GPMean = limbo::model::GP<Params, limbo::kernel::MaternFiveHalves<Params>, limbo::mean::Constant<Params>, limbo::model::gp::MeanLFOpt<Params>>;
     using GPMeanLoad = limbo::model::GP<LoadParams, limbo::kernel::MaternFiveHalves<LoadParams>, limbo::mean::Constant<LoadParams>, limbo::model::gp::MeanLFOpt<LoadParams>>;
     test_gp<GPMean, GPMeanLoad, limbo::serialize::TextArchive>("/tmp/gp_mean_text");
+
+    // only the packed factor is saved (3 rows per panel: the factor spans several panels)
+    using GPCompact = limbo::model::GP<Params, limbo::kernel::MaternFiveHalves<Params>, limbo::mean::Data<Params>, limbo::model::gp::NoLFOpt<Params>, limbo::model::gp::Compact<limbo::model::gp::DoublePrecision, 3>>;
+    using GPCompactLoad = limbo::model::GP<LoadParams, limbo::kernel::MaternFiveHalves<LoadParams>, limbo::mean::Data<LoadParams>, limbo::model::gp::NoLFOpt<LoadParams>, limbo::model::gp::Compact<limbo::model::gp::DoublePrecision, 3>>;
+    test_gp<GPCompact, GPCompactLoad, limbo::serialize::TextArchive>("/tmp/gp_compact_text", false);
 }
 
 BOOST_AUTO_TEST_CASE(test_bin_archive)
@@ -196,10 +202,19 @@ BOOST_AUTO_TEST_CASE(test_bin_archive)
     using GPMean = limbo::model::GP<Params, limbo::kernel::MaternFiveHalves<Params>, limbo::mean::Constant<Params>, limbo::model::gp::MeanLFOpt<Params>>;
     using GPMeanLoad = limbo::model::GP<LoadParams, limbo::kernel::MaternFiveHalves<LoadParams>, limbo::mean::Constant<LoadParams>, limbo::model::gp::MeanLFOpt<LoadParams>>;
     test_gp<GPMean, GPMeanLoad, limbo::serialize::BinaryArchive>("/tmp/gp_mean_bin");
+
+    // only the packed factor is saved (3 rows per panel: the factor spans several panels)
+    using GPCompact = limbo::model::GP<Params, limbo::kernel::MaternFiveHalves<Params>, limbo::mean::Data<Params>, limbo::model::gp::NoLFOpt<Params>, limbo::model::gp::Compact<limbo::model::gp::DoublePrecision, 3>>;
+    using GPCompactLoad = limbo::model::GP<LoadParams, limbo::kernel::MaternFiveHalves<LoadParams>, limbo::mean::Data<LoadParams>, limbo::model::gp::NoLFOpt<LoadParams>, limbo::model::gp::Compact<limbo::model::gp::DoublePrecision, 3>>;
+    test_gp<GPCompact, GPCompactLoad, limbo::serialize::BinaryArchive>("/tmp/gp_compact_bin", false);
 }
 
 BOOST_AUTO_TEST_CASE(test_multi_gp_save)
 {
     using GP_Multi_t = limbo::model::MultiGP<Params, limbo::model::GP, limbo::kernel::Exp<Params>, limbo::mean::NullFunction<Params>>;
     test_gp<GP_Multi_t, GP_Multi_t, limbo::serialize::TextArchive>("/tmp/gp_multi_text", false);
+
+    // the outputs share a GP again once the model is recomputed
+    using GP_Shared_t = limbo::model::MultiGP<Params, limbo::model::GP, limbo::kernel::Exp<Params>, limbo::mean::NullFunction<Params>, limbo::model::gp::NoLFOpt<Params>, limbo::model::multi_gp::SharedIfIdentical>;
+    test_gp<GP_Shared_t, GP_Shared_t, limbo::serialize::TextArchive>("/tmp/gp_multi_shared_text", false);
 }